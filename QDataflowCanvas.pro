@@ -2,29 +2,22 @@
 # Copyright (C) 2017 Federico Ferri
 # Copyright (C) 2018 Kuba Ober
 
-QT += widgets
+# core:       the model and the execution engine, QtCore only
+# app:        the example editor
+# runner:     runs patches without a display
+# benchmarks: timings of the model, the dispatch and the canvas
+# tests:      unit tests of the model, the undo log and the scheduler
 
-CONFIG += c++11
+TEMPLATE = subdirs
 
-TARGET = QDataflowCanvas
-TEMPLATE = app
+SUBDIRS += \
+    core \
+    app \
+    runner \
+    benchmarks \
+    tests
 
-SOURCES += \
-    main.cpp\
-    mainwindow.cpp \
-    qdataflowcanvas.cpp \
-    qdataflowmodel.cpp
-
-HEADERS += \
-    mainwindow.h \
-    qdataflowcanvas.h \
-    qdataflowmodel.h \
-    utility.h
-
-FORMS += \
-    mainwindow.ui
-
-DEFINES += \
-    QT_DISABLE_DEPRECATED_BEFORE=0x060000 \
-    QT_RESTRICTED_CAST_FROM_ASCII \
-    QT_NO_KEYWORDS
+app.depends = core
+runner.depends = core
+benchmarks.depends = core
+tests.depends = core
@@ -0,0 +1,37 @@
+# QDataflowCanvas - a dataflow widget for Qt
+# Copyright (C) 2017 Federico Ferri
+# Copyright (C) 2018 Kuba Ober
+
+QT += widgets
+
+CONFIG += c++11
+
+TARGET = QDataflowCanvas
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += \
+    ../main.cpp \
+    ../mainwindow.cpp \
+    ../qdataflowcanvas.cpp \
+    ../qdataflowcompletion.cpp \
+    ../qdataflowexamples.cpp \
+    ../qdataflowminimap.cpp \
+    ../qdataflowsceneindex.cpp
+
+HEADERS += \
+    ../mainwindow.h \
+    ../qdataflowcanvas.h \
+    ../qdataflowcompletion.h \
+    ../qdataflowexamples.h \
+    ../qdataflowminimap.h \
+    ../qdataflowsceneindex.h
+
+FORMS += \
+    ../mainwindow.ui
+
+DEFINES += \
+    QT_DISABLE_DEPRECATED_BEFORE=0x060000 \
+    QT_RESTRICTED_CAST_FROM_ASCII \
+    QT_NO_KEYWORDS
@@ -0,0 +1,30 @@
+# QDataflowCanvas - a dataflow widget for Qt
+# Copyright (C) 2018 Kuba Ober
+
+QT += widgets testlib
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = QDataflowBenchmarks
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += \
+    qdataflowbenchmarks.cpp \
+    qdataflowgraphgenerator.cpp \
+    ../qdataflowcanvas.cpp \
+    ../qdataflowcompletion.cpp \
+    ../qdataflowsceneindex.cpp
+
+HEADERS += \
+    qdataflowgraphgenerator.h \
+    ../qdataflowcanvas.h \
+    ../qdataflowcompletion.h \
+    ../qdataflowsceneindex.h
+
+DEFINES += \
+    QT_DISABLE_DEPRECATED_BEFORE=0x060000 \
+    QT_RESTRICTED_CAST_FROM_ASCII \
+    QT_NO_KEYWORDS
@@ -0,0 +1,376 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowgraphgenerator.h"
+#include "qdataflowcanvas.h"
+#include "qdataflowkernels.h"
+#include "qdataflowmodel.h"
+
+#include <QApplication>
+#include <QImage>
+#include <QMouseEvent>
+#include <QScrollBar>
+#include <QtTest>
+
+namespace {
+
+// set by --quick: skips the 100k sizes
+bool quick = false;
+
+// forwards every message; a chain of these measures per-hop dispatch cost
+class BenchPass : public QDataflowMetaObject
+{
+public:
+    explicit BenchPass(QDataflowModelNode *node) : QDataflowMetaObject(node) {}
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        Q_UNUSED(inlet);
+        sendData(0, message);
+    }
+};
+
+class BenchSink : public QDataflowMetaObject
+{
+public:
+    BenchSink(QDataflowModelNode *node, qint64 *received) : QDataflowMetaObject(node), received_(received) {}
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        Q_UNUSED(inlet);
+        *received_ += message.toInt() >= 0;
+    }
+
+private:
+    qint64 *received_;
+};
+
+// halves its input: one sample per message, or a block per message
+class BenchGain : public QDataflowMetaObject
+{
+public:
+    BenchGain(QDataflowModelNode *node, bool block) : QDataflowMetaObject(node) {setBlockProcessing(block);}
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        Q_UNUSED(inlet);
+        sendData(0, message.toDouble() * 0.5);
+    }
+
+    void onBlockReceived(int inlet, const float *samples, int count) override
+    {
+        Q_UNUSED(inlet);
+        QVector<float> r(count);
+        QDataflowKernels::mul(r.data(), samples, 0.5f, count);
+        sendData(0, r);
+    }
+};
+
+void addSizes(const QVector<int> &sizes)
+{
+    QTest::addColumn<int>("size");
+    for(int size : sizes)
+        QTest::addRow("%d", size) << size;
+}
+
+void addModelSizes()
+{
+    addSizes(quick ? QVector<int>{1000, 10000} : QVector<int>{1000, 10000, 100000});
+}
+
+void addCanvasSizes()
+{
+    addSizes(quick ? QVector<int>{1000} : QVector<int>{1000, 10000});
+}
+
+void addDispatchRows()
+{
+    QTest::addColumn<bool>("compiled");
+    QTest::addColumn<int>("size");
+    for(bool compiled : {false, true})
+        for(int size : {10, 100, 1000})
+            QTest::addRow("%s/%d", compiled ? "compiled" : "interpreted", size) << compiled << size;
+}
+
+// an offscreen canvas showing a layered patch, rendered into an image
+struct CanvasFixture
+{
+    explicit CanvasFixture(int size)
+    {
+        canvas.resize(1280, 800);
+        canvas.setDrawGrid(true);
+        canvas.setGridSize(10);
+        canvas.show();
+        nodes = QDataflowGraphGenerator().generate(canvas.model(), size, QDataflowGraphGenerator::Layered);
+        canvas.scene()->setSceneRect(canvas.scene()->itemsBoundingRect());
+        frame = QImage(canvas.viewport()->size(), QImage::Format_ARGB32_Premultiplied);
+    }
+
+    void render() {canvas.viewport()->render(&frame);}
+
+    QDataflowCanvas canvas;
+    QVector<QDataflowModelNode*> nodes;
+    QImage frame;
+};
+
+} // namespace
+
+// Timings of bulk model edits, message dispatch and canvas painting, run
+// with QtTest's benchmark support: one function per case, one data row per
+// size. Edits that change the model are timed once on a fresh one, the
+// rest are repeated until the measurement is stable.
+class QDataflowBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void modelCreate_data() {addModelSizes();}
+    void modelCreate();
+    void modelConnectLayered_data() {addModelSizes();}
+    void modelConnectLayered();
+    void modelConnectDuplicate_data() {addModelSizes();}
+    void modelConnectDuplicate();
+
+    void dispatchChain_data() {addDispatchRows();}
+    void dispatchChain();
+    void dispatchFanOut_data() {addDispatchRows();}
+    void dispatchFanOut();
+    void dispatchSamples_data();
+    void dispatchSamples();
+
+    void canvasPaint_data() {addCanvasSizes();}
+    void canvasPaint();
+    void canvasPan_data() {addCanvasSizes();}
+    void canvasPan();
+    void canvasZoom_data() {addCanvasSizes();}
+    void canvasZoom();
+    void canvasDragConnection_data() {addCanvasSizes();}
+    void canvasDragConnection();
+};
+
+void QDataflowBenchmarks::modelCreate()
+{
+    QFETCH(int, size);
+    QDataflowModel model;
+    QBENCHMARK_ONCE
+    {
+        QDataflowGraphGenerator().createNodes(&model, size);
+    }
+    QCOMPARE(model.graph().nodeCount(), size);
+}
+
+void QDataflowBenchmarks::modelConnectLayered()
+{
+    QFETCH(int, size);
+    QDataflowModel model;
+    const QVector<QDataflowModelNode*> nodes = QDataflowGraphGenerator().createNodes(&model, size);
+    int made = 0;
+    QBENCHMARK_ONCE
+    {
+        made = QDataflowGraphGenerator().connectNodes(&model, nodes, QDataflowGraphGenerator::Layered);
+    }
+    QCOMPARE(model.graph().edgeCount(), made);
+}
+
+void QDataflowBenchmarks::modelConnectDuplicate()
+{
+    // the same seed regenerates the same edges, so every connect() is
+    // rejected by the duplicate check and the model stays as it is
+    QFETCH(int, size);
+    QDataflowModel model;
+    const QVector<QDataflowModelNode*> nodes = QDataflowGraphGenerator().generate(&model, size, QDataflowGraphGenerator::Layered);
+    int made = 0;
+    QBENCHMARK
+    {
+        made += QDataflowGraphGenerator().connectNodes(&model, nodes, QDataflowGraphGenerator::Layered);
+    }
+    QCOMPARE(made, 0);
+}
+
+void QDataflowBenchmarks::dispatchChain()
+{
+    QFETCH(bool, compiled);
+    QFETCH(int, size);
+    const int messages = 1000;
+    qint64 received = 0;
+
+    QDataflowModel model;
+    model.setDispatchCompiled(compiled);
+    QVector<QDataflowModelNode*> chain = QDataflowGraphGenerator().generate(&model, size, QDataflowGraphGenerator::Chain);
+    for(int i = 0; i < chain.size() - 1; i++)
+        chain[i]->setDataflowMetaObject(new BenchPass(chain[i]));
+    chain.back()->setDataflowMetaObject(new BenchSink(chain.back(), &received));
+
+    QDataflowMetaObject *source = chain.front()->dataflowMetaObject();
+    QBENCHMARK
+    {
+        received = 0;
+        for(int i = 0; i < messages; i++)
+            source->sendData(0, i);
+    }
+    // a run where messages were rejected on the way measured the warnings
+    QCOMPARE(received, qint64(messages));
+}
+
+void QDataflowBenchmarks::dispatchFanOut()
+{
+    QFETCH(bool, compiled);
+    QFETCH(int, size);
+    const int messages = 1000;
+    qint64 received = 0;
+
+    QDataflowModel model;
+    model.setDispatchCompiled(compiled);
+    QVector<QDataflowModelNode*> fanOut = QDataflowGraphGenerator().generate(&model, size, QDataflowGraphGenerator::FanOut);
+    fanOut.front()->setDataflowMetaObject(new BenchPass(fanOut.front()));
+    for(int i = 1; i < fanOut.size(); i++)
+        fanOut[i]->setDataflowMetaObject(new BenchSink(fanOut[i], &received));
+
+    QDataflowMetaObject *source = fanOut.front()->dataflowMetaObject();
+    QBENCHMARK
+    {
+        received = 0;
+        for(int i = 0; i < messages; i++)
+            source->sendData(0, i);
+    }
+    QCOMPARE(received, qint64(messages) * (size - 1));
+}
+
+void QDataflowBenchmarks::dispatchSamples_data()
+{
+    // the same samples pushed through a chain of gains one per message,
+    // and in blocks of each size
+    QTest::addColumn<int>("blockSize");
+    QTest::newRow("message") << 1;
+    for(int blockSize : {64, 256, 1024})
+        QTest::addRow("block/%d", blockSize) << blockSize;
+}
+
+void QDataflowBenchmarks::dispatchSamples()
+{
+    QFETCH(int, blockSize);
+    const int length = 16;
+    const int samples = 65536;
+    const bool block = blockSize > 1;
+    qint64 received = 0;
+
+    QDataflowModel model;
+    model.setDispatchCompiled(true);
+    // the chain has to carry what the gains send, or every message is
+    // rejected by the first outlet
+    QDataflowGraphGenerator generator;
+    generator.setIoletType(block ? QStringLiteral("samples") : QStringLiteral("double"));
+    QVector<QDataflowModelNode*> chain = generator.generate(&model, length, QDataflowGraphGenerator::Chain);
+    for(int i = 0; i < chain.size() - 1; i++)
+        chain[i]->setDataflowMetaObject(new BenchGain(chain[i], block));
+    chain.back()->setDataflowMetaObject(new BenchSink(chain.back(), &received));
+
+    QDataflowMetaObject *source = chain.front()->dataflowMetaObject();
+    const QVector<float> input(blockSize, 1.0f);
+    QBENCHMARK
+    {
+        received = 0;
+        for(int i = 0; i < samples; i += blockSize)
+        {
+            if(block) source->sendData(0, input);
+            else source->sendData(0, 1.0);
+        }
+    }
+    QCOMPARE(received, qint64((samples + blockSize - 1) / blockSize));
+}
+
+void QDataflowBenchmarks::canvasPaint()
+{
+    QFETCH(int, size);
+    CanvasFixture fixture(size);
+    QBENCHMARK
+    {
+        fixture.render();
+    }
+}
+
+void QDataflowBenchmarks::canvasPan()
+{
+    QFETCH(int, size);
+    CanvasFixture fixture(size);
+    QScrollBar *bar = fixture.canvas.horizontalScrollBar();
+    int step = 0;
+    QBENCHMARK
+    {
+        bar->setValue(step++ % 2 ? bar->value() + 64 : bar->value() - 32);
+        fixture.render();
+    }
+}
+
+void QDataflowBenchmarks::canvasZoom()
+{
+    QFETCH(int, size);
+    CanvasFixture fixture(size);
+    int step = 0;
+    QBENCHMARK
+    {
+        const qreal factor = step++ % 2 ? 1.25 : 0.8;
+        fixture.canvas.scale(factor, factor);
+        fixture.canvas.resetCachedContent();
+        fixture.render();
+    }
+}
+
+void QDataflowBenchmarks::canvasDragConnection()
+{
+    // drag a new connection from the first node's outlet across the view:
+    // every move hit tests the inlets and repaints
+    QFETCH(int, size);
+    const int moves = 32;
+    CanvasFixture fixture(size);
+    QDataflowCanvas &canvas = fixture.canvas;
+    QDataflowNode *uinode = canvas.node(fixture.nodes.front());
+    canvas.centerOn(uinode);
+    QWidget *viewport = canvas.viewport();
+    QBENCHMARK
+    {
+        const QPoint start = canvas.mapFromScene(uinode->outlet(1)->scenePos());
+        QMouseEvent press(QEvent::MouseButtonPress, start, Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+        QApplication::sendEvent(viewport, &press);
+        for(int i = 1; i <= moves; i++)
+        {
+            const QPoint p = start + QPoint(i * 8, i * 4);
+            QMouseEvent move(QEvent::MouseMove, p, Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+            QApplication::sendEvent(viewport, &move);
+            fixture.render();
+        }
+        QMouseEvent release(QEvent::MouseButtonRelease, start, Qt::LeftButton, Qt::NoButton, Qt::NoModifier);
+        QApplication::sendEvent(viewport, &release);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // canvas frames are rendered to images; no display is needed
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+
+    // --quick is ours, everything else goes to QtTest
+    QStringList args = app.arguments();
+    quick = args.removeAll(QStringLiteral("--quick")) > 0;
+
+    QDataflowBenchmarks benchmarks;
+    return QTest::qExec(&benchmarks, args);
+}
+
+#include "qdataflowbenchmarks.moc"
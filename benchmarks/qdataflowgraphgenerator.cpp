@@ -0,0 +1,82 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowgraphgenerator.h"
+#include "qdataflowmodel.h"
+
+QDataflowGraphGenerator::QDataflowGraphGenerator(quint32 seed)
+    : random_(seed), ioletType_(QStringLiteral("int"))
+{
+}
+
+QVector<QDataflowModelNode*> QDataflowGraphGenerator::createNodes(QDataflowModel *model, int count)
+{
+    const QStringList types{ioletType_, ioletType_};
+
+    QVector<QDataflowModelNode*> nodes;
+    nodes.reserve(count);
+
+    QDataflowModelTransaction transaction(model);
+    model->reserve(count, 2 * count);
+    for(int i = 0; i < count; i++)
+    {
+        const QPoint pos(i / layerSize * 160, i % layerSize * 60);
+        nodes.push_back(model->create(pos, QStringLiteral("node %1").arg(i), types, types));
+    }
+    return nodes;
+}
+
+int QDataflowGraphGenerator::connectNodes(QDataflowModel *model, const QVector<QDataflowModelNode*> &nodes, Topology topology)
+{
+    int made = 0;
+    auto connect = [&](int source, int outlet, int dest, int inlet)
+    {
+        if(model->connect(nodes[source], outlet, nodes[dest], inlet)) made++;
+    };
+
+    QDataflowModelTransaction transaction(model);
+    const int count = nodes.size();
+    switch(topology)
+    {
+    case Chain:
+        for(int i = 1; i < count; i++)
+            connect(i - 1, 0, i, 0);
+        break;
+    case FanOut:
+        for(int i = 1; i < count; i++)
+            connect(0, 0, i, 0);
+        break;
+    case Layered:
+        for(int i = layerSize; i < count; i++)
+        {
+            const int layer = i / layerSize;
+            std::uniform_int_distribution<int> pick((layer - 1) * layerSize, layer * layerSize - 1);
+            connect(pick(random_), 0, i, 0);
+            if(random_() % 2)
+                connect(pick(random_), 1, i, 1);
+        }
+        break;
+    }
+    return made;
+}
+
+QVector<QDataflowModelNode*> QDataflowGraphGenerator::generate(QDataflowModel *model, int count, Topology topology)
+{
+    QDataflowModelTransaction transaction(model);
+    QVector<QDataflowModelNode*> nodes = createNodes(model, count);
+    connectNodes(model, nodes, topology);
+    return nodes;
+}
@@ -0,0 +1,63 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWGRAPHGENERATOR_H
+#define QDATAFLOWGRAPHGENERATOR_H
+
+#include <QString>
+#include <QVector>
+#include <random>
+
+class QDataflowModel;
+class QDataflowModelNode;
+
+// Builds reproducible synthetic patches for the benchmarks. Every node
+// has two inlets and two outlets of ioletType(), "int" unless set, so any
+// edge type checks.
+class QDataflowGraphGenerator
+{
+public:
+    enum Topology
+    {
+        // node i feeds node i + 1
+        Chain,
+        // node 0 feeds every other node
+        FanOut,
+        // columns of nodes, each fed by one or two random nodes of the
+        // previous column; the shape of a typical large patch
+        Layered
+    };
+
+    explicit QDataflowGraphGenerator(quint32 seed = 1);
+
+    // the type of the messages the patch is meant to carry
+    QString ioletType() const {return ioletType_;}
+    void setIoletType(const QString &type) {ioletType_ = type;}
+
+    // the nodes are laid out on a grid, in one model transaction
+    QVector<QDataflowModelNode*> createNodes(QDataflowModel *model, int count);
+    // returns the number of connections made
+    int connectNodes(QDataflowModel *model, const QVector<QDataflowModelNode*> &nodes, Topology topology);
+    QVector<QDataflowModelNode*> generate(QDataflowModel *model, int count, Topology topology);
+
+    static const int layerSize = 32;
+
+private:
+    std::mt19937 random_;
+    QString ioletType_;
+};
+
+#endif // QDATAFLOWGRAPHGENERATOR_H
@@ -0,0 +1,15 @@
+# QDataflowCanvas - a dataflow widget for Qt
+# Copyright (C) 2018 Kuba Ober
+
+# links the core library built by core.pro into a project one directory
+# below the top level
+
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
+
+win32:CONFIG(release, debug|release): QDATAFLOW_CORE_DIR = $$OUT_PWD/../core/release
+else:win32:CONFIG(debug, debug|release): QDATAFLOW_CORE_DIR = $$OUT_PWD/../core/debug
+else: QDATAFLOW_CORE_DIR = $$OUT_PWD/../core
+
+LIBS += -L$$QDATAFLOW_CORE_DIR -lqdataflowcore
+PRE_TARGETDEPS += $$QDATAFLOW_CORE_DIR/$${QMAKE_PREFIX_STATICLIB}qdataflowcore.$${QMAKE_EXTENSION_STATICLIB}
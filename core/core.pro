@@ -0,0 +1,47 @@
+# QDataflowCanvas - a dataflow widget for Qt
+# Copyright (C) 2018 Kuba Ober
+
+QT = core
+
+CONFIG += c++11 staticlib
+
+TARGET = qdataflowcore
+TEMPLATE = lib
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    ../qdataflowgraph.cpp \
+    ../qdataflowgraphanalysis.cpp \
+    ../qdataflowinletqueue.cpp \
+    ../qdataflowkernels.cpp \
+    ../qdataflowmessage.cpp \
+    ../qdataflowmodel.cpp \
+    ../qdataflownodefactory.cpp \
+    ../qdataflowpatchfile.cpp \
+    ../qdataflowpool.cpp \
+    ../qdataflowprofiler.cpp \
+    ../qdataflowscheduler.cpp \
+    ../qdataflowtyperegistry.cpp \
+    ../qdataflowundolog.cpp
+
+HEADERS += \
+    ../qdataflowgraph.h \
+    ../qdataflowgraphanalysis.h \
+    ../qdataflowinletqueue.h \
+    ../qdataflowkernels.h \
+    ../qdataflowmessage.h \
+    ../qdataflowmodel.h \
+    ../qdataflownodefactory.h \
+    ../qdataflowpatchfile.h \
+    ../qdataflowpool.h \
+    ../qdataflowprofiler.h \
+    ../qdataflowscheduler.h \
+    ../qdataflowtyperegistry.h \
+    ../qdataflowundolog.h \
+    ../utility.h
+
+DEFINES += \
+    QT_DISABLE_DEPRECATED_BEFORE=0x060000 \
+    QT_RESTRICTED_CAST_FROM_ASCII \
+    QT_NO_KEYWORDS
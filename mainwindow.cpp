@@ -16,121 +16,43 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mainwindow.h"
+#include "qdataflowexamples.h"
+#include "qdataflowminimap.h"
+#include "qdataflowpatchfile.h"
 #include "utility.h"
-#define _USE_MATH_DEFINES
-#include <cmath>
 #include <type_traits>
+#include <QDockWidget>
+#include <QFileDialog>
 #include <QMenu>
 #include <QDebug>
 
-class DFSource : public QDataflowMetaObject
-{
-public:
-    DFSource(QDataflowModelNode *node, const QStringList &args)
-        : QDataflowMetaObject(node)
-    {
-        Q_UNUSED(args);
-
-        //setInletCount(0);
-        setOutletTypes({"int"});
-    }
-};
-
-class DFMathBinOp : public QDataflowMetaObject
-{
-public:
-    DFMathBinOp(QDataflowModelNode *node, const QStringList &args)
-        : QDataflowMetaObject(node)
-    {
-        s = 0;
-
-        setInletTypes({"int", "int"});
-        setOutletTypes({"int"});
-
-        op = args[0];
-
-        if(args.length() > 1)
-            s = args[1].toLong();
-    }
-
-    void onDataReceved(int inlet, void *data)
-    {
-        if(inlet == 0)
-        {
-            int r = reinterpret_cast<long>(data);
-            if(op == "add") r = r + s;
-            if(op == "sub") r = r - s;
-            if(op == "mul") r = r * s;
-            if(op == "div") r = r / s;
-            if(op == "pow") r = pow(r, s);
-            sendData(0, reinterpret_cast<void*>(r));
-        }
-        else if(inlet == 1)
-        {
-            s = reinterpret_cast<long>(data);
-        }
-    }
-
-private:
-    QString op;
-    int s;
-};
-
-class DFNum2Str : public QDataflowMetaObject
-{
-public:
-    DFNum2Str(QDataflowModelNode *node, const QStringList &args)
-        : QDataflowMetaObject(node)
-    {
-        Q_UNUSED(args);
-
-        setInletTypes({"int"});
-        setOutletTypes({"string"});
-    }
-
-    void onDataReceved(int inlet, void *data)
-    {
-        Q_UNUSED(inlet);
-
-        QString s = QString::number(reinterpret_cast<long>(data));
-        sendData(0, reinterpret_cast<void*>(&s));
-    }
-};
-
-class DFSink : public QDataflowMetaObject
-{
-public:
-    DFSink(QDataflowModelNode *node, const QStringList &args, QLineEdit *e)
-        : QDataflowMetaObject(node), e_(e)
-    {
-        Q_UNUSED(args);
-
-        setInletTypes({"string"});
-        //setOutletCount(0);
-    }
-
-    void onDataReceved(int inlet, void *data)
-    {
-        if(inlet == 0)
-        {
-            e_->setText(*reinterpret_cast<QString*>(data));
-        }
-    }
-
-private:
-    QLineEdit *e_;
-};
-
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent)
+    : QMainWindow(parent), factory()
 {
     setupUi(this);
 
     QMenu *modelMenu = menuBar()->addMenu(tr("&Model"));
+    modelMenu->addAction("Open...", this, &MainWindow::onOpenPatch);
+    modelMenu->addAction("Save...", this, &MainWindow::onSavePatch);
+    modelMenu->addAction("Export as text...", this, &MainWindow::onExportPatchText);
+    modelMenu->addSeparator();
     modelMenu->addAction("Dump to console", this, &MainWindow::onDumpModel);
 
-    classList << "add" << "sub" << "mul" << "div" << "pow" << "source" << "sink" << "num2str";
-    canvas->setCompletion(this);
+    QMenu *editMenu = menuBar()->addMenu(tr("&Edit"));
+    editMenu->addAction("Undo", this, &MainWindow::onUndo, QKeySequence::Undo);
+    editMenu->addAction("Redo", this, &MainWindow::onRedo, QKeySequence::Redo);
+
+    QMenu *viewMenu = menuBar()->addMenu(tr("&View"));
+    viewMenu->addAction("New view", this, &MainWindow::onNewView);
+
+    // the overview draws from the model's graph, not from the items
+    QDockWidget *overview = new QDockWidget(tr("Overview"), this);
+    QDataflowMinimap *minimap = new QDataflowMinimap(overview);
+    minimap->setCanvas(canvas);
+    overview->setWidget(minimap);
+    addDockWidget(Qt::RightDockWidgetArea, overview);
+
+    canvas->setCompletion(&classCompletion);
     canvas->setShowObjectHoverFeedback(true);
     canvas->setShowConnectionHoverFeedback(true);
     canvas->setShowIOletTooltips(true);
@@ -138,12 +60,18 @@ MainWindow::MainWindow(QWidget *parent)
     canvas->setDrawGrid(true);
 
     QDataflowModel *model = canvas->model();
+    model->setDispatchCompiled(true);
+    model->setRejectCycles(true);
 
     new QDataflowModelDebugSignals(model);
 
+    // nodes get their iolets from the class declarations right away, and
+    // their meta objects when data first reaches them
+    factory = new QDataflowNodeFactory(model);
+    registerClasses();
+    classCompletion.setWords(factory->classNames());
+
     QObject::connect(sendButton, &QPushButton::clicked, this, &MainWindow::processData);
-    QObject::connect(model, &QDataflowModel::nodeTextChanged, this, &MainWindow::onNodeTextChanged);
-    QObject::connect(model, &QDataflowModel::nodeAdded, this, &MainWindow::onNodeAdded);
     QObject::connect(canvas->scene(), &QGraphicsScene::selectionChanged, this, &MainWindow::onSelectionChanged);
 
     // set up a small dataflow graph:
@@ -154,47 +82,48 @@ MainWindow::MainWindow(QWidget *parent)
     model->connect(source, 0, add, 0);
     model->connect(add, 0, num2str, 0);
     model->connect(num2str, 0, sink, 0);
-}
 
-QStringList MainWindow::complete(const QString &txt)
-{
-    QStringList completionList;
-    for (auto &className : as_const(classList))
-        if(className.startsWith(txt) && className.length() > txt.length())
-            completionList << className;
-    return completionList;
+    // the example graph is where the history starts
+    model->undoLog()->setEnabled(true);
 }
 
-void MainWindow::setupNode(QDataflowModelNode *node)
+MainWindow::~MainWindow()
 {
-    QStringList toks = node->text().split(QRegExp("(\\ |\\t)"));
-    if(!classList.contains(toks[0]))
-    {
-        node->setValid(false);
-        return;
-    }
-    if(toks[0] == "source") {sourceNode = node; node->setDataflowMetaObject(new DFSource(node, toks));}
-    else if(toks[0] == "sink") node->setDataflowMetaObject(new DFSink(node, toks, result));
-    else if(toks[0] == "num2str") node->setDataflowMetaObject(new DFNum2Str(node, toks));
-    else node->setDataflowMetaObject(new DFMathBinOp(node, toks));
-    node->setValid(true);
+    // the canvas outlives the completion; wait for a query using it
+    canvas->setCompletion(nullptr);
 }
 
-void MainWindow::processData()
+void MainWindow::registerClasses()
 {
-    long x = input->value();
-    sourceNode->dataflowMetaObject()->sendData(0, reinterpret_cast<void*>(x));
+    QLineEdit *e = result;
+    QDataflowExamples::registerClasses(factory, [e](const QDataflowMessage &message) {
+        e->setText(message.toString());
+    });
 }
 
-void MainWindow::onNodeAdded(QDataflowModelNode *node)
+void MainWindow::onNewView()
 {
-    setupNode(node);
+    // another editor on the same scene: no items are built twice
+    QDataflowCanvas *view = new QDataflowCanvas(this);
+    view->setWindowFlags(Qt::Window);
+    view->setAttribute(Qt::WA_DeleteOnClose);
+    view->setWindowTitle(tr("View"));
+    view->shareSceneWith(canvas);
+    view->resize(640, 480);
+    view->show();
 }
 
-void MainWindow::onNodeTextChanged(QDataflowModelNode *node, const QString &text)
+void MainWindow::processData()
 {
-    Q_UNUSED(text);
-    setupNode(node);
+    QDataflowModel *model = canvas->model();
+    const QDataflowGraph &graph = model->graph();
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+    {
+        if(!graph.containsNode(id) || factory->className(id) != "source") continue;
+        if(QDataflowMetaObject *mo = model->nodeById(id)->dataflowMetaObject())
+            mo->sendData(0, input->value());
+        return;
+    }
 }
 
 void MainWindow::onSelectionChanged()
@@ -229,3 +158,51 @@ void MainWindow::onDumpModel()
     for (auto *conn : as_const(model->connections()))
         qDebug() << "DUMP: connection: " << conn;
 }
+
+void MainWindow::onOpenPatch()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open patch"), {}, tr("Dataflow patches (*.qdfp)"));
+    if(fileName.isEmpty()) return;
+
+    QDataflowModel *model = canvas->model();
+
+    {
+        // clearing and loading is one transaction: the canvas rebuilds once
+        QDataflowModelTransaction transaction(model);
+        for(auto *node : as_const(model->nodes()))
+            model->remove(node);
+
+        if(!QDataflowPatchFile::load(model, fileName))
+            statusbar->showMessage(tr("Cannot load %1").arg(fileName), 10000);
+    }
+    // a loaded patch starts a new history
+    model->undoLog()->clear();
+}
+
+void MainWindow::onUndo()
+{
+    canvas->model()->undoLog()->undo();
+}
+
+void MainWindow::onRedo()
+{
+    canvas->model()->undoLog()->redo();
+}
+
+void MainWindow::onSavePatch()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save patch"), {}, tr("Dataflow patches (*.qdfp)"));
+    if(fileName.isEmpty()) return;
+
+    if(!QDataflowPatchFile::save(canvas->model(), fileName))
+        statusbar->showMessage(tr("Cannot save %1").arg(fileName), 10000);
+}
+
+void MainWindow::onExportPatchText()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export patch as text"), {}, tr("Text files (*.txt)"));
+    if(fileName.isEmpty()) return;
+
+    if(!QDataflowPatchFile::exportText(canvas->model(), fileName))
+        statusbar->showMessage(tr("Cannot export %1").arg(fileName), 10000);
+}
@@ -20,27 +20,33 @@
 
 #include "ui_mainwindow.h"
 #include "qdataflowcanvas.h"
+#include "qdataflowcompletion.h"
+#include "qdataflownodefactory.h"
 
-class MainWindow : public QMainWindow, private Ui::MainWindow, private QDataflowTextCompletion
+class MainWindow : public QMainWindow, private Ui::MainWindow
 {
     Q_OBJECT
 
 public:
     MainWindow(QWidget *parent = {});
-
-    QStringList complete(const QString &txt) override;
+    ~MainWindow() override;
 
 private:
-    QDataflowModelNode *sourceNode;
-    QStringList classList;
+    void registerClasses();
+
+    QDataflowNodeFactory *factory;
+    QDataflowPrefixCompletion classCompletion;
 
 private Q_SLOTS:
-    void setupNode(QDataflowModelNode *node);
     void processData();
-    void onNodeAdded(QDataflowModelNode *node);
-    void onNodeTextChanged(QDataflowModelNode *node, const QString &text);
     void onSelectionChanged();
     void onDumpModel();
+    void onOpenPatch();
+    void onSavePatch();
+    void onExportPatchText();
+    void onUndo();
+    void onRedo();
+    void onNewView();
 };
 
 #endif // MAINWINDOW_H
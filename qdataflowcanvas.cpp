@@ -30,19 +30,98 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsDropShadowEffect>
 #include <QMouseEvent>
+#ifndef QT_NO_OPENGL
+#include <QOpenGLWidget>
+#endif
 #include <QPainter>
+#include <QRunnable>
+#include <QRubberBand>
 #include <QStyleOption>
 #include <QApplication>
 #include <QTextCursor>
 #include <QTextDocument>
+#include <QWheelEvent>
+
+// iolets and the connection hit area reach a few pixels past the items'
+// rects; index entries and point queries are grown by this much
+static const qreal indexPickMargin = 8;
+
+// zoomed out, grid points closer than this many pixels are thinned out
+static const qreal minGridSpacing = 4;
+
+// rows of the completion popup; longer result lists scroll through them
+static const int completionRows = 8;
+
+// the result of a completion query, posted from the worker to the canvas
+class QDataflowCompletionEvent : public QEvent
+{
+public:
+    QDataflowCompletionEvent(quint64 generation, const QStringList &list)
+        : QEvent(eventType()), generation_(generation), list_(list) {}
+
+    static QEvent::Type eventType()
+    {
+        static const QEvent::Type type = QEvent::Type(QEvent::registerEventType());
+        return type;
+    }
+
+    quint64 generation_;
+    QStringList list_;
+};
+
+class QDataflowCompletionTask : public QRunnable
+{
+public:
+    QDataflowCompletionTask(QDataflowCanvas *canvas, QDataflowTextCompletion *completion,
+                            const std::atomic<quint64> *latest, quint64 generation, const QString &text)
+        : canvas_(canvas), completion_(completion), latest_(latest), generation_(generation), text_(text) {}
+
+    void run() override
+    {
+        // queries overtaken by further typing are skipped unanswered
+        if(latest_->load() != generation_) return;
+        QStringList list = completion_->complete(text_);
+        if(latest_->load() != generation_) return;
+        QCoreApplication::postEvent(canvas_, new QDataflowCompletionEvent(generation_, list));
+    }
+
+private:
+    QDataflowCanvas *canvas_;
+    QDataflowTextCompletion *completion_;
+    const std::atomic<quint64> *latest_;
+    quint64 generation_;
+    QString text_;
+};
+
+// node children are plain QGraphicsRectItems; this one defers to the
+// node's level of detail
+class QDataflowNodeRectItem : public QGraphicsRectItem, public QDataflowPooled<QDataflowNodeRectItem>
+{
+public:
+    QDataflowNodeRectItem(QDataflowNode *node, QGraphicsItem *parent)
+        : QGraphicsRectItem(parent), node_(node) {}
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override
+    {
+        if(node_->canvas()->isLowDetail(painter)) return;
+        QGraphicsRectItem::paint(painter, option, widget);
+    }
+
+private:
+    QDataflowNode *node_;
+};
 
 QDataflowCanvas::QDataflowCanvas(QWidget *parent)
-    : QGraphicsView(parent), model_()
+    : QGraphicsView(parent), model_(), owner_(this), ownScene_(), completionGeneration_(0), completionLabel_(), editNode_(), batchedConnections_(false),
+      hoveredConnection_(), topZValue_(0), rubberBand_(), lazyItems_(false), lazyItemMargin_(512), profilerOverlay_(false), profilerWasEnabled_(false)
 {
+    // the scene's BSP tree is rebuilt as items move; nodes and connections
+    // are indexed by the canvas instead (see QDataflowSceneIndex)
     QGraphicsScene *scene = new QGraphicsScene(this);
     scene->setItemIndexMethod(QGraphicsScene::NoIndex);
     scene->setSceneRect(0, 0, 200, 200);
     setScene(scene);
+    ownScene_ = scene;
     setCacheMode(CacheBackground);
     setViewportUpdateMode(BoundingRectViewportUpdate);
     setRenderHint(QPainter::Antialiasing, false);
@@ -57,8 +136,33 @@ QDataflowCanvas::QDataflowCanvas(QWidget *parent)
     setBackgroundBrush(gradient);
 
     completion_ = new QDataflowTextCompletion();
-
-    setDragMode(QGraphicsView::RubberBandDrag);
+    // a single worker: queries run in order, and the stale ones are skipped
+    completionPool_.setMaxThreadCount(1);
+
+    // rubber band selection is done in mouse*Event() using the index
+    setDragMode(QGraphicsView::NoDrag);
+
+    // scrolling and model edits only mark the lazy items stale; they are
+    // brought up to date once per event loop pass
+    lazyItemsTimer_.setSingleShot(true);
+    lazyItemsTimer_.setInterval(0);
+    QObject::connect(&lazyItemsTimer_, &QTimer::timeout, this, &QDataflowCanvas::updateLazyItems);
+
+    // dragged nodes are synced to the model at most once per frame, and
+    // when the drag ends
+    movedNodesTimer_.setSingleShot(true);
+    movedNodesTimer_.setInterval(16);
+    QObject::connect(&movedNodesTimer_, &QTimer::timeout, this, &QDataflowCanvas::flushMovedNodes);
+
+    // node edits, selection changes and keystrokes only mark nodes dirty;
+    // each node recomputes what changed once per frame
+    dirtyNodesTimer_.setSingleShot(true);
+    dirtyNodesTimer_.setInterval(16);
+    QObject::connect(&dirtyNodesTimer_, &QTimer::timeout, this, &QDataflowCanvas::flushDirtyNodes);
+
+    // the profile is aggregated from the per-thread counters on each tick
+    profilerOverlayTimer_.setInterval(500);
+    QObject::connect(&profilerOverlayTimer_, &QTimer::timeout, this, &QDataflowCanvas::updateProfilerOverlay);
 
     setModel(new QDataflowModel(this));
 
@@ -67,26 +171,63 @@ QDataflowCanvas::QDataflowCanvas(QWidget *parent)
     showIOletsTooltips_ = false;
     gridSize_ = 1.0;
     drawGrid_ = false;
+    levelOfDetailThreshold_ = 0.4;
 }
 
 QDataflowCanvas::~QDataflowCanvas()
 {
+    // the views sharing the scene go back to their own
+    const QList<QDataflowCanvas*> views = sharingViews_;
+    for(auto *view : views)
+        view->shareSceneWith(nullptr);
+    if(owner_ != this)
+        owner_->sharingViews_.removeAll(this);
+
+    cancelCompletion();
+    completionPool_.waitForDone();
+    clearHighlightedInlets();
+
     scene()->clearSelection();
 
+    for (auto *conn : as_const(ownedConnections_))
+        delete conn;
+
     for (auto *node : as_const(ownedNodes_))
         delete node;
 
-    for (auto *conn : as_const(ownedConnections_))
-        delete conn;
+    // the items still in the scene go with it; their memory is pooled and
+    // the last canvas hands the arenas back
+    setScene(nullptr);
+    delete ownScene_;
+    ownScene_ = nullptr;
+    QDataflowConnection::pool().clear();
+    QDataflowNode::pool().clear();
+    QDataflowInlet::pool().clear();
+    QDataflowOutlet::pool().clear();
+    QDataflowNodeTextLabel::pool().clear();
+    QDataflowNodeRectItem::pool().clear();
+}
+
+void QDataflowCanvas::setCompletion(QDataflowTextCompletion *completion)
+{
+    cancelCompletion();
+    completionPool_.waitForDone();
+    completion_ = completion;
 }
 
 QDataflowModel * QDataflowCanvas::model()
 {
-    return model_;
+    return owner_->model_;
 }
 
 void QDataflowCanvas::setModel(QDataflowModel *model)
 {
+    if(owner_ != this)
+    {
+        owner_->setModel(model);
+        return;
+    }
+
     if(model_)
     {
         QObject::disconnect(model_, &QDataflowModel::nodeAdded, this, &QDataflowCanvas::onNodeAdded);
@@ -96,13 +237,18 @@ void QDataflowCanvas::setModel(QDataflowModel *model)
         QObject::disconnect(model_, &QDataflowModel::nodeTextChanged, this, &QDataflowCanvas::onNodeTextChanged);
         QObject::disconnect(model_, &QDataflowModel::nodeInletCountChanged, this, &QDataflowCanvas::onNodeInletCountChanged);
         QObject::disconnect(model_, &QDataflowModel::nodeOutletCountChanged, this, &QDataflowCanvas::onNodeOutletCountChanged);
+        QObject::disconnect(model_, &QDataflowModel::nodeInletTypesChanged, this, &QDataflowCanvas::onNodeInletTypesChanged);
+        QObject::disconnect(model_, &QDataflowModel::nodeOutletTypesChanged, this, &QDataflowCanvas::onNodeOutletTypesChanged);
         QObject::disconnect(model_, &QDataflowModel::connectionAdded, this, &QDataflowCanvas::onConnectionAdded);
         QObject::disconnect(model_, &QDataflowModel::connectionRemoved, this, &QDataflowCanvas::onConnectionRemoved);
-        model_->deleteLater();
+        QObject::disconnect(model_, &QDataflowModel::transactionCommitted, this, &QDataflowCanvas::onTransactionCommitted);
+        if(model_->parent() == this)
+            model_->deleteLater();
     }
 
     model_ = model;
-    model_->setParent(this);
+    if(!model_->parent())
+        model_->setParent(this);
     QObject::connect(model_, &QDataflowModel::nodeAdded, this, &QDataflowCanvas::onNodeAdded);
     QObject::connect(model_, &QDataflowModel::nodeRemoved, this, &QDataflowCanvas::onNodeRemoved);
     QObject::connect(model_, &QDataflowModel::nodeValidChanged, this, &QDataflowCanvas::onNodeValidChanged);
@@ -110,192 +256,1070 @@ void QDataflowCanvas::setModel(QDataflowModel *model)
     QObject::connect(model_, &QDataflowModel::nodeTextChanged, this, &QDataflowCanvas::onNodeTextChanged);
     QObject::connect(model_, &QDataflowModel::nodeInletCountChanged, this, &QDataflowCanvas::onNodeInletCountChanged);
     QObject::connect(model_, &QDataflowModel::nodeOutletCountChanged, this, &QDataflowCanvas::onNodeOutletCountChanged);
+    QObject::connect(model_, &QDataflowModel::nodeInletTypesChanged, this, &QDataflowCanvas::onNodeInletTypesChanged);
+    QObject::connect(model_, &QDataflowModel::nodeOutletTypesChanged, this, &QDataflowCanvas::onNodeOutletTypesChanged);
     QObject::connect(model_, &QDataflowModel::connectionAdded, this, &QDataflowCanvas::onConnectionAdded);
     QObject::connect(model_, &QDataflowModel::connectionRemoved, this, &QDataflowCanvas::onConnectionRemoved);
+    QObject::connect(model_, &QDataflowModel::transactionCommitted, this, &QDataflowCanvas::onTransactionCommitted);
+    rebuildLazyIndex();
+
+    Q_EMIT modelChanged(model_);
+    for(auto *view : as_const(sharingViews_))
+        Q_EMIT view->modelChanged(model_);
 }
 
-QList<QDataflowNode*> QDataflowCanvas::selectedNodes()
+void QDataflowCanvas::shareSceneWith(QDataflowCanvas *owner)
+{
+    // views of a view show the scene of the canvas at the root
+    owner = owner && owner != this ? owner->owner_ : this;
+    if(owner == owner_) return;
+    if(owner != this && !sharingViews_.isEmpty())
+    {
+        qWarning() << this << "is shown by other canvases and cannot show another scene";
+        return;
+    }
+
+    // a drag in progress refers to the items of the old scene
+    if(rubberBand_)
+        rubberBand_->hide();
+    hoveredConnection_ = nullptr;
+
+    if(owner_ != this)
+        owner_->sharingViews_.removeAll(this);
+    owner_ = owner;
+    if(owner_ != this)
+        owner_->sharingViews_.push_back(this);
+
+    setScene(owner_ == this ? ownScene_ : owner_->scene());
+    Q_EMIT modelChanged(model());
+    owner_->scheduleLazyItemsUpdate();
+}
+
+void QDataflowCanvas::updateViewports(bool resetCache)
+{
+    // settings drawn by the views themselves do not change the scene
+    if(resetCache) resetCachedContent();
+    viewport()->update();
+    for(auto *view : as_const(sharingViews_))
+    {
+        if(resetCache) view->resetCachedContent();
+        view->viewport()->update();
+    }
+}
+
+QRectF QDataflowCanvas::visibleSceneRect() const
 {
-    auto const isSelected = [this](QDataflowNode *node){
-        return node->scene() == scene() && node->isSelected();
+    const QDataflowCanvas *owner = owner_;
+    auto const shown = [](const QDataflowCanvas *canvas){
+        return canvas->mapToScene(canvas->viewport()->rect()).boundingRect();
     };
+
+    QRectF ret;
+    if(owner->isVisible() || owner->sharingViews_.isEmpty())
+        ret = shown(owner);
+    for(auto *view : as_const(owner->sharingViews_))
+        if(view->isVisible()) ret |= shown(view);
+    return ret.isNull() ? shown(owner) : ret;
+}
+
+QList<QDataflowNode*> QDataflowCanvas::selectedNodes()
+{
+    if(owner_ != this) return owner_->selectedNodes();
     QList<QDataflowNode*> ret;
-    std::copy_if(nodes_.begin(), nodes_.end(), std::back_inserter(ret), isSelected);
+    ret.reserve(selectedNodes_.size());
+    for(auto *uinode : as_const(selectedNodes_))
+        if(uinode->scene() == scene()) ret.push_back(uinode);
     return ret;
 }
 
 QList<QDataflowConnection*> QDataflowCanvas::selectedConnections()
 {
-    auto const isSelected = [this](QDataflowConnection *conn){
-        return conn->scene() == scene() && conn->isSelected();
-    };
+    if(owner_ != this) return owner_->selectedConnections();
     QList<QDataflowConnection*> ret;
-    std::copy_if(connections_.begin(), connections_.end(), std::back_inserter(ret), isSelected);
+    ret.reserve(selectedConnections_.size());
+    for(auto *uiconn : as_const(selectedConnections_))
+        if(uiconn->scene() == scene()) ret.push_back(uiconn);
     return ret;
 }
 
 bool QDataflowCanvas::isSomeNodeInEditMode() const
 {
-    auto const inEditMode = [this](QDataflowNode *node){
-        return node->scene() == scene() && node->isInEditMode();
-    };
-    return std::any_of(nodes_.begin(), nodes_.end(), inEditMode);
+    if(owner_ != this) return owner_->isSomeNodeInEditMode();
+    return editNode_ && editNode_->scene() == scene() && editNode_->isInEditMode();
 }
 
 QDataflowNode * QDataflowCanvas::node(QDataflowModelNode *node)
 {
-    auto it = nodes_.find(node);
-    if(it == nodes_.end())
-    {
+    if(owner_ != this) return owner_->node(node);
+    QDataflowNode *uinode = itemOf(node);
+    // with lazy items most model nodes have no item
+    if(!uinode && !lazyItems_)
         qWarning() << this << "does not know about" << node;
-        return {};
-    }
-    return *it;
+    return uinode;
 }
 
 QDataflowConnection * QDataflowCanvas::connection(QDataflowModelConnection *conn)
 {
-    QMap<QDataflowModelConnection*, QDataflowConnection*>::Iterator it = connections_.find(conn);
-    if(it == connections_.end())
-    {
+    if(owner_ != this) return owner_->connection(conn);
+    QDataflowConnection *uiconn = itemOf(conn);
+    if(!uiconn && !lazyItems_)
         qDebug() << "WARNING:" << this << "does not know about" << conn;
-        return {};
-    }
-    return *it;
+    return uiconn;
+}
+
+QDataflowNode * QDataflowCanvas::itemOf(const QDataflowModelNode *mdlnode) const
+{
+    if(!mdlnode) return {};
+    // a removed node still reports its lastId(), whose slot no longer holds
+    // its item
+    const int id = mdlnode->lastId();
+    QDataflowNode *uinode = id >= 0 && id < nodes_.size() ? nodes_[id] : nullptr;
+    return uinode && uinode->modelNode() == mdlnode ? uinode : nullptr;
+}
+
+QDataflowConnection * QDataflowCanvas::itemOf(const QDataflowModelConnection *mdlconn) const
+{
+    if(!mdlconn) return {};
+    const int id = mdlconn->lastId();
+    QDataflowConnection *uiconn = id >= 0 && id < connections_.size() ? connections_[id] : nullptr;
+    return uiconn && uiconn->modelConnection() == mdlconn ? uiconn : nullptr;
+}
+
+QDataflowNode * QDataflowCanvas::nodeItem(int id) const
+{
+    return id >= 0 && id < nodes_.size() ? nodes_[id] : nullptr;
+}
+
+QDataflowConnection * QDataflowCanvas::connectionItem(int id) const
+{
+    return id >= 0 && id < connections_.size() ? connections_[id] : nullptr;
 }
 
 void QDataflowCanvas::raiseItem(QGraphicsItem *item)
 {
-    qreal maxZ = 0;
-    for(auto *item1 : as_const(item->collidingItems(Qt::IntersectsItemBoundingRect)))
-        maxZ = qMax(maxZ, item1->zValue());
-    item->setZValue(maxZ + 1);
+    // every raise hands out the next z value, so the raised item ends up
+    // above everything without looking at what it overlaps; a qreal
+    // counts exactly up to 2^53 raises
+    if(owner_ != this)
+    {
+        owner_->raiseItem(item);
+        return;
+    }
+    item->setZValue(++topZValue_);
 
-    if(QDataflowNode *node = dynamic_cast<QDataflowNode*>(item))
+    if(item->type() == QDataflowItemTypeNode)
     {
-        for(int i = 0; i < node->inletCount(); i++)
+        QDataflowNode *node = static_cast<QDataflowNode*>(item);
+        for(auto *inlet : as_const(node->inlets_))
         {
-            QDataflowInlet *inlet = node->inlet(i);
-            for(auto *conn : as_const(inlet->connections()))
-            {
-                raiseItem(conn);
-            }
+            for(auto *conn : as_const(inlet->connections_))
+                conn->setZValue(++topZValue_);
         }
-        for(int i = 0; i < node->outletCount(); i++)
+        for(auto *outlet : as_const(node->outlets_))
         {
-            QDataflowOutlet *outlet = node->outlet(i);
-            for(auto *conn : as_const(outlet->connections()))
-            {
-                raiseItem(conn);
-            }
+            for(auto *conn : as_const(outlet->connections_))
+                conn->setZValue(++topZValue_);
         }
     }
 }
 
-bool QDataflowCanvas::showIOletTooltips()
-{
-    return showIOletsTooltips_;
+QDataflowNode * QDataflowCanvas::nodeAt(const QPointF &scenePos) const
+{
+    if(owner_ != this) return owner_->nodeAt(scenePos);
+    QDataflowNode *ret = nullptr;
+    for(auto *item : as_const(indexedItemsAt(scenePos)))
+    {
+        if(item->type() != QDataflowItemTypeNode) continue;
+        if(ret && ret->zValue() >= item->zValue()) continue;
+        if(item->sceneBoundingRect().contains(scenePos))
+            ret = static_cast<QDataflowNode*>(item);
+    }
+    return ret;
+}
+
+QDataflowInlet * QDataflowCanvas::inletAt(const QPointF &scenePos) const
+{
+    if(owner_ != this) return owner_->inletAt(scenePos);
+    QList<QDataflowNode*> candidates;
+    for(auto *item : as_const(indexedItemsAt(scenePos)))
+    {
+        if(item->type() == QDataflowItemTypeNode)
+            candidates.push_back(static_cast<QDataflowNode*>(item));
+    }
+    std::sort(candidates.begin(), candidates.end(), [](QDataflowNode *a, QDataflowNode *b){
+        return a->zValue() > b->zValue();
+    });
+
+    for(auto *uinode : as_const(candidates))
+    {
+        for(auto *inlet : as_const(uinode->inlets_))
+        {
+            if(inlet->isVisible() && inlet->sceneBoundingRect().contains(scenePos))
+                return inlet;
+        }
+    }
+    return {};
+}
+
+QDataflowConnection * QDataflowCanvas::connectionAt(const QPointF &scenePos) const
+{
+    if(owner_ != this) return owner_->connectionAt(scenePos);
+    QDataflowConnection *ret = nullptr;
+    for(auto *item : as_const(indexedItemsAt(scenePos)))
+    {
+        if(item->type() != QDataflowItemTypeConnection) continue;
+        if(ret && ret->zValue() >= item->zValue()) continue;
+        if(item->contains(item->mapFromScene(scenePos)))
+            ret = static_cast<QDataflowConnection*>(item);
+    }
+    return ret;
+}
+
+QList<QDataflowNode*> QDataflowCanvas::nodesIn(const QRectF &sceneRect) const
+{
+    if(owner_ != this) return owner_->nodesIn(sceneRect);
+    QList<QDataflowNode*> ret;
+    for(auto *item : as_const(index_.items(sceneRect)))
+    {
+        if(item->type() != QDataflowItemTypeNode || item->scene() != scene()) continue;
+        if(item->sceneBoundingRect().intersects(sceneRect))
+            ret.push_back(static_cast<QDataflowNode*>(item));
+    }
+    return ret;
+}
+
+void QDataflowCanvas::highlightCompatibleInlets(QDataflowOutlet *outlet)
+{
+    clearHighlightedInlets();
+    if(!model_) return;
+
+    const QDataflowGraph &graph = model_->graph();
+    const QDataflowTypeRegistry *types = model_->typeRegistry();
+    const QDataflowGraph::TypeId outletType = graph.outletType(outlet->node()->modelNode()->id(), outlet->index());
+    for(auto *uinode : as_const(nodesIn(visibleSceneRect())))
+    {
+        const QDataflowGraph::NodeId id = uinode->modelNode()->id();
+        const int n = std::min(uinode->inlets_.size(), graph.inletCount(id));
+        for(int i = 0; i < n; i++)
+        {
+            if(!types->isCompatible(outletType, graph.inletType(id, i))) continue;
+            QDataflowInlet *inlet = uinode->inlets_[i];
+            inlet->setHighlighted(true);
+            highlightedInlets_.insert(inlet);
+        }
+    }
+}
+
+void QDataflowCanvas::clearHighlightedInlets()
+{
+    for(auto *inlet : as_const(highlightedInlets_))
+        inlet->setHighlighted(false);
+    highlightedInlets_.clear();
+}
+
+QList<QDataflowConnection*> QDataflowCanvas::connectionsIn(const QRectF &sceneRect) const
+{
+    if(owner_ != this) return owner_->connectionsIn(sceneRect);
+    QList<QDataflowConnection*> ret;
+    for(auto *item : as_const(index_.items(sceneRect)))
+    {
+        if(item->type() != QDataflowItemTypeConnection || item->scene() != scene()) continue;
+        auto *uiconn = static_cast<QDataflowConnection*>(item);
+        if(uiconn->geometry_.intersects(uiconn->mapRectFromScene(sceneRect)))
+            ret.push_back(uiconn);
+    }
+    return ret;
+}
+
+void QDataflowCanvas::updateIndex(QDataflowNode *uinode)
+{
+    if(uinode->scene() != scene()) return;
+    const qreal m = indexPickMargin;
+    index_.insert(uinode, uinode->sceneBoundingRect().adjusted(-m, -m, m, m));
+}
+
+void QDataflowCanvas::updateIndex(QDataflowConnection *uiconn)
+{
+    if(uiconn->scene() != scene()) return;
+    const QLineF line(uiconn->mapToScene(uiconn->geometry_.source), uiconn->mapToScene(uiconn->geometry_.dest));
+    index_.insert(uiconn, line);
+
+    // each connection owns one slot of the line buffer
+    if(uiconn->slot_ < 0)
+    {
+        uiconn->slot_ = connectionLines_.size();
+        connectionLines_.push_back(line);
+        connectionSlots_.push_back(uiconn);
+    }
+    else
+    {
+        connectionLines_[uiconn->slot_] = line;
+    }
+}
+
+void QDataflowCanvas::removeConnectionItem(QDataflowConnection *uiconn)
+{
+    index_.remove(uiconn);
+    rubberBandSelection_.remove(uiconn);
+    selectedConnections_.remove(uiconn);
+    if(hoveredConnection_ == uiconn)
+        hoveredConnection_ = nullptr;
+
+    // keep the line buffer dense: the last slot moves into the hole
+    if(uiconn->slot_ >= 0)
+    {
+        QDataflowConnection *last = connectionSlots_.back();
+        connectionLines_[uiconn->slot_] = connectionLines_.back();
+        connectionSlots_[uiconn->slot_] = last;
+        last->slot_ = uiconn->slot_;
+        connectionLines_.pop_back();
+        connectionSlots_.pop_back();
+        uiconn->slot_ = -1;
+    }
+
+    // iolets must not keep adjusting a connection that is gone
+    uiconn->source()->removeConnection(uiconn);
+    uiconn->dest()->removeConnection(uiconn);
+
+    if(uiconn->scene() == scene())
+        scene()->removeItem(uiconn);
+    if(itemOf(uiconn->modelConnection()) == uiconn)
+        connections_[uiconn->modelConnection()->lastId()] = nullptr;
+    ownedConnections_.insert(uiconn);
+}
+
+bool QDataflowCanvas::paintsConnections(const QPainter *painter) const
+{
+    return batchedConnections_ || isLowDetail(painter);
+}
+
+QDataflowNode * QDataflowCanvas::createNodeItem(QDataflowModelNode *mdlnode)
+{
+    QDataflowNode *uinode = new QDataflowNode(this, mdlnode);
+    const int id = mdlnode->id();
+    if(id >= nodes_.size()) nodes_.resize(id + 1);
+    nodes_[id] = uinode;
+    scene()->addItem(uinode);
+    updateIndex(uinode);
+    return uinode;
+}
+
+QDataflowConnection * QDataflowCanvas::createConnectionItem(QDataflowModelConnection *mdlconn)
+{
+    // a connection item hangs between two iolet items
+    if(lazyItems_ && (!itemOf(mdlconn->source()->node()) || !itemOf(mdlconn->dest()->node())))
+        return {};
+
+    // not in the graph: its nodes are not part of the model either
+    const int id = mdlconn->id();
+    if(id < 0) return {};
+
+    QDataflowConnection *uiconn = new QDataflowConnection(this, mdlconn);
+    if(id >= connections_.size()) connections_.resize(id + 1);
+    connections_[id] = uiconn;
+    scene()->addItem(uiconn);
+    updateIndex(uiconn);
+    raiseItem(uiconn);
+    return uiconn;
+}
+
+void QDataflowCanvas::releaseNodeItem(QDataflowNode *uinode)
+{
+    // unlike removed items these are not referenced by any pending event,
+    // so they are deleted right away and their pool slots reused
+    // a connection from the node to itself is on both lists
+    QSet<QDataflowConnection*> conns;
+    for(auto *inlet : as_const(uinode->inlets_))
+        for(auto *uiconn : as_const(inlet->connections_))
+            conns.insert(uiconn);
+    for(auto *outlet : as_const(uinode->outlets_))
+        for(auto *uiconn : as_const(outlet->connections_))
+            conns.insert(uiconn);
+    for(auto *uiconn : as_const(conns))
+    {
+        removeConnectionItem(uiconn);
+        ownedConnections_.remove(uiconn);
+        delete uiconn;
+    }
+
+    index_.remove(uinode);
+    rubberBandSelection_.remove(uinode);
+    movedNodes_.remove(uinode);
+    dirtyNodes_.remove(uinode);
+    selectedNodes_.remove(uinode);
+    if(editNode_ == uinode) editNode_ = nullptr;
+    scene()->removeItem(uinode);
+    nodes_[uinode->modelNode()->lastId()] = nullptr;
+    delete uinode;
+}
+
+void QDataflowCanvas::createConnectionItems(int id)
+{
+    // only the edges to nodes that have items: walking the iolets'
+    // connections() would create the objects of every peer node
+    const QDataflowGraph &graph = model_->graph();
+    QVector<QDataflowGraph::EdgeId> edges;
+    for(QDataflowGraph::EdgeId e : graph.outEdges(id))
+        if(nodeItem(graph.edgeDest(e))) edges.push_back(e);
+    for(QDataflowGraph::EdgeId e : graph.inEdges(id))
+        if(nodeItem(graph.edgeSource(e))) edges.push_back(e);
+    for(QDataflowGraph::EdgeId e : as_const(edges))
+        if(!connectionItem(e))
+            createConnectionItem(model_->connectionById(e));
+}
+
+void QDataflowCanvas::addNodeById(int id)
+{
+    if(lazyItems_)
+    {
+        // the next lazy update creates the item if it is in view
+        lazyNodeIndex_.insert(id, QRectF(model_->graph().pos(id), QSizeF(1, 1)));
+        return;
+    }
+    QDataflowModelNode *mdlnode = model_->nodeById(id);
+    if(mdlnode && !itemOf(mdlnode)) createNodeItem(mdlnode);
+}
+
+void QDataflowCanvas::addConnectionById(int id)
+{
+    const QDataflowGraph &graph = model_->graph();
+    const int s = graph.edgeSource(id), d = graph.edgeDest(id);
+    if(lazyItems_)
+    {
+        lazyEdgeIndex_.insert(id, QLineF(graph.pos(s), graph.pos(d)));
+        // a connection item needs the items of both nodes
+        if(!nodeItem(s) || !nodeItem(d)) return;
+    }
+    QDataflowModelConnection *mdlconn = model_->connectionById(id);
+    if(mdlconn && !itemOf(mdlconn)) createConnectionItem(mdlconn);
+}
+
+QRectF QDataflowCanvas::lazyItemRect(qreal margin) const
+{
+    const QRectF visible = visibleSceneRect();
+    return visible.adjusted(-margin, -margin, margin, margin);
+}
+
+void QDataflowCanvas::scheduleLazyItemsUpdate()
+{
+    if(lazyItems_)
+        lazyItemsTimer_.start();
+}
+
+void QDataflowCanvas::updateLazyItems()
+{
+    if(!lazyItems_ || !model_) return;
+
+    // dragged positions have to be in the graph before it is looked up
+    flushMovedNodes();
+    flushDirtyNodes();
+
+    // only what the lazy index files near the view is looked at; nodes
+    // without an item are known by their position only
+    const QRectF live = lazyItemRect(lazyItemMargin_);
+    // items are released further out than they are created, so panning
+    // back and forth over the edge does not thrash
+    const QRectF keep = lazyItemRect(2 * lazyItemMargin_);
+    const QDataflowGraph &graph = model_->graph();
+
+    QSet<int> wanted;
+    for(int id : as_const(lazyNodeIndex_.items(live)))
+        if(graph.containsNode(id) && live.contains(graph.pos(id)))
+            wanted.insert(id);
+
+    // a connection crossing the view needs both of its nodes
+    QDataflowConnectionGeometry segment;
+    for(int e : as_const(lazyEdgeIndex_.items(live)))
+    {
+        if(!graph.containsEdge(e)) continue;
+        const int s = graph.edgeSource(e), d = graph.edgeDest(e);
+        if(wanted.contains(s) && wanted.contains(d)) continue;
+        segment.source = graph.pos(s);
+        segment.dest = graph.pos(d);
+        if(segment.intersects(live))
+        {
+            wanted.insert(s);
+            wanted.insert(d);
+        }
+    }
+
+    QList<QDataflowNode*> released;
+    for(auto *item : as_const(index_.items()))
+    {
+        if(item->type() != QDataflowItemTypeNode) continue;
+        auto *uinode = static_cast<QDataflowNode*>(item);
+        const int id = uinode->modelNode()->id();
+        if(id >= 0 && (wanted.contains(id) || uinode->sceneBoundingRect().intersects(keep))) continue;
+        if(uinode->isSelected() || uinode->isInEditMode() || uinode->isUnderMouse()) continue;
+        released.push_back(uinode);
+    }
+    for(auto *uinode : as_const(released))
+        releaseNodeItem(uinode);
+
+    QList<QDataflowNode*> created;
+    for(int id : as_const(wanted))
+    {
+        QDataflowModelNode *mdlnode = model_->nodeById(id);
+        if(!mdlnode || itemOf(mdlnode)) continue;
+        created.push_back(createNodeItem(mdlnode));
+    }
+    for(auto *uinode : as_const(created))
+        createConnectionItems(uinode->modelNode()->id());
+
+    // the scroll range covers the whole model, not only the items, and
+    // shrinks again as nodes are removed
+    QRectF bounds = lazyNodeIndex_.bounds();
+    if(!bounds.isNull())
+        bounds.adjust(-lazyItemMargin_, -lazyItemMargin_, lazyItemMargin_, lazyItemMargin_);
+    scene()->setSceneRect(bounds | scene()->itemsBoundingRect() | visibleSceneRect());
+}
+
+void QDataflowCanvas::updateLazyIndex(QDataflowModelNode *mdlnode)
+{
+    if(!lazyItems_) return;
+    const int id = mdlnode->id();
+    if(id < 0) return;
+    const QDataflowGraph &graph = model_->graph();
+    lazyNodeIndex_.insert(id, QRectF(graph.pos(id), QSizeF(1, 1)));
+    for(int e : graph.outEdges(id))
+        lazyEdgeIndex_.insert(e, QLineF(graph.pos(id), graph.pos(graph.edgeDest(e))));
+    for(int e : graph.inEdges(id))
+        lazyEdgeIndex_.insert(e, QLineF(graph.pos(graph.edgeSource(e)), graph.pos(id)));
+}
+
+void QDataflowCanvas::updateLazyIndex(QDataflowModelConnection *mdlconn)
+{
+    if(!lazyItems_) return;
+    const int e = mdlconn->id();
+    if(e < 0) return;
+    const QDataflowGraph &graph = model_->graph();
+    lazyEdgeIndex_.insert(e, QLineF(graph.pos(graph.edgeSource(e)), graph.pos(graph.edgeDest(e))));
+}
+
+void QDataflowCanvas::removeFromLazyIndex(QDataflowModelNode *mdlnode)
+{
+    lazyNodeIndex_.remove(mdlnode->lastId());
+}
+
+void QDataflowCanvas::removeFromLazyIndex(QDataflowModelConnection *mdlconn)
+{
+    lazyEdgeIndex_.remove(mdlconn->lastId());
+}
+
+void QDataflowCanvas::rebuildLazyIndex()
+{
+    lazyNodeIndex_.clear();
+    lazyEdgeIndex_.clear();
+    if(!lazyItems_ || !model_) return;
+    const QDataflowGraph &graph = model_->graph();
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+        if(graph.containsNode(id))
+            lazyNodeIndex_.insert(id, QRectF(graph.pos(id), QSizeF(1, 1)));
+    for(int e = 0; e < graph.edgeIdBound(); e++)
+        if(graph.containsEdge(e))
+            lazyEdgeIndex_.insert(e, QLineF(graph.pos(graph.edgeSource(e)), graph.pos(graph.edgeDest(e))));
+}
+
+void QDataflowCanvas::scheduleMovedNode(QDataflowNode *uinode)
+{
+    movedNodes_.insert(uinode);
+    if(!movedNodesTimer_.isActive())
+        movedNodesTimer_.start();
+}
+
+void QDataflowCanvas::flushMovedNodes()
+{
+    movedNodesTimer_.stop();
+    if(movedNodes_.isEmpty()) return;
+    QSet<QDataflowNode*> moved;
+    moved.swap(movedNodes_);
+
+    // a connection between two moved nodes is routed once
+    QSet<QDataflowConnection*> conns;
+    for(auto *uinode : as_const(moved))
+    {
+        for(auto *inlet : as_const(uinode->inlets_))
+            for(auto *uiconn : as_const(inlet->connections_))
+                conns.insert(uiconn);
+        for(auto *outlet : as_const(uinode->outlets_))
+            for(auto *uiconn : as_const(outlet->connections_))
+                conns.insert(uiconn);
+        updateIndex(uinode);
+    }
+    for(auto *uiconn : as_const(conns))
+        uiconn->adjust();
+
+    // one change set for the whole selection; the canvas skips the
+    // positions it already has when the transaction is committed
+    QDataflowModelTransaction transaction(model_);
+    for(auto *uinode : as_const(moved))
+        uinode->modelNode()->setPos(QPoint(uinode->pos().x(), uinode->pos().y()));
+}
+
+void QDataflowCanvas::scheduleDirtyNode(QDataflowNode *uinode)
+{
+    dirtyNodes_.insert(uinode);
+    if(!dirtyNodesTimer_.isActive())
+        dirtyNodesTimer_.start();
+}
+
+void QDataflowCanvas::flushDirtyNodes()
+{
+    dirtyNodesTimer_.stop();
+    if(dirtyNodes_.isEmpty()) return;
+    QSet<QDataflowNode*> dirty;
+    dirty.swap(dirtyNodes_);
+    for(auto *uinode : as_const(dirty))
+        uinode->flush();
+}
+
+QList<QGraphicsItem*> QDataflowCanvas::indexedItemsAt(const QPointF &scenePos) const
+{
+    const qreal m = indexPickMargin;
+    QList<QGraphicsItem*> ret = index_.items(QRectF(scenePos - QPointF(m, m), QSizeF(2 * m, 2 * m)));
+    ret.erase(std::remove_if(ret.begin(), ret.end(), [this](QGraphicsItem *item){
+        return item->scene() != scene();
+    }), ret.end());
+    return ret;
+}
+
+bool QDataflowCanvas::showIOletTooltips()
+{
+    return showIOletsTooltips_;
+}
+
+void QDataflowCanvas::setShowIOletTooltips(bool show)
+{
+    showIOletsTooltips_ = show;
+
+    if(show)
+    {
+        if(showObjectHoverFeedback())
+            setShowObjectHoverFeedback(false);
+        if(showConnectionHoverFeedback())
+            setShowConnectionHoverFeedback(false);
+    }
+}
+
+bool QDataflowCanvas::showObjectHoverFeedback()
+{
+    return showObjectHoverFeedback_;
+}
+
+void QDataflowCanvas::setShowObjectHoverFeedback(bool show)
+{
+    showObjectHoverFeedback_ = show;
+
+    if(show)
+    {
+        if(showIOletTooltips())
+            setShowIOletTooltips(false);
+    }
+
+    for(auto *node : as_const(nodes_))
+    {
+        if(node) node->setAcceptHoverEvents(show);
+    }
+}
+
+bool QDataflowCanvas::showConnectionHoverFeedback()
+{
+    return showConnectionHoverFeedback_;
+}
+
+void QDataflowCanvas::setShowConnectionHoverFeedback(bool show)
+{
+    showConnectionHoverFeedback_ = show;
+
+    if(show)
+    {
+        if(showIOletTooltips())
+            setShowIOletTooltips(false);
+    }
+
+    for(auto *conn : as_const(connections_))
+    {
+        if(conn) conn->setAcceptHoverEvents(show && !batchedConnections_);
+    }
+}
+
+qreal QDataflowCanvas::gridSize()
+{
+    return gridSize_;
+}
+
+void QDataflowCanvas::setGridSize(qreal sz)
+{
+    gridSize_ = qMax(1.0, sz);
+
+    if(drawGrid_)
+        updateViewports(true);
+}
+
+bool QDataflowCanvas::drawGrid()
+{
+    return drawGrid_;
+}
+
+void QDataflowCanvas::setDrawGrid(bool draw)
+{
+    if(draw == drawGrid_) return;
+
+    drawGrid_ = draw;
+    updateViewports(true);
+}
+
+qreal QDataflowCanvas::levelOfDetailThreshold() const
+{
+    return levelOfDetailThreshold_;
+}
+
+void QDataflowCanvas::setLevelOfDetailThreshold(qreal threshold)
+{
+    levelOfDetailThreshold_ = qMax(0.0, threshold);
+    updateViewports();
+}
+
+bool QDataflowCanvas::isLowDetail(const QPainter *painter) const
+{
+    return QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform()) < levelOfDetailThreshold_;
+}
+
+bool QDataflowCanvas::batchedConnections() const
+{
+    return batchedConnections_;
+}
+
+void QDataflowCanvas::setBatchedConnections(bool batched)
+{
+    batchedConnections_ = batched;
+    hoveredConnection_ = nullptr;
+
+    // hover is tracked by the canvas from the index while batched
+    for(auto *conn : as_const(connections_))
+        if(conn) conn->setAcceptHoverEvents(showConnectionHoverFeedback_ && !batched);
+
+    updateViewports();
+}
+
+bool QDataflowCanvas::isOpenGLViewport() const
+{
+#ifndef QT_NO_OPENGL
+    return qobject_cast<QOpenGLWidget*>(viewport());
+#else
+    return false;
+#endif
+}
+
+void QDataflowCanvas::setOpenGLViewport(bool enable)
+{
+#ifndef QT_NO_OPENGL
+    if(enable == isOpenGLViewport()) return;
+
+    // the rubber band lives on the old viewport
+    delete rubberBand_;
+    rubberBand_ = nullptr;
+    rubberBandSelection_.clear();
+
+    if(enable)
+    {
+        setViewport(new QOpenGLWidget);
+        setViewportUpdateMode(FullViewportUpdate);
+    }
+    else
+    {
+        setViewport(new QWidget);
+        setViewportUpdateMode(BoundingRectViewportUpdate);
+    }
+#else
+    if(enable)
+        qWarning() << this << "built without OpenGL support";
+#endif
+}
+
+bool QDataflowCanvas::lazyItems() const
+{
+    return lazyItems_;
+}
+
+void QDataflowCanvas::setLazyItems(bool lazy)
+{
+    if(lazy == lazyItems_) return;
+
+    lazyItems_ = lazy;
+
+    rebuildLazyIndex();
+    if(lazy)
+    {
+        updateLazyItems();
+        return;
+    }
+
+    lazyItemsTimer_.stop();
+    if(!model_) return;
+    // every element gets an item now, and with it its model object
+    const QDataflowGraph &graph = model_->graph();
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+        if(graph.containsNode(id) && !nodeItem(id))
+            createNodeItem(model_->nodeById(id));
+    for(int e = 0; e < graph.edgeIdBound(); e++)
+        if(graph.containsEdge(e) && !connectionItem(e))
+            createConnectionItem(model_->connectionById(e));
+}
+
+qreal QDataflowCanvas::lazyItemMargin() const
+{
+    return lazyItemMargin_;
+}
+
+void QDataflowCanvas::setLazyItemMargin(qreal margin)
+{
+    lazyItemMargin_ = qMax(0.0, margin);
+    scheduleLazyItemsUpdate();
+}
+
+bool QDataflowCanvas::profilerOverlay() const
+{
+    return profilerOverlay_;
+}
+
+void QDataflowCanvas::setProfilerOverlay(bool show)
+{
+    if(show == profilerOverlay_) return;
+
+    profilerOverlay_ = show;
+
+    if(show)
+    {
+        profilerWasEnabled_ = model_->profiler()->isEnabled();
+        model_->profiler()->setEnabled(true);
+        profilerOverlayTimer_.start();
+        updateProfilerOverlay();
+        return;
+    }
+
+    profilerOverlayTimer_.stop();
+    if(model_) model_->profiler()->setEnabled(profilerWasEnabled_);
+    for(auto *uinode : as_const(nodes_))
+        if(uinode) uinode->setHeat(0);
 }
 
-void QDataflowCanvas::setShowIOletTooltips(bool show)
+void QDataflowCanvas::updateProfilerOverlay()
 {
-    showIOletsTooltips_ = show;
+    if(!model_) return;
 
-    if(show)
+    const QDataflowProfile profile = model_->profiler()->profile();
+    qint64 hottest = 0;
+    for(const QDataflowProfile::Node &n : profile.nodes)
+        hottest = qMax(hottest, n.selfNs);
+
+    for(auto *uinode : as_const(nodes_))
     {
-        if(showObjectHoverFeedback())
-            setShowObjectHoverFeedback(false);
-        if(showConnectionHoverFeedback())
-            setShowConnectionHoverFeedback(false);
+        if(!uinode) continue;
+        const qint64 self = profile.node(uinode->modelNode()->id()).selfNs;
+        uinode->setHeat(hottest > 0 ? qreal(self) / hottest : 0);
     }
 }
 
-bool QDataflowCanvas::showObjectHoverFeedback()
+void QDataflowCanvas::drawBackground(QPainter *painter, const QRectF &rect)
 {
-    return showObjectHoverFeedback_;
+    QGraphicsView::drawBackground(painter, rect);
+
+    if(!owner_->drawGrid_) return;
+
+    const qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    if(scale <= 0) return;
+
+    // skip every other line until the points are a few pixels apart;
+    // the ones left are still multiples of gridSize_
+    qreal step = owner_->gridSize_;
+    while(step * scale < minGridSpacing)
+        step *= 2;
+
+    const qreal x0 = qCeil(rect.left() / step) * step, y0 = qCeil(rect.top() / step) * step;
+    const int nx = qMax(0, qFloor((rect.right() - x0) / step) + 1);
+    const int ny = qMax(0, qFloor((rect.bottom() - y0) / step) + 1);
+
+    // one drawPoints() call; the buffer keeps its capacity between exposes
+    gridPoints_.resize(nx * ny);
+    QPoint *p = gridPoints_.data();
+    for(int j = 0; j < ny; j++)
+    {
+        const int y = int(y0 + j * step);
+        for(int i = 0; i < nx; i++)
+            *p++ = QPoint(int(x0 + i * step), y);
+    }
+
+    painter->setPen(QPen(Qt::gray));
+    painter->drawPoints(gridPoints_.constData(), gridPoints_.size());
 }
 
-void QDataflowCanvas::setShowObjectHoverFeedback(bool show)
+void QDataflowCanvas::drawForeground(QPainter *painter, const QRectF &rect)
 {
-    showObjectHoverFeedback_ = show;
+    QGraphicsView::drawForeground(painter, rect);
 
-    if(show)
+    // connection items don't paint themselves when batched or in low
+    // detail: the lines crossing the exposed rect, found through the
+    // scene index, go out in one drawLines() call, and only the
+    // highlighted connections are drawn one by one
+    const QDataflowCanvas *owner = owner_;
+    if(!owner->paintsConnections(painter)) return;
+
+    const bool lowDetail = owner->isLowDetail(painter);
+    const qreal width = lowDetail ? 0 : 2;
+
+    const QList<QDataflowConnection*> exposed = connectionsIn(rect);
+    QVector<QLineF> lines;
+    lines.reserve(exposed.size());
+    QList<QDataflowConnection*> highlighted;
+    for(auto *uiconn : exposed)
     {
-        if(showIOletTooltips())
-            setShowIOletTooltips(false);
+        lines.push_back(owner->connectionLines_[uiconn->slot_]);
+        if(uiconn->isSelected() || uiconn == owner->hoveredConnection_)
+            highlighted.push_back(uiconn);
     }
+    painter->setPen(QPen(Qt::black, width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter->drawLines(lines);
 
-    for (auto *node : as_const(nodes_))
+    for(auto *uiconn : as_const(highlighted))
     {
-        node->setAcceptHoverEvents(show);
+        const bool sel = uiconn->isSelected();
+        if(!lowDetail)
+            painter->fillPath(uiconn->mapToScene(uiconn->shape()), sel ? Qt::cyan : Qt::gray);
+        painter->setPen(QPen(sel ? Qt::blue : Qt::black, width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+        painter->drawLine(owner->connectionLines_[uiconn->slot_]);
     }
 }
 
-bool QDataflowCanvas::showConnectionHoverFeedback()
+void QDataflowCanvas::mousePressEvent(QMouseEvent *event)
 {
-    return showConnectionHoverFeedback_;
+    // hit testing needs the current node sizes
+    owner_->flushDirtyNodes();
+
+    if(event->button() == Qt::LeftButton && model())
+    {
+        // a press without the release of the previous one
+        closePressCommand();
+        pressCommandModel_ = model();
+        pressCommandModel_->undoLog()->beginCommand();
+    }
+
+    QGraphicsView::mousePressEvent(event);
+
+    if(event->button() != Qt::LeftButton || scene()->mouseGrabberItem()) return;
+
+    // the scene has already cleared the selection unless Ctrl is held
+    const QPointF p = mapToScene(event->pos());
+    if(nodeAt(p) || connectionAt(p)) return;
+
+    if(!rubberBand_)
+        rubberBand_ = new QRubberBand(QRubberBand::Rectangle, viewport());
+    rubberBandOrigin_ = event->pos();
+    owner_->rubberBandSelection_.clear();
+    rubberBand_->setGeometry(QRect(rubberBandOrigin_, QSize()));
+    rubberBand_->show();
 }
 
-void QDataflowCanvas::setShowConnectionHoverFeedback(bool show)
+void QDataflowCanvas::mouseMoveEvent(QMouseEvent *event)
 {
-    showConnectionHoverFeedback_ = show;
+    QGraphicsView::mouseMoveEvent(event);
 
-    if(show)
+    // the release went elsewhere, such as to a popup
+    if(!(event->buttons() & Qt::LeftButton))
+        closePressCommand();
+
+    QDataflowCanvas *owner = owner_;
+    if(owner->batchedConnections_ && owner->showConnectionHoverFeedback_)
     {
-        if(showIOletTooltips())
-            setShowIOletTooltips(false);
+        QDataflowConnection *hovered = connectionAt(mapToScene(event->pos()));
+        if(hovered != owner->hoveredConnection_)
+        {
+            if(owner->hoveredConnection_)
+                scene()->update(owner->hoveredConnection_->sceneBoundingRect());
+            if(hovered)
+                scene()->update(hovered->sceneBoundingRect());
+            owner->hoveredConnection_ = hovered;
+        }
     }
 
-    for(auto *conn : as_const(connections_))
+    if(!rubberBand_ || !rubberBand_->isVisible()) return;
+
+    const QRect r = QRect(rubberBandOrigin_, event->pos()).normalized();
+    rubberBand_->setGeometry(r);
+
+    const QRectF sceneRect = mapToScene(r).boundingRect();
+    QSet<QGraphicsItem*> inside;
+    for(auto *uinode : as_const(nodesIn(sceneRect)))
+        inside.insert(uinode);
+    for(auto *uiconn : as_const(connectionsIn(sceneRect)))
+        inside.insert(uiconn);
+
+    // only touch items whose state changes; items that were selected before
+    // the drag started (Ctrl) are left alone
+    QSet<QGraphicsItem*> selection;
+    for(auto *item : as_const(owner->rubberBandSelection_))
+    {
+        if(inside.contains(item))
+            selection.insert(item);
+        else
+            item->setSelected(false);
+    }
+    for(auto *item : as_const(inside))
     {
-        conn->setAcceptHoverEvents(show);
+        if(item->isSelected()) continue;
+        item->setSelected(true);
+        selection.insert(item);
     }
+    owner->rubberBandSelection_ = selection;
 }
 
-qreal QDataflowCanvas::gridSize()
+void QDataflowCanvas::mouseReleaseEvent(QMouseEvent *event)
 {
-    return gridSize_;
-}
+    QGraphicsView::mouseReleaseEvent(event);
 
-void QDataflowCanvas::setGridSize(qreal sz)
-{
-    gridSize_ = qMax(1.0, sz);
+    // the end of a drag is written to the model right away
+    owner_->flushMovedNodes();
+
+    if(event->button() == Qt::LeftButton)
+        closePressCommand();
+
+    if(rubberBand_ && event->button() == Qt::LeftButton)
+    {
+        rubberBand_->hide();
+        owner_->rubberBandSelection_.clear();
+    }
 }
 
-bool QDataflowCanvas::drawGrid()
+void QDataflowCanvas::focusOutEvent(QFocusEvent *event)
 {
-    return drawGrid_;
+    // the release may never come back to this canvas
+    closePressCommand();
+    QGraphicsView::focusOutEvent(event);
 }
 
-void QDataflowCanvas::setDrawGrid(bool draw)
+void QDataflowCanvas::leaveEvent(QEvent *event)
 {
-    drawGrid_ = draw;
+    closePressCommand();
+    QGraphicsView::leaveEvent(event);
 }
 
-void QDataflowCanvas::drawBackground(QPainter *painter, const QRectF &rect)
+void QDataflowCanvas::closePressCommand()
 {
-    QGraphicsView::drawBackground(painter, rect);
-
-    if(drawGrid_)
-    {
-        painter->setPen(QPen(Qt::gray));
-        for(qreal y = qCeil(rect.top() / gridSize_) * gridSize_; y <= rect.bottom(); y += gridSize_)
-        {
-            for(qreal x = qCeil(rect.left() / gridSize_) * gridSize_; x <= rect.right(); x += gridSize_)
-            {
-                painter->drawPoint(int(x), int(y));
-            }
-        }
-    }
+    if(!pressCommandModel_) return;
+    // whatever was dragged so far belongs to the command
+    owner_->flushMovedNodes();
+    QDataflowModel *model = pressCommandModel_;
+    pressCommandModel_ = nullptr;
+    model->undoLog()->endCommand();
 }
 
 void QDataflowCanvas::mouseDoubleClickEvent(QMouseEvent *event)
 {
-    QGraphicsItem *item = itemAt(event->pos());
-    if(!item)
+    const QPointF p = mapToScene(event->pos());
+    if(!nodeAt(p) && !connectionAt(p))
     {
-        QPoint pos(mapToScene(event->pos()).toPoint());
-        model_->create(pos, "", 0, 0);
+        QPoint pos(p.toPoint());
+        model()->create(pos, "", 0, 0);
         event->accept();
         return;
     }
@@ -309,6 +1333,8 @@ void QDataflowCanvas::keyPressEvent(QKeyEvent *event)
 
     if(event->key() == Qt::Key_Backspace && !isSomeNodeInEditMode())
     {
+        // one undo command
+        QDataflowModelTransaction transaction(model());
         for(auto *conn : as_const(selectedConnections()))
             model()->disconnect(
                         conn->source()->node()->modelNode(), conn->source()->index(),
@@ -322,6 +1348,59 @@ void QDataflowCanvas::keyPressEvent(QKeyEvent *event)
     QGraphicsView::keyPressEvent(event);
 }
 
+void QDataflowCanvas::wheelEvent(QWheelEvent *event)
+{
+    if(event->modifiers() & Qt::ControlModifier)
+    {
+        const qreal factor = qPow(1.2, event->angleDelta().y() / 120.0);
+        scale(factor, factor);
+        resetCachedContent(); // the grid density depends on the zoom
+        owner_->scheduleLazyItemsUpdate();
+        event->accept();
+        return;
+    }
+
+    QGraphicsView::wheelEvent(event);
+}
+
+void QDataflowCanvas::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    owner_->scheduleLazyItemsUpdate();
+}
+
+void QDataflowCanvas::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    owner_->scheduleLazyItemsUpdate();
+}
+
+void QDataflowCanvas::customEvent(QEvent *event)
+{
+    if(event->type() == QDataflowCompletionEvent::eventType())
+    {
+        auto *completionEvent = static_cast<QDataflowCompletionEvent*>(event);
+        if(completionLabel_ && completionEvent->generation_ == completionGeneration_.load())
+            completionLabel_->setCompletion(completionEvent->list_);
+        return;
+    }
+    QGraphicsView::customEvent(event);
+}
+
+void QDataflowCanvas::requestCompletion(QDataflowNodeTextLabel *label, const QString &text)
+{
+    const quint64 generation = ++completionGeneration_;
+    completionLabel_ = label;
+    if(!completion_) return;
+    completionPool_.start(new QDataflowCompletionTask(this, completion_, &completionGeneration_, generation, text));
+}
+
+void QDataflowCanvas::cancelCompletion()
+{
+    ++completionGeneration_;
+    completionLabel_ = nullptr;
+}
+
 void QDataflowCanvas::itemTextEditorTextChange()
 {
     QObject *senderParent = sender()->parent();
@@ -334,15 +1413,23 @@ void QDataflowCanvas::itemTextEditorTextChange()
     if(!item) return;
     QDataflowNode *node = dynamic_cast<QDataflowNode*>(item);
     if(!node) return;
-    node->adjust();
+    node->markDirty(QDataflowNode::GeometryDirty);
     txtItem->complete();
 }
 
 void QDataflowCanvas::onNodeAdded(QDataflowModelNode *mdlnode)
 {
-    QDataflowNode *uinode = new QDataflowNode(this, mdlnode);
-    nodes_[mdlnode] = uinode;
-    scene()->addItem(uinode);
+    updateLazyIndex(mdlnode);
+
+    // offscreen nodes stay in the model only; a new empty node is about
+    // to be edited and always gets its item
+    if(lazyItems_ && mdlnode->text() != "" && !lazyItemRect(lazyItemMargin_).contains(mdlnode->pos()))
+    {
+        scheduleLazyItemsUpdate();
+        return;
+    }
+
+    QDataflowNode *uinode = createNodeItem(mdlnode);
 
     if(mdlnode->text() == "")
     {
@@ -352,63 +1439,166 @@ void QDataflowCanvas::onNodeAdded(QDataflowModelNode *mdlnode)
 
 void QDataflowCanvas::onNodeRemoved(QDataflowModelNode *mdlnode)
 {
+    removeFromLazyIndex(mdlnode);
     QDataflowNode *uinode = node(mdlnode);
+    if(!uinode) return;
     if(uinode->isInEditMode())
         uinode->exitEditMode(true);
+    if(completionLabel_ == uinode->textItem_)
+        cancelCompletion();
+    movedNodes_.remove(uinode);
+    dirtyNodes_.remove(uinode);
+    selectedNodes_.remove(uinode);
+    if(editNode_ == uinode) editNode_ = nullptr;
+    index_.remove(uinode);
+    rubberBandSelection_.remove(uinode);
     scene()->removeItem(uinode);
+    nodes_[mdlnode->lastId()] = nullptr;
+    ownedNodes_.insert(uinode);
 }
 
 void QDataflowCanvas::onNodeValidChanged(QDataflowModelNode *mdlnode, bool valid)
 {
     QDataflowNode *uinode = node(mdlnode);
+    if(!uinode) return;
     uinode->setValid(valid);
 }
 
 void QDataflowCanvas::onNodePosChanged(QDataflowModelNode *mdlnode, const QPoint &pos)
 {
+    updateLazyIndex(mdlnode);
     QDataflowNode *uinode = node(mdlnode);
     if(uinode)
     {
+        // a position synced from a drag is already applied
+        if(uinode->pos() == QPointF(pos)) return;
         uinode->setFlag(QGraphicsItem::ItemSendsGeometryChanges, false);
         uinode->setPos(pos);
         uinode->setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
+        uinode->markDirty(QDataflowNode::ConnectionsDirty);
+    }
+    else
+    {
+        // may have moved into view
+        scheduleLazyItemsUpdate();
     }
 }
 
 void QDataflowCanvas::onNodeTextChanged(QDataflowModelNode *mdlnode, const QString &text)
 {
     QDataflowNode *uinode = node(mdlnode);
+    if(!uinode) return;
     uinode->setText(text);
 }
 
 void QDataflowCanvas::onNodeInletCountChanged(QDataflowModelNode *mdlnode, int count)
 {
     QDataflowNode *uinode = node(mdlnode);
+    if(!uinode) return;
     uinode->setInletCount(count);
 }
 
 void QDataflowCanvas::onNodeOutletCountChanged(QDataflowModelNode *mdlnode, int count)
 {
     QDataflowNode *uinode = node(mdlnode);
+    if(!uinode) return;
     uinode->setOutletCount(count);
 }
 
+void QDataflowCanvas::onNodeInletTypesChanged(QDataflowModelNode *mdlnode)
+{
+    QDataflowNode *uinode = node(mdlnode);
+    if(!uinode) return;
+    uinode->updateInletTypes();
+}
+
+void QDataflowCanvas::onNodeOutletTypesChanged(QDataflowModelNode *mdlnode)
+{
+    QDataflowNode *uinode = node(mdlnode);
+    if(!uinode) return;
+    uinode->updateOutletTypes();
+}
+
 void QDataflowCanvas::onConnectionAdded(QDataflowModelConnection *mdlconn)
 {
-    QDataflowConnection *uiconn = new QDataflowConnection(this, mdlconn);
-    connections_[mdlconn] = uiconn;
-    scene()->addItem(uiconn);
-    raiseItem(uiconn);
+    updateLazyIndex(mdlconn);
+    createConnectionItem(mdlconn);
 }
 
 void QDataflowCanvas::onConnectionRemoved(QDataflowModelConnection *mdlconn)
 {
+    removeFromLazyIndex(mdlconn);
     QDataflowConnection *uiconn = connection(mdlconn);
-    scene()->removeItem(uiconn);
+    if(!uiconn) return;
+    removeConnectionItem(uiconn);
+}
+
+void QDataflowCanvas::onTransactionCommitted(const QDataflowModelChangeSet &changes)
+{
+    // apply the whole change set in one pass: each item only recomputes
+    // what changed, once
+    setUpdatesEnabled(false);
+
+    for(auto *mdlconn : changes.removedConnections)
+        onConnectionRemoved(mdlconn);
+
+    for(auto *mdlnode : changes.removedNodes)
+        onNodeRemoved(mdlnode);
+
+    for(auto *mdlnode : changes.addedNodes)
+        onNodeAdded(mdlnode);
+
+    for(int id : changes.addedNodeIds)
+        addNodeById(id);
+
+    for(auto it = changes.changedNodes.constBegin(); it != changes.changedNodes.constEnd(); ++it)
+    {
+        QDataflowModelNode *mdlnode = it.key();
+        const int mask = it.value();
+        if(mask & QDataflowModelChangeSet::PosChanged)
+            updateLazyIndex(mdlnode);
+        QDataflowNode *uinode = node(mdlnode);
+        if(!uinode) continue;
+        if(mask == QDataflowModelChangeSet::PosChanged && uinode->pos() == QPointF(mdlnode->pos()))
+            continue;
+        if(mask & QDataflowModelChangeSet::TextChanged)
+            uinode->setText(mdlnode->text());
+        if(mask & QDataflowModelChangeSet::InletCountChanged)
+            uinode->setInletCount(mdlnode->inletCount(), true);
+        if(mask & QDataflowModelChangeSet::OutletCountChanged)
+            uinode->setOutletCount(mdlnode->outletCount(), true);
+        if(mask & QDataflowModelChangeSet::InletTypesChanged)
+            uinode->updateInletTypes();
+        if(mask & QDataflowModelChangeSet::OutletTypesChanged)
+            uinode->updateOutletTypes();
+        if(mask & QDataflowModelChangeSet::ValidChanged)
+            uinode->setValid(mdlnode->isValid());
+        if(mask & QDataflowModelChangeSet::PosChanged)
+        {
+            uinode->setFlag(QGraphicsItem::ItemSendsGeometryChanges, false);
+            uinode->setPos(mdlnode->pos());
+            uinode->setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
+            uinode->markDirty(QDataflowNode::ConnectionsDirty);
+        }
+    }
+
+    for(auto *mdlconn : changes.addedConnections)
+        onConnectionAdded(mdlconn);
+
+    for(int id : changes.addedConnectionIds)
+        addConnectionById(id);
+
+    // the view is up to date when transactionCommitted() returns
+    flushDirtyNodes();
+
+    // nodes without items may have been added or moved into view
+    scheduleLazyItemsUpdate();
+
+    setUpdatesEnabled(true);
 }
 
 QDataflowNode::QDataflowNode(QDataflowCanvas *canvas, QDataflowModelNode *modelNode)
-    : canvas_(canvas), modelNode_(modelNode), valid_(true)
+    : canvas_(canvas), modelNode_(modelNode), valid_(true), heat_(0), dirty_(0)
 {
     setFlag(ItemIsMovable);
     setFlag(ItemSendsGeometryChanges);
@@ -425,11 +1615,11 @@ QDataflowNode::QDataflowNode(QDataflowCanvas *canvas, QDataflowModelNode *modelN
     setGraphicsEffect(shadowFx);
 #endif
 
-    inputHeader_ = new QGraphicsRectItem(this);
+    inputHeader_ = new QDataflowNodeRectItem(this, this);
 
-    objectBox_ = new QGraphicsRectItem(this);
+    objectBox_ = new QDataflowNodeRectItem(this, this);
 
-    outputHeader_ = new QGraphicsRectItem(this);
+    outputHeader_ = new QDataflowNodeRectItem(this, this);
 
     textItem_ = new QDataflowNodeTextLabel(this, objectBox_);
     textItem_->document()->setPlainText(modelNode->text());
@@ -461,7 +1651,7 @@ void QDataflowNode::setInletCount(int count, bool skipAdjust)
     {
         QDataflowInlet *lastInlet = inlets_.back();
         for(auto *conn : as_const(lastInlet->connections()))
-            canvas()->scene()->removeItem(conn);
+            canvas()->removeConnectionItem(conn);
         canvas()->scene()->removeItem(lastInlet);
         inlets_.pop_back();
         delete lastInlet;
@@ -478,7 +1668,7 @@ void QDataflowNode::setInletCount(int count, bool skipAdjust)
     }
 
     if(!skipAdjust)
-        adjust();
+        markDirty(GeometryDirty);
 }
 
 void QDataflowNode::setOutletCount(int count, bool skipAdjust)
@@ -487,7 +1677,7 @@ void QDataflowNode::setOutletCount(int count, bool skipAdjust)
     {
         QDataflowOutlet *lastOutlet = outlets_.back();
         for(auto *conn : as_const(lastOutlet->connections()))
-            canvas()->scene()->removeItem(conn);
+            canvas()->removeConnectionItem(conn);
         canvas()->scene()->removeItem(lastOutlet);
         outlets_.pop_back();
         delete lastOutlet;
@@ -504,7 +1694,17 @@ void QDataflowNode::setOutletCount(int count, bool skipAdjust)
     }
 
     if(!skipAdjust)
-        adjust();
+        markDirty(GeometryDirty);
+}
+
+void QDataflowNode::updateInletTypes()
+{
+    markDirty(IOletsDirty);
+}
+
+void QDataflowNode::updateOutletTypes()
+{
+    markDirty(IOletsDirty);
 }
 
 void QDataflowNode::setText(const QString &text)
@@ -521,12 +1721,9 @@ QString QDataflowNode::text() const
 
 void QDataflowNode::setValid(bool valid)
 {
+    if(valid_ == valid) return;
     valid_ = valid;
-
-    inputHeader_->setVisible(valid);
-    outputHeader_->setVisible(valid);
-
-    adjust();
+    markDirty(StyleDirty);
 }
 
 bool QDataflowNode::isValid() const
@@ -534,6 +1731,15 @@ bool QDataflowNode::isValid() const
     return valid_;
 }
 
+void QDataflowNode::setHeat(qreal heat)
+{
+    heat = qBound(0.0, heat, 1.0);
+    if(qFuzzyCompare(heat + 1, heat_ + 1)) return;
+    heat_ = heat;
+    objectBox_->setBrush(objectBrush());
+    update();
+}
+
 void QDataflowNode::adjustConnections() const
 {
     for(auto *inlet : inlets_)
@@ -556,38 +1762,82 @@ QRectF QDataflowNode::boundingRect() const
     return r;
 }
 
+void QDataflowNode::markDirty(int flags)
+{
+    if((dirty_ | flags) == dirty_) return;
+    dirty_ |= flags;
+    canvas_->scheduleDirtyNode(this);
+}
+
 void QDataflowNode::adjust()
 {
-    QRectF r = textItem_->boundingRect();
-    qreal w = std::max(r.width(), std::max(inletsWidth(), outletsWidth()));
+    dirty_ = AllDirty;
+    flush();
+}
 
-    prepareGeometryChange();
+void QDataflowNode::flush()
+{
+    int dirty = dirty_;
+    dirty_ = 0;
 
-    inputHeader_->setPos(0, 0);
-    objectBox_->setPos(0, ioletHeight());
-    outputHeader_->setPos(0, ioletHeight() + r.height());
+    if(dirty & GeometryDirty)
+    {
+        QRectF r = textItem_->boundingRect();
+        qreal w = std::max(r.width(), std::max(inletsWidth(), outletsWidth()));
+        const QRectF box(0, 0, w, r.height());
+
+        // a keystroke that does not change the size costs nothing more
+        if(box != objectBox_->rect())
+        {
+            prepareGeometryChange();
+
+            inputHeader_->setPos(0, 0);
+            objectBox_->setPos(0, ioletHeight());
+            outputHeader_->setPos(0, ioletHeight() + r.height());
+
+            inputHeader_->setRect(0, 0, w, ioletHeight());
+            objectBox_->setRect(box);
+            outputHeader_->setRect(0, 0, w, ioletHeight());
+
+            // the outlets moved with the output header
+            dirty |= ConnectionsDirty;
+        }
+    }
 
-    inputHeader_->setRect(0, 0, w, ioletHeight());
-    objectBox_->setRect(0, 0, w, r.height());
-    outputHeader_->setRect(0, 0, w, ioletHeight());
+    if(dirty & StyleDirty)
+    {
+        // the item setters skip values that did not change
+        QPen pen = objectPen();
+        inputHeader_->setPen(pen);
+        objectBox_->setPen(pen);
+        outputHeader_->setPen(pen);
 
-    QPen pen = objectPen();
-    inputHeader_->setPen(pen);
-    objectBox_->setPen(pen);
-    outputHeader_->setPen(pen);
+        QBrush ob = objectBrush(), hb = headerBrush();
 
-    QBrush ob = objectBrush(), hb = headerBrush();
+        objectBox_->setBrush(ob);
+        outputHeader_->setBrush(hb);
+        inputHeader_->setBrush(hb);
 
-    objectBox_->setBrush(ob);
-    outputHeader_->setBrush(hb);
-    inputHeader_->setBrush(hb);
+        if(textItem_->defaultTextColor() != pen.color())
+            textItem_->setDefaultTextColor(pen.color());
 
-    textItem_->setDefaultTextColor(pen.color());
+        inputHeader_->setVisible(isValid());
+        outputHeader_->setVisible(isValid());
+    }
 
-    inputHeader_->setVisible(isValid());
-    outputHeader_->setVisible(isValid());
+    if(dirty & IOletsDirty)
+    {
+        for(auto *inlet : as_const(inlets_))
+            inlet->tooltip_->setText(modelNode()->inlet(inlet->index())->type());
+        for(auto *outlet : as_const(outlets_))
+            outlet->tooltip_->setText(modelNode()->outlet(outlet->index())->type());
+    }
 
-    adjustConnections();
+    if(dirty & ConnectionsDirty)
+    {
+        adjustConnections();
+        canvas_->updateIndex(this);
+    }
 }
 
 qreal QDataflowNode::inletsWidth() const
@@ -607,7 +1857,10 @@ QPen QDataflowNode::objectPen() const
 
 QBrush QDataflowNode::objectBrush() const
 {
-    return Qt::white;
+    if(heat_ <= 0) return Qt::white;
+    // white through to red
+    const int c = qRound(255 * (1 - heat_));
+    return QColor(255, c, c);
 }
 
 QBrush QDataflowNode::headerBrush() const
@@ -636,6 +1889,15 @@ void QDataflowNode::paint(QPainter *painter, const QStyleOptionGraphicsItem *opt
             hov = canvas()->showObjectHoverFeedback() &&
                 option->state & QStyle::State_MouseOver;
 
+    if(canvas()->isLowDetail(painter))
+    {
+        // children skip painting; the whole node is one box
+        QRectF r = objectBox_->rect();
+        r.setHeight(r.height() + 2 * ioletHeight());
+        painter->fillRect(r, sel ? QBrush(Qt::blue) : heat_ > 0 ? objectBrush() : headerBrush());
+        return;
+    }
+
     if(sel || hov)
     {
         painter->fillRect(boundingRect(), sel ? Qt::cyan : Qt::gray);
@@ -644,6 +1906,7 @@ void QDataflowNode::paint(QPainter *painter, const QStyleOptionGraphicsItem *opt
 
 void QDataflowNode::enterEditMode()
 {
+    canvas_->editNode_ = this;
     oldText_ = text();
     setSelected(true);
     textItem_->setFlag(QGraphicsItem::ItemIsFocusable, true);
@@ -659,6 +1922,8 @@ void QDataflowNode::enterEditMode()
 
 void QDataflowNode::exitEditMode(bool revertText)
 {
+    if(canvas_->editNode_ == this)
+        canvas_->editNode_ = nullptr;
     textItem_->clearCompletion();
     if(revertText)
         textItem_->setPlainText(oldText_);
@@ -684,21 +1949,27 @@ bool QDataflowNode::isInEditMode() const
 QVariant QDataflowNode::itemChange(GraphicsItemChange change, const QVariant &value)
 {
     switch (change) {
-    case ItemPositionHasChanged:
+    case ItemPositionChange:
+        // snapping the proposed position saves a second setPos()
         if(canvas()->gridSize() > 1)
         {
             const qreal gridSize = canvas()->gridSize();
-            QPointF p = pos();
+            QPointF p = value.toPointF();
             p.setX(qRound(p.x() / gridSize) * gridSize);
             p.setY(qRound(p.y() / gridSize) * gridSize);
-            setPos(p);
+            return p;
         }
-        adjustConnections();
-        modelNode_->setPos(QPoint(pos().x(), pos().y()));
+        break;
+    case ItemPositionHasChanged:
+        canvas()->scheduleMovedNode(this);
         break;
     case ItemSelectedHasChanged:
         {
-            adjust();
+            markDirty(StyleDirty);
+            if(value.toBool())
+                canvas()->selectedNodes_.insert(this);
+            else
+                canvas()->selectedNodes_.remove(this);
             if(value.toBool())
             {
                 canvas()->raiseItem(this);
@@ -727,7 +1998,7 @@ void QDataflowNode::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
 }
 
 QDataflowIOlet::QDataflowIOlet(QDataflowNode *node, int index)
-    : canvas_(node->canvas()), node_(node), index_(index)
+    : canvas_(node->canvas()), node_(node), index_(index), highlighted_(false)
 {
     setAcceptHoverEvents(canvas_->showIOletTooltips());
 }
@@ -789,7 +2060,16 @@ void QDataflowIOlet::paint(QPainter *painter, const QStyleOptionGraphicsItem *op
     Q_UNUSED(option);
     Q_UNUSED(widget);
     QDataflowNode *n = node();
-    painter->fillRect(QRect(-n->ioletWidth() / 2, -n->ioletHeight() / 2, n->ioletWidth(), n->ioletHeight()), Qt::black);
+    if(canvas()->isLowDetail(painter)) return;
+    painter->fillRect(QRect(-n->ioletWidth() / 2, -n->ioletHeight() / 2, n->ioletWidth(), n->ioletHeight()),
+                      highlighted_ ? QColor(0, 160, 0) : QColor(Qt::black));
+}
+
+void QDataflowIOlet::setHighlighted(bool highlighted)
+{
+    if(highlighted_ == highlighted) return;
+    highlighted_ = highlighted;
+    update();
 }
 
 
@@ -801,6 +2081,12 @@ QDataflowInlet::QDataflowInlet(QDataflowNode *node, int index)
     tooltip_->setVisible(false);
 }
 
+QDataflowInlet::~QDataflowInlet()
+{
+    if(isHighlighted())
+        canvas()->highlightedInlets_.remove(this);
+}
+
 QDataflowOutlet::QDataflowOutlet(QDataflowNode *node, int index)
     : QDataflowIOlet(node, index), tmpConn_()
 
@@ -824,6 +2110,7 @@ void QDataflowOutlet::mousePressEvent(QGraphicsSceneMouseEvent *event)
     tmpConn_->setFlag(ItemStacksBehindParent);
     node()->canvas()->raiseItem(tmpConn_);
     node()->canvas()->raiseItem(node());
+    node()->canvas()->highlightCompatibleInlets(this);
 }
 
 void QDataflowOutlet::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
@@ -832,6 +2119,8 @@ void QDataflowOutlet::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
 
     setCursor(Qt::CrossCursor);
 
+    node()->canvas()->clearHighlightedInlets();
+
     if(tmpConn_)
     {
         node()->scene()->removeItem(tmpConn_);
@@ -839,7 +2128,7 @@ void QDataflowOutlet::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
         tmpConn_ = 0;
     }
 
-    if(QDataflowInlet *inlet = node()->canvas()->itemAtT<QDataflowInlet>(event->scenePos()))
+    if(QDataflowInlet *inlet = node()->canvas()->inletAt(event->scenePos()))
     {
         QDataflowModel *model = node()->canvas()->model();
         model->connect(node()->modelNode(), index(), inlet->node()->modelNode(), inlet->index());
@@ -853,12 +2142,13 @@ void QDataflowOutlet::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
         tmpConn_->setLine(QLineF(QPointF(), tmpConn_->mapFromScene(event->scenePos())));
 
         // inlet under mouse:
-        QDataflowInlet *inlet = node()->canvas()->itemAtT<QDataflowInlet>(event->scenePos());
+        QDataflowInlet *inlet = node()->canvas()->inletAt(event->scenePos());
 
-        // give visual feedback about the connection being made:
+        // give visual feedback about the connection being made; inlets that
+        // were in view when the drag started are already classified
         QDataflowModelOutlet *mdloutlet = node()->modelNode()->outlet(index());
         QDataflowModelInlet *mdlinlet = inlet ? inlet->node()->modelNode()->inlet(inlet->index()) : nullptr;
-        if(inlet && mdloutlet->canMakeConnectionTo(mdlinlet) && mdlinlet->canAcceptConnectionFrom(mdloutlet))
+        if(inlet && (inlet->isHighlighted() || (mdloutlet->canMakeConnectionTo(mdlinlet) && mdlinlet->canAcceptConnectionFrom(mdloutlet))))
         {
             tmpConn_->setPen(node()->connectionPen());
         }
@@ -874,11 +2164,11 @@ void QDataflowOutlet::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
 }
 
 QDataflowConnection::QDataflowConnection(QDataflowCanvas *canvas, QDataflowModelConnection *modelConnection)
-    : canvas_(canvas), modelConnection_(modelConnection)
+    : canvas_(canvas), modelConnection_(modelConnection), slot_(-1)
 {
     setFlag(ItemIsSelectable);
     setAcceptedMouseButtons(Qt::LeftButton);
-    setAcceptHoverEvents(canvas_->showConnectionHoverFeedback());
+    setAcceptHoverEvents(canvas_->showConnectionHoverFeedback() && !canvas_->batchedConnections());
 
     QDataflowModelOutlet *src = modelConnection->source();
     QDataflowModelInlet *dst = modelConnection->dest();
@@ -901,8 +2191,31 @@ void QDataflowConnection::adjust()
 
     prepareGeometryChange();
 
-    sourcePoint_ = mapFromItem(source_, 0, source_->node()->ioletHeight() / 2);
-    destPoint_ = mapFromItem(dest_, 0, -dest_->node()->ioletHeight() / 2);
+    QDataflowConnectionGeometry &g = geometry_;
+    g.source = mapFromItem(source_, 0, source_->node()->ioletHeight() / 2);
+    g.dest = mapFromItem(dest_, 0, -dest_->node()->ioletHeight() / 2);
+    g.halfWidth = source_->node()->ioletHeight();
+
+    // the hit area is the segment widened by halfWidth on both sides;
+    // its corners are offset along the unit normal, no trig needed
+    const QPointF dp = g.dest - g.source;
+    const qreal len = std::hypot(dp.x(), dp.y());
+    g.shape = QPainterPath();
+    if(len > 0)
+    {
+        const QPointF n = QPointF(-dp.y(), dp.x()) * (g.halfWidth / len);
+        g.shape.addPolygon(QPolygonF()
+                           << (g.source + n)
+                           << (g.dest + n)
+                           << (g.dest - n)
+                           << (g.source - n));
+        g.shape.closeSubpath();
+    }
+
+    const qreal k = g.halfWidth;
+    g.bounds = QRectF(g.source, g.dest).normalized().adjusted(-k, -k, k, k);
+
+    canvas_->updateIndex(this);
 }
 
 QRectF QDataflowConnection::boundingRect() const
@@ -910,27 +2223,17 @@ QRectF QDataflowConnection::boundingRect() const
     if(!source_ || !dest_)
         return QRectF();
 
-    qreal penWidth = 1;
-    qreal extra = (penWidth) / 2.0;
-
-    return QRectF(sourcePoint_, destPoint_).normalized()
-        .adjusted(-extra, -extra, extra, extra);
+    return geometry_.bounds;
 }
 
 QPainterPath QDataflowConnection::shape() const
 {
-    QPointF dp = destPoint_ - sourcePoint_;
-    qreal angle = atan2(dp.y(), dp.x());
-    QPointF a(cos(angle + M_PI_2), sin(angle + M_PI_2)),
-            b(cos(angle - M_PI_2), sin(angle - M_PI_2));
-    int k = source_->node()->ioletHeight();
-    QPainterPath path;
-    path.addPolygon(QPolygonF()
-                    << (sourcePoint_ + k * a)
-                    << (destPoint_ + k * a)
-                    << (destPoint_ + k * b)
-                    << (sourcePoint_ + k * b));
-    return path;
+    return geometry_.shape;
+}
+
+bool QDataflowConnection::contains(const QPointF &point) const
+{
+    return geometry_.contains(point);
 }
 
 void QDataflowConnection::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
@@ -938,7 +2241,11 @@ void QDataflowConnection::paint(QPainter *painter, const QStyleOptionGraphicsIte
     if(!source_ || !dest_)
         return;
 
-    QLineF line(sourcePoint_, destPoint_);
+    // batched by QDataflowCanvas::drawForeground()
+    if(canvas_->paintsConnections(painter))
+        return;
+
+    QLineF line(geometry_.source, geometry_.dest);
     if(qFuzzyCompare(line.length(), qreal(0.)))
         return;
 
@@ -947,16 +2254,70 @@ void QDataflowConnection::paint(QPainter *painter, const QStyleOptionGraphicsIte
 
     if(sel || hov)
     {
-        painter->fillPath(shape(), sel ? Qt::cyan : Qt::gray);
+        painter->fillPath(geometry_.shape, sel ? Qt::cyan : Qt::gray);
     }
 
     painter->setPen(QPen(sel ? Qt::blue : Qt::black, 2, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
     painter->drawLine(line);
 }
 
+QVariant QDataflowConnection::itemChange(GraphicsItemChange change, const QVariant &value)
+{
+    if(change == ItemSelectedHasChanged)
+    {
+        if(value.toBool())
+            canvas_->selectedConnections_.insert(this);
+        else
+            canvas_->selectedConnections_.remove(this);
+    }
+    return QGraphicsItem::itemChange(change, value);
+}
+
+bool QDataflowConnectionGeometry::contains(const QPointF &point) const
+{
+    // distance from the point to the segment, compared squared
+    const QPointF d = dest - source, v = point - source;
+    const qreal len2 = QPointF::dotProduct(d, d);
+    const qreal t = len2 > 0 ? qBound(0.0, QPointF::dotProduct(v, d) / len2, 1.0) : 0.0;
+    const QPointF e = v - t * d;
+    return QPointF::dotProduct(e, e) <= halfWidth * halfWidth;
+}
+
+bool QDataflowConnectionGeometry::intersects(const QRectF &rect) const
+{
+    // Liang-Barsky clip of the segment against the rect grown by halfWidth
+    const QRectF r = rect.adjusted(-halfWidth, -halfWidth, halfWidth, halfWidth);
+    const QPointF d = dest - source;
+    qreal t0 = 0, t1 = 1;
+    auto clip = [&](qreal p, qreal q) {
+        if(p == 0) return q >= 0;
+        const qreal t = q / p;
+        if(p < 0)
+        {
+            if(t > t1) return false;
+            t0 = qMax(t0, t);
+        }
+        else
+        {
+            if(t < t0) return false;
+            t1 = qMin(t1, t);
+        }
+        return true;
+    };
+    return clip(-d.x(), source.x() - r.left()) && clip(d.x(), r.right() - source.x())
+        && clip(-d.y(), source.y() - r.top()) && clip(d.y(), r.bottom() - source.y());
+}
+
 QDataflowNodeTextLabel::QDataflowNodeTextLabel(QDataflowNode *node, QGraphicsItem *parent)
-    : QGraphicsTextItem(parent), node_(node), completionIndex_(-1), completionActive_(false)
+    : QGraphicsTextItem(parent), node_(node), completionIndex_(-1), completionTop_(0), completionActive_(false)
+{
+}
+
+void QDataflowNodeTextLabel::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
+    // while editing the text stays readable at any zoom
+    if(!node_->isInEditMode() && node_->canvas()->isLowDetail(painter)) return;
+    QGraphicsTextItem::paint(painter, option, widget);
 }
 
 bool QDataflowNodeTextLabel::sceneEvent(QEvent *event)
@@ -991,54 +2352,38 @@ bool QDataflowNodeTextLabel::sceneEvent(QEvent *event)
 
 void QDataflowNodeTextLabel::setCompletion(const QStringList &list)
 {
-    clearCompletion();
-
-    if(list.empty()) return;
-
-    completionActive_ = true;
+    completionList_ = list;
+    completionIndex_ = -1;
+    completionTop_ = 0;
+    completionActive_ = !list.empty();
 
-    qreal y = boundingRect().height() + 1;
-    for(auto &str : list)
-    {
-        QGraphicsRectItem *rectItem = new QGraphicsRectItem(this);
-        rectItem->setPos(0, y);
-        QGraphicsSimpleTextItem *item = new QGraphicsSimpleTextItem(rectItem);
-        item->setText(str);
-        completionRectItems_.push_back(rectItem);
-        completionItems_.push_back(item);
-        y += item->boundingRect().height();
-    }
-    qreal maxw = 0;
-    for(auto *item : as_const(completionItems_))
-        maxw = std::max(maxw, item->boundingRect().width());
-    for(int i = 0; i < completionItems_.length(); i++)
+    if(completionActive_)
     {
-        QRectF r = completionItems_[i]->boundingRect();
-        r.setWidth(maxw);
-        completionRectItems_[i]->setRect(r);
+        if(completionRectItems_.empty())
+        {
+            for(int i = 0; i < completionRows; i++)
+            {
+                QGraphicsRectItem *rectItem = new QGraphicsRectItem(this);
+                completionRectItems_.push_back(rectItem);
+                completionItems_.push_back(new QGraphicsSimpleTextItem(rectItem));
+            }
+        }
+        node_->canvas()->raiseItem(this);
     }
 
-    node_->canvas()->raiseItem(this);
-
     updateCompletion();
 }
 
 void QDataflowNodeTextLabel::clearCompletion()
 {
-    for(auto *item : as_const(completionItems_))
-    {
-        node_->canvas()->scene()->removeItem(item);
-        delete item;
-    }
-    completionItems_.clear();
-    for(auto *item : as_const(completionRectItems_))
-    {
-        node_->canvas()->scene()->removeItem(item);
-        delete item;
-    }
-    completionRectItems_.clear();
+    // the rows are only hidden; a pending query is cancelled so that it
+    // does not bring the popup back
+    node_->canvas()->cancelCompletion();
+    completionList_.clear();
     completionIndex_ = -1;
+    completionTop_ = 0;
     completionActive_ = false;
+    updateCompletion();
 }
 
 void QDataflowNodeTextLabel::acceptCompletion()
@@ -1047,7 +2392,7 @@ void QDataflowNodeTextLabel::acceptCompletion()
     {
         if(completionIndex_ >= 0)
         {
-            document()->setPlainText(completionItems_[completionIndex_]->text());
+            document()->setPlainText(completionList_[completionIndex_]);
         }
         else
         {
@@ -1062,28 +2407,53 @@ void QDataflowNodeTextLabel::acceptCompletion()
 
 void QDataflowNodeTextLabel::cycleCompletion(int d)
 {
-    int n = completionItems_.length();
+    int n = completionList_.length();
     if(completionIndex_ == -1 && d == -1) completionIndex_ = n - 1;
     else completionIndex_ += d;
     while(completionIndex_ < 0) completionIndex_ += n;
     while(completionIndex_ >= n) completionIndex_ -= n;
+
+    // scroll the rows to keep the current entry visible
+    const int rows = std::min(completionRows, n);
+    if(completionIndex_ < completionTop_)
+        completionTop_ = completionIndex_;
+    else if(completionIndex_ >= completionTop_ + rows)
+        completionTop_ = completionIndex_ - rows + 1;
+
     updateCompletion();
 }
 
 void QDataflowNodeTextLabel::updateCompletion()
 {
-    for(int i = 0; i < completionItems_.length(); i++)
+    const int rows = completionActive_ ? std::min<int>(completionRows, completionList_.length() - completionTop_) : 0;
+
+    qreal maxw = 0;
+    for(int i = 0; i < rows; i++)
+    {
+        completionItems_[i]->setText(completionList_[completionTop_ + i]);
+        maxw = std::max(maxw, completionItems_[i]->boundingRect().width());
+    }
+
+    qreal y = boundingRect().height() + 1;
+    for(int i = 0; i < completionRectItems_.length(); i++)
     {
-        completionRectItems_[i]->setBrush(i == completionIndex_ ? Qt::blue : Qt::white);
-        completionItems_[i]->setPen(QPen(i == completionIndex_ ? Qt::white : Qt::black));
+        completionRectItems_[i]->setVisible(i < rows);
+        if(i >= rows) continue;
+        QRectF r = completionItems_[i]->boundingRect();
+        r.setWidth(maxw);
+        completionRectItems_[i]->setRect(r);
+        completionRectItems_[i]->setPos(0, y);
+        y += r.height();
+        const bool current = completionTop_ + i == completionIndex_;
+        completionRectItems_[i]->setBrush(current ? Qt::blue : Qt::white);
+        completionItems_[i]->setPen(QPen(current ? Qt::white : Qt::black));
     }
 }
 
 void QDataflowNodeTextLabel::complete()
 {
-    QString txt = document()->toPlainText();
-    QStringList completionList = node_->canvas()->completion()->complete(txt);
-    setCompletion(completionList);
+    // answered later, through QDataflowCanvas::customEvent()
+    node_->canvas()->requestCompletion(this, document()->toPlainText());
 }
 
 void QDataflowNodeTextLabel::focusOutEvent(QFocusEvent *event)
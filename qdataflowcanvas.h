@@ -20,8 +20,16 @@
 
 #include <QGraphicsItem>
 #include <QGraphicsView>
+#include <QPainterPath>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <atomic>
 
 #include "qdataflowmodel.h"
+#include "qdataflowpool.h"
+#include "qdataflowsceneindex.h"
 
 class QDataflowNode;
 class QDataflowInlet;
@@ -32,6 +40,7 @@ class QDataflowNodeTextLabel;
 class QDataflowTooltip;
 class QGraphicsSceneMouseEvent;
 class QMouseEvent;
+class QRubberBand;
 
 enum QDataflowItemType {
     QDataflowItemTypeNode = QGraphicsItem::UserType + 1,
@@ -47,22 +56,53 @@ public:
     QDataflowCanvas(QWidget *parent = {});
     ~QDataflowCanvas() override;
 
+    // a model without a parent is adopted by the canvas and deleted when
+    // replaced; one that already has a parent, e.g. shown by several
+    // canvases, is left to its owner
     QDataflowModel * model();
     void setModel(QDataflowModel *model);
 
+    // show the scene of another canvas, the scene owner, instead of building
+    // items again: geometry, connection routing and the spatial index are
+    // done once, by the owner, and this canvas only adds a viewport with its
+    // own scroll position and zoom. The model, selection and item settings
+    // are the owner's. Null goes back to the canvas' own scene.
+    void shareSceneWith(QDataflowCanvas *owner);
+    QDataflowCanvas * sceneOwner() const {return owner_;}
+    // what the owner and the visible canvases sharing its scene show
+    QRectF visibleSceneRect() const;
+
+    // constant time; both warn when the element has no item and lazy
+    // items are off
     QDataflowNode * node(QDataflowModelNode *node);
     QDataflowConnection * connection(QDataflowModelConnection *conn);
 
+    // tracked as items are selected and deselected, in no particular order
     QList<QDataflowNode*> selectedNodes();
     QList<QDataflowConnection*> selectedConnections();
 
     bool isSomeNodeInEditMode() const;
 
+    // the provider is queried on a worker thread, one query at a time;
+    // setCompletion() waits for a running query to finish
     QDataflowTextCompletion * completion() const {return completion_;}
-    void setCompletion(QDataflowTextCompletion *completion) {completion_ = completion;}
+    void setCompletion(QDataflowTextCompletion *completion);
 
     void raiseItem(QGraphicsItem *item);
 
+    // hit testing, answered from the canvas' spatial index
+    QDataflowNode * nodeAt(const QPointF &scenePos) const;
+    QDataflowInlet * inletAt(const QPointF &scenePos) const;
+    QDataflowConnection * connectionAt(const QPointF &scenePos) const;
+    QList<QDataflowNode*> nodesIn(const QRectF &sceneRect) const;
+    QList<QDataflowConnection*> connectionsIn(const QRectF &sceneRect) const;
+
+    // mark the inlets in view that the outlet can connect to, testing the
+    // iolet types in the model's graph against its type registry; done when a
+    // connection drag starts, and cleared when it ends
+    void highlightCompatibleInlets(QDataflowOutlet *outlet);
+    void clearHighlightedInlets();
+
     bool showIOletTooltips();
     void setShowIOletTooltips(bool show);
     bool showObjectHoverFeedback();
@@ -74,13 +114,53 @@ public:
     bool drawGrid();
     void setDrawGrid(bool draw);
 
+    // below this scale nodes are drawn as plain boxes and connections as
+    // one batch of lines; 0 disables the simplified rendering
+    qreal levelOfDetailThreshold() const;
+    void setLevelOfDetailThreshold(qreal threshold);
+    bool isLowDetail(const QPainter *painter) const;
+
+    // draw all connections from one line buffer instead of item by item
+    bool batchedConnections() const;
+    void setBatchedConnections(bool batched);
+    bool isOpenGLViewport() const;
+    void setOpenGLViewport(bool enable);
+
+    // create items only for model nodes within lazyItemMargin() of the
+    // viewport, and for the connections between them; items are released
+    // again once they are scrolled far enough away. Selected items and the
+    // node being edited are kept.
+    bool lazyItems() const;
+    void setLazyItems(bool lazy);
+    qreal lazyItemMargin() const;
+    void setLazyItemMargin(qreal margin);
+
+    // tint nodes by their share of the model profiler's self time,
+    // relative to the hottest node; showing it turns profiling on, and
+    // hiding it puts the profiler back the way it was
+    bool profilerOverlay() const;
+    void setProfilerOverlay(bool show);
+
+Q_SIGNALS:
+    void modelChanged(QDataflowModel *model);
+
 protected:
     template<typename T>
     T * itemAtT(const QPointF &point);
 
     void drawBackground(QPainter *painter, const QRectF &rect) override;
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
     void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void focusOutEvent(QFocusEvent *event) override;
+    void leaveEvent(QEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void customEvent(QEvent *event) override;
 
 protected Q_SLOTS:
     void itemTextEditorTextChange();
@@ -91,30 +171,120 @@ protected Q_SLOTS:
     void onNodeTextChanged(QDataflowModelNode *mdlnode, const QString &text);
     void onNodeInletCountChanged(QDataflowModelNode *mdlnode, int count);
     void onNodeOutletCountChanged(QDataflowModelNode *mdlnode, int count);
+    void onNodeInletTypesChanged(QDataflowModelNode *mdlnode);
+    void onNodeOutletTypesChanged(QDataflowModelNode *mdlnode);
     void onConnectionAdded(QDataflowModelConnection *mdlconn);
     void onConnectionRemoved(QDataflowModelConnection *mdlconn);
+    void onTransactionCommitted(const QDataflowModelChangeSet &changes);
 
     friend class QDataflowNode;
     friend class QDataflowIOlet;
     friend class QDataflowInlet;
     friend class QDataflowOutlet;
     friend class QDataflowConnection;
+    friend class QDataflowNodeTextLabel;
 
 private:
+    // null when the element has no item
+    QDataflowNode * itemOf(const QDataflowModelNode *mdlnode) const;
+    QDataflowConnection * itemOf(const QDataflowModelConnection *mdlconn) const;
+    // by graph id, without creating the model object
+    QDataflowNode * nodeItem(int id) const;
+    QDataflowConnection * connectionItem(int id) const;
+    void updateIndex(QDataflowNode *uinode);
+    void updateIndex(QDataflowConnection *uiconn);
+    QList<QGraphicsItem*> indexedItemsAt(const QPointF &scenePos) const;
+    void updateViewports(bool resetCache = false);
+    void removeConnectionItem(QDataflowConnection *uiconn);
+    bool paintsConnections(const QPainter *painter) const;
+    QDataflowNode * createNodeItem(QDataflowModelNode *mdlnode);
+    QDataflowConnection * createConnectionItem(QDataflowModelConnection *mdlconn);
+    void releaseNodeItem(QDataflowNode *uinode);
+    void createConnectionItems(int id);
+    // nodes and connections added by id, which get their objects only
+    // along with an item
+    void addNodeById(int id);
+    void addConnectionById(int id);
+    QRectF lazyItemRect(qreal margin) const;
+    void scheduleLazyItemsUpdate();
+    void updateLazyItems();
+    void updateLazyIndex(QDataflowModelNode *mdlnode);
+    void updateLazyIndex(QDataflowModelConnection *mdlconn);
+    void removeFromLazyIndex(QDataflowModelNode *mdlnode);
+    void removeFromLazyIndex(QDataflowModelConnection *mdlconn);
+    void rebuildLazyIndex();
+    void scheduleMovedNode(QDataflowNode *uinode);
+    void flushMovedNodes();
+    void scheduleDirtyNode(QDataflowNode *uinode);
+    void flushDirtyNodes();
+    void updateProfilerOverlay();
+    void requestCompletion(QDataflowNodeTextLabel *label, const QString &text);
+    void cancelCompletion();
+    void closePressCommand();
+
     QDataflowModel *model_;
+    // this canvas unless it shows another canvas' scene
+    QDataflowCanvas *owner_;
+    QGraphicsScene *ownScene_;
+    QList<QDataflowCanvas*> sharingViews_;
     QDataflowTextCompletion *completion_;
+    QThreadPool completionPool_;
+    // bumped by every query and cancellation; results of older queries
+    // are dropped
+    std::atomic<quint64> completionGeneration_;
+    QDataflowNodeTextLabel *completionLabel_;
+    // items taken out of the scene; deleted with the canvas
     QSet<QDataflowNode*> ownedNodes_;
     QSet<QDataflowConnection*> ownedConnections_;
-    QMap<QDataflowModelNode*, QDataflowNode*> nodes_;
-    QMap<QDataflowModelConnection*, QDataflowConnection*> connections_;
+    // items by the graph id of their model element, null where there is
+    // none; removed elements are found by their lastId()
+    QVector<QDataflowNode*> nodes_;
+    QVector<QDataflowConnection*> connections_;
+    QSet<QDataflowNode*> selectedNodes_;
+    QSet<QDataflowConnection*> selectedConnections_;
+    QDataflowNode *editNode_;
     bool showIOletsTooltips_;
     bool showObjectHoverFeedback_;
     bool showConnectionHoverFeedback_;
     qreal gridSize_;
     bool drawGrid_;
+    QVector<QPoint> gridPoints_;
+    qreal levelOfDetailThreshold_;
+    bool batchedConnections_;
+    QVector<QLineF> connectionLines_;
+    QVector<QDataflowConnection*> connectionSlots_;
+    QDataflowConnection *hoveredConnection_;
+    qreal topZValue_;
+    QDataflowSceneIndex index_;
+    QRubberBand *rubberBand_;
+    QPoint rubberBandOrigin_;
+    // the model whose undo command a press opened, so that everything
+    // up to the release, such as a drag, is undone at once; also closed
+    // when the canvas loses focus or the mouse, in case the release is
+    // never seen
+    QPointer<QDataflowModel> pressCommandModel_;
+    QSet<QGraphicsItem*> rubberBandSelection_;
+    bool lazyItems_;
+    qreal lazyItemMargin_;
+    QTimer lazyItemsTimer_;
+    // graph ids of all model nodes and edges by position, kept only with
+    // lazy items, so that scrolling looks up what came into view
+    QDataflowGridIndex<int> lazyNodeIndex_;
+    QDataflowGridIndex<int> lazyEdgeIndex_;
+    // nodes moved since their position was last written to the model
+    QSet<QDataflowNode*> movedNodes_;
+    QTimer movedNodesTimer_;
+    // nodes with pending QDataflowNode::markDirty() flags
+    QSet<QDataflowNode*> dirtyNodes_;
+    QTimer dirtyNodesTimer_;
+    QSet<QDataflowInlet*> highlightedInlets_;
+    bool profilerOverlay_;
+    // whether the profiler was on before the overlay turned it on
+    bool profilerWasEnabled_;
+    QTimer profilerOverlayTimer_;
 };
 
-class QDataflowNode : public QGraphicsItem
+class QDataflowNode : public QGraphicsItem, public QDataflowPooled<QDataflowNode>
 {
 protected:
     QDataflowNode(QDataflowCanvas *canvas_, QDataflowModelNode *modelNode);
@@ -129,6 +299,10 @@ public:
     int outletCount() const {return outlets_.size();}
     void setOutletCount(int count, bool skipAdjust = false);
 
+    // refresh iolet tooltips after the model changed types in place
+    void updateInletTypes();
+    void updateOutletTypes();
+
     int type() const override {return QDataflowItemTypeNode;}
 
     void setText(const QString &text);
@@ -137,10 +311,25 @@ public:
     void setValid(bool valid);
     bool isValid() const;
 
+    // 0..1, drawn by the profiler overlay
+    qreal heat() const {return heat_;}
+    void setHeat(qreal heat);
+
     void adjustConnections() const;
 
     QRectF boundingRect() const override;
 
+    // what has to be recomputed; changes only mark the node, and the
+    // canvas flushes all marked nodes once per frame
+    enum DirtyFlag {
+        GeometryDirty = 0x1,    // box size, from the text and iolet counts
+        StyleDirty = 0x2,       // pens, brushes, text color, header visibility
+        IOletsDirty = 0x4,      // iolet type tooltips
+        ConnectionsDirty = 0x8, // connection routes and the index entry
+        AllDirty = 0xf
+    };
+    void markDirty(int flags);
+    // recomputes everything right away
     void adjust();
 
     QDataflowCanvas * canvas() const {return canvas_;}
@@ -179,6 +368,10 @@ private:
     QDataflowNodeTextLabel *textItem_;
     bool valid_;
     QString oldText_;
+    qreal heat_;
+    int dirty_;
+
+    void flush();
 
     friend class QDataflowCanvas;
 };
@@ -199,6 +392,9 @@ public:
 
     QDataflowCanvas * canvas() const {return canvas_;}
 
+    bool isHighlighted() const {return highlighted_;}
+    void setHighlighted(bool highlighted);
+
 protected:
     void hoverEnterEvent(QGraphicsSceneHoverEvent *event) override;
     void hoverLeaveEvent(QGraphicsSceneHoverEvent *event) override;
@@ -211,6 +407,7 @@ private:
     QList<QDataflowConnection*> connections_;
     QDataflowNode *node_;
     int index_;
+    bool highlighted_;
 
 protected:
     QDataflowTooltip *tooltip_;
@@ -219,12 +416,14 @@ protected:
     friend class QDataflowNode;
 };
 
-class QDataflowInlet : public QDataflowIOlet
+class QDataflowInlet : public QDataflowIOlet, public QDataflowPooled<QDataflowInlet>
 {
 protected:
     QDataflowInlet(QDataflowNode *node, int index);
 
 public:
+    ~QDataflowInlet() override;
+
     int type() const override {return QDataflowItemTypeInlet;}
 
     void onDataRecevied(void *data);
@@ -233,7 +432,7 @@ public:
     friend class QDataflowNode;
 };
 
-class QDataflowOutlet : public QDataflowIOlet
+class QDataflowOutlet : public QDataflowIOlet, public QDataflowPooled<QDataflowOutlet>
 {
 protected:
     QDataflowOutlet(QDataflowNode *node, int index);
@@ -253,7 +452,21 @@ private:
     friend class QDataflowNode;
 };
 
-class QDataflowConnection : public QGraphicsItem
+// Connection geometry in item coordinates. Computed once per
+// QDataflowConnection::adjust(); painting and hit testing only read it.
+struct QDataflowConnectionGeometry
+{
+    QPointF source;
+    QPointF dest;
+    qreal halfWidth = 0;
+    QRectF bounds;
+    QPainterPath shape;
+
+    bool contains(const QPointF &point) const;
+    bool intersects(const QRectF &rect) const;
+};
+
+class QDataflowConnection : public QGraphicsItem, public QDataflowPooled<QDataflowConnection>
 {
 protected:
     QDataflowConnection(QDataflowCanvas *canvas, QDataflowModelConnection *modelConnection);
@@ -273,23 +486,26 @@ public:
 protected:
     QRectF boundingRect() const override;
     QPainterPath shape() const override;
+    bool contains(const QPointF &point) const override;
 
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
 
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+
 private:
     QDataflowCanvas *canvas_;
     QDataflowModelConnection *modelConnection_;
     QDataflowOutlet *source_;
     QDataflowInlet *dest_;
-    QPointF sourcePoint_;
-    QPointF destPoint_;
+    QDataflowConnectionGeometry geometry_;
+    int slot_;
 
     friend class QDataflowCanvas;
     friend class QDataflowInlet;
     friend class QDataflowOutlet;
 };
 
-class QDataflowNodeTextLabel : public QGraphicsTextItem
+class QDataflowNodeTextLabel : public QGraphicsTextItem, public QDataflowPooled<QDataflowNodeTextLabel>
 {
 protected:
     QDataflowNodeTextLabel(QDataflowNode *node, QGraphicsItem *parent);
@@ -303,14 +519,19 @@ public:
     void complete();
 
 protected:
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
     bool sceneEvent(QEvent *event) override;
     void focusOutEvent(QFocusEvent *event) override;
 
 private:
     QDataflowNode *node_;
+    // the popup shows a window of completionList_ in a fixed set of rows,
+    // created once and reused for every query
+    QStringList completionList_;
     QList<QGraphicsSimpleTextItem*> completionItems_;
     QList<QGraphicsRectItem*> completionRectItems_;
     int completionIndex_;
+    int completionTop_;
     bool completionActive_;
 
     friend class QDataflowNode;
@@ -335,6 +556,8 @@ private:
     friend class QDataflowOutlet;
 };
 
+// complete() is called from a worker thread of the canvas; see
+// QDataflowPrefixCompletion for a provider over a fixed set of words
 class QDataflowTextCompletion
 {
 public:
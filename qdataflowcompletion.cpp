@@ -0,0 +1,88 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowcompletion.h"
+
+#include <algorithm>
+
+QDataflowPrefixCompletion::QDataflowPrefixCompletion(const QStringList &words)
+    : maxResults_(256)
+{
+    setWords(words);
+}
+
+QStringList QDataflowPrefixCompletion::words() const
+{
+    QMutexLocker lock(&mutex_);
+    return words_;
+}
+
+void QDataflowPrefixCompletion::setWords(const QStringList &words)
+{
+    QStringList sorted = words;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    QMutexLocker lock(&mutex_);
+    words_.swap(sorted);
+}
+
+int QDataflowPrefixCompletion::maxResults() const
+{
+    QMutexLocker lock(&mutex_);
+    return maxResults_;
+}
+
+void QDataflowPrefixCompletion::setMaxResults(int max)
+{
+    QMutexLocker lock(&mutex_);
+    maxResults_ = std::max(0, max);
+}
+
+QStringList QDataflowPrefixCompletion::complete(const QString &nodeText)
+{
+    // the list is implicitly shared: the copy holds on to the current set
+    // without keeping the lock during the search
+    QStringList words;
+    int maxResults;
+    {
+        QMutexLocker lock(&mutex_);
+        words = words_;
+        maxResults = maxResults_;
+    }
+    const QStringList &sorted = words;
+
+    // the first word not less than nodeText is nodeText itself, if present,
+    // followed by every longer word starting with it
+    auto begin = std::lower_bound(sorted.begin(), sorted.end(), nodeText);
+    if(begin != sorted.end() && *begin == nodeText)
+        ++begin;
+    auto end = begin;
+    if(nodeText.isEmpty())
+        end = sorted.end();
+    else
+        end = std::partition_point(begin, sorted.end(), [&](const QString &word) {
+            return word.startsWith(nodeText);
+        });
+    if(maxResults > 0 && end - begin > maxResults)
+        end = begin + maxResults;
+
+    QStringList result;
+    result.reserve(int(end - begin));
+    for(auto it = begin; it != end; ++it)
+        result << *it;
+    return result;
+}
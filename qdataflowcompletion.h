@@ -0,0 +1,54 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWCOMPLETION_H
+#define QDATAFLOWCOMPLETION_H
+
+#include <QMutex>
+#include <QStringList>
+
+#include "qdataflowcanvas.h"
+
+// Completes node text from a fixed set of words, e.g. a class library.
+//
+// The words are kept sorted, so the words that start with a prefix form one
+// contiguous range, found with two binary searches: a query costs
+// O(log n + k) for k results instead of a scan of the whole set. The canvas
+// runs queries on a worker thread; complete() may be called from any thread,
+// also while setWords() replaces the set.
+class QDataflowPrefixCompletion : public QDataflowTextCompletion
+{
+public:
+    QDataflowPrefixCompletion(const QStringList &words = {});
+
+    QStringList words() const;
+    void setWords(const QStringList &words);
+
+    // the number of results is capped; the shortest prefixes match most of
+    // the set. 0 means no limit
+    int maxResults() const;
+    void setMaxResults(int max);
+
+    // the words that start with nodeText and are longer than it, in order
+    QStringList complete(const QString &nodeText) override;
+
+private:
+    mutable QMutex mutex_;
+    QStringList words_;
+    int maxResults_;
+};
+
+#endif // QDATAFLOWCOMPLETION_H
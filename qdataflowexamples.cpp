@@ -0,0 +1,202 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2017 Federico Ferri
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowexamples.h"
+#include "qdataflowkernels.h"
+#include "qdataflowmodel.h"
+#include "qdataflownodefactory.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// the editor and the runner send from sources themselves
+class DFSource : public QDataflowMetaObject
+{
+public:
+    DFSource(QDataflowModelNode *node) : QDataflowMetaObject(node) {}
+
+    bool setArguments(const QStringList &args) override
+    {
+        Q_UNUSED(args);
+        return true;
+    }
+};
+
+class DFMathBinOp : public QDataflowMetaObject
+{
+public:
+    DFMathBinOp(QDataflowModelNode *node, const QStringList &args)
+        : QDataflowMetaObject(node)
+    {
+        op = args[0];
+        setArguments(args);
+    }
+
+    bool setArguments(const QStringList &args) override
+    {
+        s = args.length() > 1 ? args[1].toLong() : 0;
+        return true;
+    }
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        if(inlet == 0)
+        {
+            int r = message.toInt();
+            if(op == "add") r = r + s;
+            if(op == "sub") r = r - s;
+            if(op == "mul") r = r * s;
+            if(op == "div") r = s ? r / s : 0;
+            if(op == "pow") r = int(std::pow(r, s));
+            sendData(0, r);
+        }
+        else if(inlet == 1)
+        {
+            s = message.toInt();
+        }
+    }
+
+private:
+    QString op;
+    int s;
+};
+
+// add~, sub~, ...: the same operations on blocks of samples; the right
+// inlet takes a number or a block of the same size
+class DFBlockBinOp : public QDataflowMetaObject
+{
+public:
+    DFBlockBinOp(QDataflowModelNode *node, const QStringList &args)
+        : QDataflowMetaObject(node), op(QDataflowKernels::Add), s(0)
+    {
+        setBlockProcessing(true);
+
+        const QString name = args[0];
+        if(name == "sub~") op = QDataflowKernels::Sub;
+        if(name == "mul~") op = QDataflowKernels::Mul;
+        if(name == "div~") op = QDataflowKernels::Div;
+        if(name == "pow~") op = QDataflowKernels::Pow;
+
+        setArguments(args);
+    }
+
+    bool setArguments(const QStringList &args) override
+    {
+        s = args.length() > 1 ? args[1].toFloat() : 0;
+        operand.clear();
+        return true;
+    }
+
+    void onBlockReceived(int inlet, const float *samples, int count) override
+    {
+        if(inlet == 0)
+        {
+            QVector<float> r(count);
+            if(operand.size() == count)
+                QDataflowKernels::apply(op, r.data(), samples, operand.constData(), count);
+            else
+                QDataflowKernels::apply(op, r.data(), samples, s, count);
+            sendData(0, r);
+        }
+        else if(inlet == 1)
+        {
+            operand.resize(count);
+            std::copy(samples, samples + count, operand.begin());
+        }
+    }
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        if(inlet == 1)
+        {
+            s = message.toDouble();
+            operand.clear();
+        }
+    }
+
+private:
+    QDataflowKernels::Op op;
+    float s;
+    QVector<float> operand;
+};
+
+class DFNum2Str : public QDataflowMetaObject
+{
+public:
+    DFNum2Str(QDataflowModelNode *node) : QDataflowMetaObject(node) {}
+
+    bool setArguments(const QStringList &args) override
+    {
+        Q_UNUSED(args);
+        return true;
+    }
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        Q_UNUSED(inlet);
+
+        sendData(0, message.toString());
+    }
+};
+
+class DFSink : public QDataflowMetaObject
+{
+public:
+    DFSink(QDataflowModelNode *node, const QDataflowExamples::SinkFunction &sink)
+        : QDataflowMetaObject(node), sink_(sink)
+    {
+    }
+
+    bool setArguments(const QStringList &args) override
+    {
+        Q_UNUSED(args);
+        return true;
+    }
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        if(inlet == 0)
+        {
+            sink_(message);
+        }
+    }
+
+private:
+    QDataflowExamples::SinkFunction sink_;
+};
+
+} // namespace
+
+void QDataflowExamples::registerClasses(QDataflowNodeFactory *factory, const SinkFunction &sink)
+{
+    auto mathOp = [](QDataflowModelNode *node, const QStringList &args) -> QDataflowMetaObject* {return new DFMathBinOp(node, args);};
+    for(const char *name : {"add", "sub", "mul", "div", "pow"})
+        factory->registerClass(QString::fromLatin1(name), {"int", "int"}, {"int"}, mathOp);
+
+    auto blockOp = [](QDataflowModelNode *node, const QStringList &args) -> QDataflowMetaObject* {return new DFBlockBinOp(node, args);};
+    for(const char *name : {"add~", "sub~", "mul~", "div~", "pow~"})
+        factory->registerClass(QString::fromLatin1(name), {"samples", "*"}, {"samples"}, blockOp);
+
+    factory->registerClass("source", {}, {"int"},
+        [](QDataflowModelNode *node, const QStringList &) -> QDataflowMetaObject* {return new DFSource(node);});
+    factory->registerClass("num2str", {"int"}, {"string"},
+        [](QDataflowModelNode *node, const QStringList &) -> QDataflowMetaObject* {return new DFNum2Str(node);});
+    factory->registerClass("sink", {"string"}, {},
+        [sink](QDataflowModelNode *node, const QStringList &) -> QDataflowMetaObject* {return new DFSink(node, sink);});
+}
@@ -0,0 +1,39 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2017 Federico Ferri
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWEXAMPLES_H
+#define QDATAFLOWEXAMPLES_H
+
+#include "qdataflowmessage.h"
+
+#include <functional>
+
+class QDataflowNodeFactory;
+
+// The classes of the example editor and the runner: source, num2str, sink,
+// the integer operations add, sub, mul, div and pow, and the block
+// operations add~ ... pow~. Every message reaching a sink is passed to the
+// given function, on the thread delivering it.
+class QDataflowExamples
+{
+public:
+    typedef std::function<void(const QDataflowMessage &)> SinkFunction;
+
+    static void registerClasses(QDataflowNodeFactory *factory, const SinkFunction &sink);
+};
+
+#endif // QDATAFLOWEXAMPLES_H
@@ -0,0 +1,253 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowgraph.h"
+
+#include <algorithm>
+
+QDataflowGraph::QDataflowGraph()
+    : ioletTypesGarbage_(0), nodeCount_(0), edgeCount_(0)
+{
+}
+
+QDataflowGraph::NodeId QDataflowGraph::addNode(const QPoint &pos, const QString &text, bool valid)
+{
+    const NodeId id = nodeFlags_.size();
+    nodePos_.push_back(pos);
+    nodeText_.push_back(text);
+    nodeFlags_.push_back(AliveFlag | (valid ? ValidFlag : 0));
+    inletOffset_.push_back(0);
+    inletCount_.push_back(0);
+    outletOffset_.push_back(0);
+    outletCount_.push_back(0);
+    out_.addNode();
+    in_.addNode();
+    nodeCount_++;
+    return id;
+}
+
+void QDataflowGraph::removeNode(NodeId node)
+{
+    if(!containsNode(node)) return;
+
+    // the node's edges must be gone already: QDataflowModel::remove()
+    // disconnects them first
+    ioletTypesGarbage_ += inletCount_[node] + outletCount_[node];
+    inletCount_[node] = outletCount_[node] = 0;
+    nodeText_[node] = QString();
+    nodeFlags_[node] = 0;
+    out_.removeNode(node);
+    in_.removeNode(node);
+    nodeCount_--;
+}
+
+bool QDataflowGraph::containsNode(NodeId node) const
+{
+    return node >= 0 && node < nodeFlags_.size() && (nodeFlags_[node] & AliveFlag);
+}
+
+void QDataflowGraph::setValid(NodeId node, bool valid)
+{
+    if(valid) nodeFlags_[node] |= ValidFlag;
+    else nodeFlags_[node] &= ~ValidFlag;
+}
+
+void QDataflowGraph::setInletTypes(NodeId node, const QVector<TypeId> &types)
+{
+    setIOletTypes(inletOffset_[node], inletCount_[node], types);
+}
+
+void QDataflowGraph::setOutletTypes(NodeId node, const QVector<TypeId> &types)
+{
+    setIOletTypes(outletOffset_[node], outletCount_[node], types);
+}
+
+void QDataflowGraph::setIOletTypes(int &offset, int &count, const QVector<TypeId> &types)
+{
+    // a node's types are one run in the shared array: rewritten in place
+    // when they fit, otherwise appended and the old run left as garbage
+    if(types.size() > count)
+    {
+        ioletTypesGarbage_ += count;
+        offset = ioletTypes_.size();
+        ioletTypes_.resize(offset + types.size());
+    }
+    else
+    {
+        ioletTypesGarbage_ += count - types.size();
+    }
+    count = types.size();
+    std::copy(types.constBegin(), types.constEnd(), ioletTypes_.begin() + offset);
+
+    if(ioletTypesGarbage_ > ioletTypes_.size() / 2 && ioletTypesGarbage_ > 64)
+    {
+        // offset and count refer into the per-node arrays, so they are
+        // updated along with everything else
+        QVector<TypeId> compacted;
+        compacted.reserve(ioletTypes_.size() - ioletTypesGarbage_);
+        for(NodeId n = 0; n < nodeFlags_.size(); n++)
+        {
+            const int in = inletOffset_[n], out = outletOffset_[n];
+            inletOffset_[n] = compacted.size();
+            for(int i = 0; i < inletCount_[n]; i++) compacted.push_back(ioletTypes_[in + i]);
+            outletOffset_[n] = compacted.size();
+            for(int i = 0; i < outletCount_[n]; i++) compacted.push_back(ioletTypes_[out + i]);
+        }
+        ioletTypes_ = compacted;
+        ioletTypesGarbage_ = 0;
+    }
+}
+
+QDataflowGraph::EdgeId QDataflowGraph::addEdge(NodeId source, int outlet, NodeId dest, int inlet)
+{
+    if(!containsNode(source) || !containsNode(dest)) return InvalidId;
+    const EdgeId id = edgeSource_.size();
+    edgeSource_.push_back(source);
+    edgeOutlet_.push_back(outlet);
+    edgeDest_.push_back(dest);
+    edgeInlet_.push_back(inlet);
+    out_.append(source, id);
+    in_.append(dest, id);
+    edgeCount_++;
+    return id;
+}
+
+void QDataflowGraph::removeEdge(EdgeId edge)
+{
+    if(!containsEdge(edge)) return;
+    out_.remove(edgeSource_[edge], edge);
+    in_.remove(edgeDest_[edge], edge);
+    edgeSource_[edge] = edgeDest_[edge] = InvalidId;
+    edgeCount_--;
+}
+
+bool QDataflowGraph::containsEdge(EdgeId edge) const
+{
+    return edge >= 0 && edge < edgeSource_.size() && edgeSource_[edge] != InvalidId;
+}
+
+QDataflowGraph::EdgeRange QDataflowGraph::outEdges(NodeId node) const
+{
+    if(!containsNode(node)) return {nullptr, nullptr};
+    return out_.range(node);
+}
+
+QDataflowGraph::EdgeRange QDataflowGraph::inEdges(NodeId node) const
+{
+    if(!containsNode(node)) return {nullptr, nullptr};
+    return in_.range(node);
+}
+
+QDataflowGraph::EdgeId QDataflowGraph::findEdge(NodeId source, int outlet, NodeId dest, int inlet) const
+{
+    if(!containsNode(source) || !containsNode(dest)) return InvalidId;
+    const EdgeRange out = out_.range(source), in = in_.range(dest);
+    for(EdgeId e : out.size() <= in.size() ? out : in)
+        if(edgeSource_[e] == source && edgeOutlet_[e] == outlet && edgeDest_[e] == dest && edgeInlet_[e] == inlet)
+            return e;
+    return InvalidId;
+}
+
+void QDataflowGraph::reserve(int nodeCount, int edgeCount)
+{
+    nodePos_.reserve(nodeCount);
+    nodeText_.reserve(nodeCount);
+    nodeFlags_.reserve(nodeCount);
+    inletOffset_.reserve(nodeCount);
+    inletCount_.reserve(nodeCount);
+    outletOffset_.reserve(nodeCount);
+    outletCount_.reserve(nodeCount);
+    edgeSource_.reserve(edgeCount);
+    edgeOutlet_.reserve(edgeCount);
+    edgeDest_.reserve(edgeCount);
+    edgeInlet_.reserve(edgeCount);
+    out_.reserve(nodeCount, edgeCount);
+    in_.reserve(nodeCount, edgeCount);
+}
+
+void QDataflowGraph::clear()
+{
+    *this = QDataflowGraph();
+}
+
+QDataflowGraph::EdgeRange QDataflowGraph::Adjacency::range(NodeId node) const
+{
+    const EdgeId *first = edges.constData() + offset[node];
+    return {first, first + count[node]};
+}
+
+void QDataflowGraph::Adjacency::addNode()
+{
+    offset.push_back(0);
+    count.push_back(0);
+    capacity.push_back(0);
+}
+
+void QDataflowGraph::Adjacency::removeNode(NodeId node)
+{
+    // the node's edges are gone already
+    garbage += capacity[node];
+    count[node] = capacity[node] = 0;
+}
+
+void QDataflowGraph::Adjacency::append(NodeId node, EdgeId edge)
+{
+    if(count[node] == capacity[node])
+    {
+        const int from = offset[node], n = count[node];
+        garbage += capacity[node];
+        capacity[node] = qMax(2, 2 * n);
+        offset[node] = edges.size();
+        edges.resize(offset[node] + capacity[node]);
+        std::copy(edges.constBegin() + from, edges.constBegin() + from + n, edges.begin() + offset[node]);
+        if(garbage > edges.size() / 2 && garbage > 64) compact();
+    }
+    edges[offset[node] + count[node]++] = edge;
+}
+
+void QDataflowGraph::Adjacency::remove(NodeId node, EdgeId edge)
+{
+    // shifted down rather than swapped with the last one, so that the run
+    // keeps the order in which the edges were added
+    auto first = edges.begin() + offset[node], last = first + count[node];
+    auto it = std::find(first, last, edge);
+    if(it == last) return;
+    std::copy(it + 1, last, it);
+    count[node]--;
+}
+
+void QDataflowGraph::Adjacency::reserve(int nodeCount, int edgeCount)
+{
+    offset.reserve(nodeCount);
+    count.reserve(nodeCount);
+    capacity.reserve(nodeCount);
+    edges.reserve(edgeCount);
+}
+
+void QDataflowGraph::Adjacency::compact()
+{
+    QVector<EdgeId> compacted;
+    compacted.reserve(edges.size() - garbage);
+    for(NodeId n = 0; n < offset.size(); n++)
+    {
+        const int from = offset[n];
+        offset[n] = compacted.size();
+        for(int i = 0; i < count[n]; i++) compacted.push_back(edges[from + i]);
+        compacted.resize(offset[n] + capacity[n]);
+    }
+    edges = compacted;
+    garbage = 0;
+}
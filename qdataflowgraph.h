@@ -0,0 +1,155 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWGRAPH_H
+#define QDATAFLOWGRAPH_H
+
+#include <QPoint>
+#include <QString>
+#include <QVector>
+
+#include "qdataflowtyperegistry.h"
+
+// Compact store of the graph structure of a QDataflowModel, and the only
+// one: the model creates its node and connection objects from it when they
+// are first asked for. Nodes and edges get dense ids that are never reused;
+// attributes live in one array per attribute, and each node's edges are a
+// run in a shared array, updated in place on every edit so that readers on
+// several threads never trigger a rebuild. Roughly 70 bytes per node plus
+// its text, 4 per iolet and 40 per edge with the model's id tables.
+class QDataflowGraph
+{
+public:
+    typedef int NodeId;
+    typedef int EdgeId;
+    typedef QDataflowTypeRegistry::TypeId TypeId;
+
+    enum {InvalidId = -1};
+
+    struct EdgeRange
+    {
+        const EdgeId *first;
+        const EdgeId *last;
+
+        const EdgeId * begin() const {return first;}
+        const EdgeId * end() const {return last;}
+        int size() const {return int(last - first);}
+        bool isEmpty() const {return first == last;}
+    };
+
+    QDataflowGraph();
+
+    // iolet type strings are interned: equal types share one QString and
+    // compare as integers
+    TypeId internType(const QString &type) {return types_.intern(type);}
+    TypeId typeId(const QString &type) const {return types_.id(type);}
+    const QString & typeName(TypeId type) const {return types_.name(type);}
+    int typeCount() const {return types_.count();}
+    const QDataflowTypeRegistry & types() const {return types_;}
+    QDataflowTypeRegistry & types() {return types_;}
+
+    NodeId addNode(const QPoint &pos, const QString &text, bool valid);
+    // the node's edges must have been removed
+    void removeNode(NodeId node);
+    bool containsNode(NodeId node) const;
+    int nodeCount() const {return nodeCount_;}
+    // all node ids are below this
+    int nodeIdBound() const {return nodeFlags_.size();}
+
+    QPoint pos(NodeId node) const {return nodePos_[node];}
+    void setPos(NodeId node, const QPoint &pos) {nodePos_[node] = pos;}
+    const QString & text(NodeId node) const {return nodeText_[node];}
+    void setText(NodeId node, const QString &text) {nodeText_[node] = text;}
+    bool isValid(NodeId node) const {return nodeFlags_[node] & ValidFlag;}
+    void setValid(NodeId node, bool valid);
+
+    int inletCount(NodeId node) const {return inletCount_[node];}
+    TypeId inletType(NodeId node, int inlet) const {return ioletTypes_[inletOffset_[node] + inlet];}
+    void setInletTypes(NodeId node, const QVector<TypeId> &types);
+    int outletCount(NodeId node) const {return outletCount_[node];}
+    TypeId outletType(NodeId node, int outlet) const {return ioletTypes_[outletOffset_[node] + outlet];}
+    void setOutletTypes(NodeId node, const QVector<TypeId> &types);
+
+    EdgeId addEdge(NodeId source, int outlet, NodeId dest, int inlet);
+    void removeEdge(EdgeId edge);
+    bool containsEdge(EdgeId edge) const;
+    int edgeCount() const {return edgeCount_;}
+    int edgeIdBound() const {return edgeSource_.size();}
+
+    NodeId edgeSource(EdgeId edge) const {return edgeSource_[edge];}
+    int edgeOutlet(EdgeId edge) const {return edgeOutlet_[edge];}
+    NodeId edgeDest(EdgeId edge) const {return edgeDest_[edge];}
+    int edgeInlet(EdgeId edge) const {return edgeInlet_[edge];}
+
+    // edges leaving / entering a node, in the order they were added; the
+    // range is invalidated by the next edit
+    EdgeRange outEdges(NodeId node) const;
+    EdgeRange inEdges(NodeId node) const;
+    // the edge between the two iolets, InvalidId if none; scans the
+    // shorter of the two nodes' runs
+    EdgeId findEdge(NodeId source, int outlet, NodeId dest, int inlet) const;
+
+    void reserve(int nodeCount, int edgeCount);
+    void clear();
+
+private:
+    enum {AliveFlag = 0x01, ValidFlag = 0x02};
+
+    // per-node runs of edge ids with room to grow; a full run moves to
+    // the end with twice the capacity and leaves garbage behind
+    struct Adjacency
+    {
+        QVector<int> offset;
+        QVector<int> count;
+        QVector<int> capacity;
+        QVector<EdgeId> edges;
+        int garbage = 0;
+
+        EdgeRange range(NodeId node) const;
+        void addNode();
+        void removeNode(NodeId node);
+        void append(NodeId node, EdgeId edge);
+        void remove(NodeId node, EdgeId edge);
+        void reserve(int nodeCount, int edgeCount);
+        void compact();
+    };
+
+    void setIOletTypes(int &offset, int &count, const QVector<TypeId> &types);
+
+    QDataflowTypeRegistry types_;
+
+    QVector<QPoint> nodePos_;
+    QVector<QString> nodeText_;
+    QVector<quint8> nodeFlags_;
+    QVector<int> inletOffset_;
+    QVector<int> inletCount_;
+    QVector<int> outletOffset_;
+    QVector<int> outletCount_;
+    QVector<TypeId> ioletTypes_;
+    int ioletTypesGarbage_;
+    int nodeCount_;
+
+    QVector<NodeId> edgeSource_;
+    QVector<int> edgeOutlet_;
+    QVector<NodeId> edgeDest_;
+    QVector<int> edgeInlet_;
+    int edgeCount_;
+
+    Adjacency out_;
+    Adjacency in_;
+};
+
+#endif // QDATAFLOWGRAPH_H
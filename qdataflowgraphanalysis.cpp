@@ -0,0 +1,472 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowgraphanalysis.h"
+#include "utility.h"
+
+#include <algorithm>
+
+#include <QHash>
+#include <QSet>
+
+QDataflowGraphAnalysis::QDataflowGraphAnalysis(const QDataflowGraph *graph)
+    : graph_(graph), orderGeneration_(0), nextComponent_(0)
+{
+}
+
+bool QDataflowGraphAnalysis::isAlive(NodeId node) const
+{
+    return node >= 0 && node < flags_.size() && (flags_[node] & AliveFlag);
+}
+
+bool QDataflowGraphAnalysis::isOrdered(NodeId source, NodeId dest) const
+{
+    // back edges run against the order, or from a node to itself
+    return ord_[source] < ord_[dest];
+}
+
+void QDataflowGraphAnalysis::addNode(NodeId node)
+{
+    if(node < 0 || isAlive(node)) return;
+    if(node >= flags_.size())
+    {
+        const int n = node + 1;
+        flags_.resize(n);
+        ord_.resize(n);
+        component_.resize(n);
+    }
+    flags_[node] = AliveFlag;
+    // a new node has no edges, so it can go anywhere: last is cheapest
+    ord_[node] = nodeAt_.size();
+    nodeAt_.push_back(node);
+    component_[node] = nextComponent_++;
+    componentSize_.insert(component_[node], 1);
+}
+
+void QDataflowGraphAnalysis::removeNode(NodeId node)
+{
+    if(!isAlive(node)) return;
+    // the position stays taken, it is skipped by topologicalOrder()
+    flags_[node] = 0;
+    auto it = componentSize_.find(component_[node]);
+    if(--*it == 0) componentSize_.erase(it);
+}
+
+bool QDataflowGraphAnalysis::addEdge(NodeId source, NodeId dest)
+{
+    if(!isAlive(source) || !isAlive(dest)) return false;
+    merge(source, dest);
+    if(insertOrdered(source, dest))
+        return true;
+    backEdges_.push_back(qMakePair(source, dest));
+    return false;
+}
+
+void QDataflowGraphAnalysis::removeEdge(NodeId source, NodeId dest)
+{
+    if(!isAlive(source) || !isAlive(dest)) return;
+    // another edge between the two nodes keeps both the order and the
+    // component as they are
+    bool forward = false, backward = false;
+    for(QDataflowGraph::EdgeId e : graph_->outEdges(source))
+        if(graph_->edgeDest(e) == dest) forward = true;
+    for(QDataflowGraph::EdgeId e : graph_->inEdges(source))
+        if(graph_->edgeSource(e) == dest) backward = true;
+
+    if(!isOrdered(source, dest))
+    {
+        const int i = backEdges_.indexOf(qMakePair(source, dest));
+        if(i >= 0) backEdges_.remove(i);
+        // the cycles of the other back edges are made of ordered edges
+        // only, so none of them is broken
+    }
+    else if(!forward)
+    {
+        orderBackEdges(source, dest);
+    }
+
+    if(!forward && !backward)
+        split(source, dest);
+}
+
+void QDataflowGraphAnalysis::reserve(int nodeCount)
+{
+    flags_.reserve(nodeCount);
+    ord_.reserve(nodeCount);
+    nodeAt_.reserve(nodeCount);
+    component_.reserve(nodeCount);
+}
+
+void QDataflowGraphAnalysis::clear()
+{
+    // the generation keeps counting, so no order seen before comes back
+    const quint64 generation = orderGeneration_ + 1;
+    *this = QDataflowGraphAnalysis(graph_);
+    orderGeneration_ = generation;
+}
+
+bool QDataflowGraphAnalysis::insertOrdered(NodeId source, NodeId dest)
+{
+    if(source == dest) return false;
+
+    // only the nodes positioned between dest and source can be affected
+    const int lowerBound = ord_[dest], upperBound = ord_[source];
+    if(lowerBound < upperBound)
+    {
+        QVector<NodeId> deltaForward, deltaBackward;
+        const bool acyclic = searchForward(dest, upperBound, deltaForward);
+        if(acyclic)
+            searchBackward(source, lowerBound, deltaBackward);
+        for(NodeId node : deltaForward)
+            flags_[node] &= ~VisitedFlag;
+        for(NodeId node : deltaBackward)
+            flags_[node] &= ~VisitedFlag;
+        if(!acyclic) return false;
+        reorder(deltaBackward, deltaForward);
+    }
+    return true;
+}
+
+bool QDataflowGraphAnalysis::searchForward(NodeId node, int bound, QVector<NodeId> &delta)
+{
+    // nodes reachable from node positioned before bound; reaching the node
+    // at bound means the new edge closes a cycle
+    QVector<NodeId> stack;
+    stack.push_back(node);
+    flags_[node] |= VisitedFlag;
+    delta.push_back(node);
+    while(!stack.isEmpty())
+    {
+        const NodeId n = stack.takeLast();
+        for(QDataflowGraph::EdgeId e : graph_->outEdges(n))
+        {
+            const NodeId w = graph_->edgeDest(e);
+            if(!isOrdered(n, w)) continue;
+            if(ord_[w] == bound) return false;
+            if((flags_[w] & VisitedFlag) || ord_[w] > bound) continue;
+            flags_[w] |= VisitedFlag;
+            delta.push_back(w);
+            stack.push_back(w);
+        }
+    }
+    return true;
+}
+
+void QDataflowGraphAnalysis::searchBackward(NodeId node, int bound, QVector<NodeId> &delta)
+{
+    // nodes that reach node, positioned after bound
+    QVector<NodeId> stack;
+    stack.push_back(node);
+    flags_[node] |= VisitedFlag;
+    delta.push_back(node);
+    while(!stack.isEmpty())
+    {
+        const NodeId n = stack.takeLast();
+        for(QDataflowGraph::EdgeId e : graph_->inEdges(n))
+        {
+            const NodeId w = graph_->edgeSource(e);
+            if(!isOrdered(w, n)) continue;
+            if((flags_[w] & VisitedFlag) || ord_[w] < bound) continue;
+            flags_[w] |= VisitedFlag;
+            delta.push_back(w);
+            stack.push_back(w);
+        }
+    }
+}
+
+void QDataflowGraphAnalysis::reorder(QVector<NodeId> &deltaBackward, QVector<NodeId> &deltaForward)
+{
+    // the affected nodes swap into the positions they already occupy: the
+    // ones reaching the source first, then the ones reached from the dest,
+    // each group keeping its relative order
+    auto byOrder = [this](NodeId a, NodeId b) {return ord_[a] < ord_[b];};
+    std::sort(deltaBackward.begin(), deltaBackward.end(), byOrder);
+    std::sort(deltaForward.begin(), deltaForward.end(), byOrder);
+
+    QVector<NodeId> nodes;
+    nodes.reserve(deltaBackward.size() + deltaForward.size());
+    nodes += deltaBackward;
+    nodes += deltaForward;
+
+    QVector<int> positions;
+    positions.reserve(nodes.size());
+    for(NodeId node : nodes)
+        positions.push_back(ord_[node]);
+    std::sort(positions.begin(), positions.end());
+
+    for(int i = 0; i < nodes.size(); i++)
+    {
+        ord_[nodes[i]] = positions[i];
+        nodeAt_[positions[i]] = nodes[i];
+    }
+    orderGeneration_++;
+}
+
+void QDataflowGraphAnalysis::orderBackEdges(NodeId source, NodeId dest)
+{
+    // the cycle of a back edge runs from its dest to its source through
+    // ordered edges, all of them positioned between the two; only the back
+    // edges spanning the removed one can have lost their cycle. They are
+    // picked before ordering one moves the nodes
+    const int lowerBound = ord_[source], upperBound = ord_[dest];
+    QVector<int> candidates;
+    for(int i = 0; i < backEdges_.size(); i++)
+        if(ord_[backEdges_[i].second] <= lowerBound && ord_[backEdges_[i].first] >= upperBound)
+            candidates.push_back(i);
+    // from the back, so the indices stay valid as edges are taken out
+    for(int j = candidates.size() - 1; j >= 0; j--)
+    {
+        const QPair<NodeId, NodeId> edge = backEdges_[candidates[j]];
+        if(insertOrdered(edge.first, edge.second))
+            backEdges_.remove(candidates[j]);
+    }
+}
+
+bool QDataflowGraphAnalysis::wouldCreateCycle(NodeId source, NodeId dest) const
+{
+    if(!isAlive(source) || !isAlive(dest)) return false;
+    if(source == dest) return true;
+
+    // while the order is complete, a cycle needs a path from dest to source
+    // through the positions between them
+    const bool bounded = isAcyclic();
+    if(bounded && ord_[source] < ord_[dest]) return false;
+
+    QSet<NodeId> visited;
+    QVector<NodeId> stack;
+    stack.push_back(dest);
+    visited.insert(dest);
+    while(!stack.isEmpty())
+    {
+        const NodeId n = stack.takeLast();
+        for(QDataflowGraph::EdgeId e : graph_->outEdges(n))
+        {
+            const NodeId w = graph_->edgeDest(e);
+            if(w == source) return true;
+            if(bounded && ord_[w] > ord_[source]) continue;
+            if(visited.contains(w)) continue;
+            visited.insert(w);
+            stack.push_back(w);
+        }
+    }
+    return false;
+}
+
+QVector<QDataflowGraphAnalysis::NodeId> QDataflowGraphAnalysis::topologicalOrder() const
+{
+    QVector<NodeId> ret;
+    for(NodeId node : nodeAt_)
+        if(flags_[node] & AliveFlag)
+            ret.push_back(node);
+    return ret;
+}
+
+int QDataflowGraphAnalysis::topologicalIndex(NodeId node) const
+{
+    if(!isAlive(node)) return -1;
+    return ord_[node];
+}
+
+QVector<QVector<QDataflowGraphAnalysis::NodeId>> QDataflowGraphAnalysis::stronglyConnectedComponents() const
+{
+    // every cycle goes through a back edge, and both ends of a back edge
+    // are in the same component: Tarjan's search only has to start from
+    // the back edges, not from every node
+    QVector<QVector<NodeId>> ret;
+    if(isAcyclic()) return ret;
+
+    struct Frame
+    {
+        NodeId node;
+        QDataflowGraph::EdgeRange edges;
+        const QDataflowGraph::EdgeId *next;
+        bool selfLoop;
+    };
+
+    QHash<NodeId, int> index, low;
+    QSet<NodeId> onStack;
+    QVector<NodeId> stack;
+    QVector<Frame> frames;
+    int counter = 0;
+
+    auto visit = [&](NodeId node) {
+        index.insert(node, counter);
+        low.insert(node, counter);
+        counter++;
+        stack.push_back(node);
+        onStack.insert(node);
+        const QDataflowGraph::EdgeRange edges = graph_->outEdges(node);
+        frames.push_back({node, edges, edges.begin(), false});
+    };
+
+    for(auto &edge : backEdges_)
+    {
+        if(index.contains(edge.second)) continue;
+        visit(edge.second);
+        while(!frames.isEmpty())
+        {
+            Frame &frame = frames.last();
+            if(frame.next != frame.edges.end())
+            {
+                const NodeId w = graph_->edgeDest(*frame.next++);
+                if(w == frame.node)
+                    frame.selfLoop = true;
+                if(!index.contains(w))
+                    visit(w);
+                else if(onStack.contains(w))
+                    low[frame.node] = std::min(low[frame.node], index[w]);
+                continue;
+            }
+
+            const NodeId node = frame.node;
+            const bool selfLoop = frame.selfLoop;
+            frames.removeLast();
+            if(!frames.isEmpty())
+            {
+                const NodeId parent = frames.last().node;
+                low[parent] = std::min(low[parent], low[node]);
+            }
+            if(low[node] != index[node]) continue;
+
+            QVector<NodeId> component;
+            NodeId w;
+            do
+            {
+                w = stack.takeLast();
+                onStack.remove(w);
+                component.push_back(w);
+            }
+            while(w != node);
+            if(component.size() > 1 || selfLoop)
+                ret.push_back(component);
+        }
+    }
+    return ret;
+}
+
+void QDataflowGraphAnalysis::relabel(NodeId node, int from, int to)
+{
+    // the nodes still carrying the old label are the ones to move; the
+    // search stops at the ones that already carry the new one
+    QVector<NodeId> stack;
+    stack.push_back(node);
+    component_[node] = to;
+    int moved = 1;
+    auto reach = [&](NodeId w) {
+        if(component_[w] != from) return;
+        component_[w] = to;
+        moved++;
+        stack.push_back(w);
+    };
+    while(!stack.isEmpty())
+    {
+        const NodeId n = stack.takeLast();
+        for(QDataflowGraph::EdgeId e : graph_->outEdges(n))
+            reach(graph_->edgeDest(e));
+        for(QDataflowGraph::EdgeId e : graph_->inEdges(n))
+            reach(graph_->edgeSource(e));
+    }
+
+    auto it = componentSize_.find(from);
+    if((*it -= moved) == 0) componentSize_.erase(it);
+    componentSize_[to] += moved;
+}
+
+void QDataflowGraphAnalysis::merge(NodeId a, NodeId b)
+{
+    const int ca = component_[a], cb = component_[b];
+    if(ca == cb) return;
+    // the smaller component takes the label of the larger one
+    if(componentSize_.value(ca) < componentSize_.value(cb))
+        relabel(a, ca, cb);
+    else
+        relabel(b, cb, ca);
+}
+
+void QDataflowGraphAnalysis::split(NodeId a, NodeId b)
+{
+    if(a == b) return;
+
+    // a search from each end, one node at a time from either side: if they
+    // meet the component holds together, otherwise the side that runs out
+    // first is a component of its own. Either way the cost is about twice
+    // the smaller side
+    QVector<NodeId> sides[2] = {{a}, {b}};
+    const quint8 sideFlags[2] = {SideAFlag, SideBFlag};
+    flags_[a] |= SideAFlag;
+    flags_[b] |= SideBFlag;
+    int next[2] = {0, 0};
+    int separated = -1;
+    bool met = false;
+    while(!met && separated < 0)
+    {
+        for(int side = 0; side < 2 && !met; side++)
+        {
+            if(next[side] == sides[side].size())
+            {
+                separated = side;
+                break;
+            }
+            const NodeId n = sides[side][next[side]++];
+            auto reach = [&](NodeId w) {
+                if(flags_[w] & sideFlags[1 - side]) met = true;
+                if(met || (flags_[w] & sideFlags[side])) return;
+                flags_[w] |= sideFlags[side];
+                sides[side].push_back(w);
+            };
+            for(QDataflowGraph::EdgeId e : graph_->outEdges(n))
+                reach(graph_->edgeDest(e));
+            for(QDataflowGraph::EdgeId e : graph_->inEdges(n))
+                reach(graph_->edgeSource(e));
+        }
+    }
+
+    for(int side = 0; side < 2; side++)
+        for(NodeId n : as_const(sides[side]))
+            flags_[n] &= ~(SideAFlag | SideBFlag);
+    if(met) return;
+
+    // the side that ran out was searched through, so it is complete
+    const int from = component_[a], to = nextComponent_++;
+    for(NodeId n : as_const(sides[separated]))
+        component_[n] = to;
+    componentSize_[from] -= sides[separated].size();
+    componentSize_.insert(to, sides[separated].size());
+}
+
+int QDataflowGraphAnalysis::componentOf(NodeId node) const
+{
+    if(!isAlive(node)) return QDataflowGraph::InvalidId;
+    return component_[node];
+}
+
+QVector<QVector<QDataflowGraphAnalysis::NodeId>> QDataflowGraphAnalysis::connectedComponents() const
+{
+    QVector<QVector<NodeId>> ret;
+    QHash<int, int> componentIndex;
+    for(NodeId node : nodeAt_)
+    {
+        if(!(flags_[node] & AliveFlag)) continue;
+        auto it = componentIndex.find(component_[node]);
+        if(it == componentIndex.end())
+        {
+            it = componentIndex.insert(component_[node], ret.size());
+            ret.push_back({});
+        }
+        ret[*it].push_back(node);
+    }
+    return ret;
+}
@@ -0,0 +1,110 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWGRAPHANALYSIS_H
+#define QDATAFLOWGRAPHANALYSIS_H
+
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+#include "qdataflowgraph.h"
+
+// Structure of the node graph kept up to date edge by edge, over the
+// model's QDataflowGraph: it walks the graph's own adjacency, which must
+// already show the edit it is told about, and keeps no copy of it.
+//
+// The nodes are kept in a topological order, maintained with the
+// Pearce-Kelly algorithm: inserting an edge only reorders the nodes between
+// its endpoints' positions, and removing one never invalidates the order.
+// An edge that would close a cycle is kept aside as a back edge; it is
+// ordered again once removing an edge of its cycle breaks it, and only the
+// back edges spanning the removed edge's positions are tried. Connected
+// components are labelled: adding an edge relabels the smaller of the two
+// components, removing one searches from both ends until the searches
+// meet or the smaller side runs out.
+//
+// The queries only read, so threads may share it while the model is not
+// edited.
+class QDataflowGraphAnalysis
+{
+public:
+    typedef QDataflowGraph::NodeId NodeId;
+
+    explicit QDataflowGraphAnalysis(const QDataflowGraph *graph);
+
+    void addNode(NodeId node);
+    // the node's edges must have been removed
+    void removeNode(NodeId node);
+    // after the graph got the edge; returns false if it closes a cycle
+    bool addEdge(NodeId source, NodeId dest);
+    // after the graph lost the edge
+    void removeEdge(NodeId source, NodeId dest);
+    void reserve(int nodeCount);
+    void clear();
+
+    // cheap unless the positions of the endpoints are far apart
+    bool wouldCreateCycle(NodeId source, NodeId dest) const;
+    bool isAcyclic() const {return backEdges_.isEmpty();}
+
+    // the live nodes, each before all nodes it has edges to; while the
+    // graph has cycles the back edges are not taken into account
+    QVector<NodeId> topologicalOrder() const;
+    int topologicalIndex(NodeId node) const;
+    // changes whenever nodes move in the order
+    quint64 orderGeneration() const {return orderGeneration_;}
+
+    // the feedback loops: components with more than one node, or with an
+    // edge from a node to itself
+    QVector<QVector<NodeId>> stronglyConnectedComponents() const;
+
+    // nodes connected to each other, ignoring edge direction; no edge
+    // joins two components, so they can run independently. Each component
+    // is in topological order
+    QVector<QVector<NodeId>> connectedComponents() const;
+    // a label equal for nodes of the same connected component, and
+    // different for nodes of different ones
+    int componentOf(NodeId node) const;
+
+private:
+    enum {AliveFlag = 0x01, VisitedFlag = 0x02, SideAFlag = 0x04, SideBFlag = 0x08};
+
+    bool isAlive(NodeId node) const;
+    bool isOrdered(NodeId source, NodeId dest) const;
+    bool insertOrdered(NodeId source, NodeId dest);
+    bool searchForward(NodeId node, int bound, QVector<NodeId> &delta);
+    void searchBackward(NodeId node, int bound, QVector<NodeId> &delta);
+    void reorder(QVector<NodeId> &deltaBackward, QVector<NodeId> &deltaForward);
+    void orderBackEdges(NodeId source, NodeId dest);
+    void relabel(NodeId node, int from, int to);
+    void merge(NodeId a, NodeId b);
+    void split(NodeId a, NodeId b);
+
+    const QDataflowGraph *graph_;
+    QVector<QPair<NodeId, NodeId>> backEdges_;
+    QVector<quint8> flags_;
+    // node -> position, and position -> node
+    QVector<int> ord_;
+    QVector<NodeId> nodeAt_;
+    quint64 orderGeneration_;
+
+    // node -> component label, and label -> node count
+    QVector<int> component_;
+    QHash<int, int> componentSize_;
+    int nextComponent_;
+};
+
+#endif // QDATAFLOWGRAPHANALYSIS_H
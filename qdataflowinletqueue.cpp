@@ -0,0 +1,194 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowinletqueue.h"
+
+#include <QThread>
+
+namespace {
+
+class SpinLocker
+{
+public:
+    explicit SpinLocker(std::atomic_flag &flag) : flag_(flag)
+    {
+        while(flag_.test_and_set(std::memory_order_acquire))
+            QThread::yieldCurrentThread();
+    }
+    ~SpinLocker() {flag_.clear(std::memory_order_release);}
+
+private:
+    std::atomic_flag &flag_;
+};
+
+} // namespace
+
+static quintptr roundUpToPowerOfTwo(int n)
+{
+    quintptr size = 2;
+    while(size < quintptr(n)) size <<= 1;
+    return size;
+}
+
+QDataflowInletQueue::QDataflowInletQueue(int capacity, Policy policy)
+    : policy_(policy),
+      mask_(policy == CoalesceLatest ? 0 : roundUpToPowerOfTwo(capacity) - 1),
+      cells_(new Cell[mask_ + 1]),
+      enqueuePos_(0),
+      dequeuePos_(0),
+      latestFull_(false),
+      dropped_(0)
+{
+    latestLock_.clear();
+    for(quintptr i = 0; i <= mask_; i++)
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+QDataflowInletQueue::~QDataflowInletQueue()
+{
+    delete[] cells_;
+}
+
+int QDataflowInletQueue::capacity() const
+{
+    return policy_ == CoalesceLatest ? 1 : int(mask_ + 1);
+}
+
+int QDataflowInletQueue::size() const
+{
+    if(policy_ == CoalesceLatest)
+        return latestFull_.load(std::memory_order_relaxed) ? 1 : 0;
+
+    const quintptr head = dequeuePos_.load(std::memory_order_relaxed);
+    const quintptr tail = enqueuePos_.load(std::memory_order_relaxed);
+    // the positions are read separately and may pass each other
+    const qintptr size = qintptr(tail - head);
+    if(size < 0) return 0;
+    return int(qMin(quintptr(size), mask_ + 1));
+}
+
+bool QDataflowInletQueue::push(const QDataflowMessage &message, quint64 order, bool wait)
+{
+    switch(policy_)
+    {
+    case CoalesceLatest:
+    {
+        // the replaced payload is released after the lock
+        QDataflowMessage old;
+        SpinLocker lock(latestLock_);
+        old = std::move(cells_[0].message);
+        cells_[0].message = message;
+        cells_[0].order = order;
+        if(latestFull_.exchange(true, std::memory_order_relaxed))
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    case DropOldest:
+        while(!tryPush(message, order))
+        {
+            QDataflowMessage oldest;
+            if(pop(oldest))
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+
+    case Block:
+        for(int spins = 0; !tryPush(message, order); spins++)
+        {
+            if(!wait) return false;
+            if(spins < 64) QThread::yieldCurrentThread();
+            else QThread::usleep(50);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool QDataflowInletQueue::tryPush(const QDataflowMessage &message, quint64 order)
+{
+    quintptr pos = enqueuePos_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for(;;)
+    {
+        cell = &cells_[pos & mask_];
+        const quintptr seq = cell->sequence.load(std::memory_order_acquire);
+        const qintptr diff = qintptr(seq) - qintptr(pos);
+        if(diff == 0)
+        {
+            if(enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+        {
+            // the cell still holds the message from one lap ago: full
+            return false;
+        }
+        else
+        {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->message = message;
+    cell->order = order;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool QDataflowInletQueue::pop(QDataflowMessage &message, quint64 *order)
+{
+    if(policy_ == CoalesceLatest)
+    {
+        if(!latestFull_.load(std::memory_order_relaxed)) return false;
+        SpinLocker lock(latestLock_);
+        if(!latestFull_.exchange(false, std::memory_order_relaxed)) return false;
+        message = std::move(cells_[0].message);
+        cells_[0].message = QDataflowMessage();
+        if(order) *order = cells_[0].order;
+        return true;
+    }
+
+    quintptr pos = dequeuePos_.load(std::memory_order_relaxed);
+    Cell *cell;
+    for(;;)
+    {
+        cell = &cells_[pos & mask_];
+        const quintptr seq = cell->sequence.load(std::memory_order_acquire);
+        const qintptr diff = qintptr(seq) - qintptr(pos + 1);
+        if(diff == 0)
+        {
+            // DropOldest producers pop too, so the consumer is not alone here
+            if(dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = dequeuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    message = std::move(cell->message);
+    if(order) *order = cell->order;
+    // release the payload now rather than a lap later
+    cell->message = QDataflowMessage();
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+}
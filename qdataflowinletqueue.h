@@ -0,0 +1,90 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWINLETQUEUE_H
+#define QDATAFLOWINLETQUEUE_H
+
+#include <QtGlobal>
+#include <atomic>
+#include "qdataflowmessage.h"
+
+// A bounded, lock-free queue of messages waiting for one inlet.
+//
+// Any number of threads may push; the scheduler worker running the meta
+// object pops. The ring buffer has a power-of-two number of cells, each
+// with a sequence number telling producers and consumers whose turn it is,
+// so neither side ever takes a lock.
+//
+// The policy decides what a push does when the queue is full:
+//   DropOldest      the oldest queued message is discarded
+//   Block           the producer waits until the consumer makes room
+//   CoalesceLatest  only the newest message is kept, whatever the capacity
+// Discarded and replaced messages are counted in droppedCount().
+//
+// Every message carries the order it was sent in, which the scheduler uses
+// to merge the queues of a node with its mailbox. A CoalesceLatest queue is
+// a single slot behind a spin lock held for one message assignment.
+class QDataflowInletQueue
+{
+public:
+    enum Policy {
+        DropOldest,
+        Block,
+        CoalesceLatest
+    };
+
+    // capacity is rounded up to a power of two
+    explicit QDataflowInletQueue(int capacity, Policy policy = DropOldest);
+    ~QDataflowInletQueue();
+
+    QDataflowInletQueue(const QDataflowInletQueue &) = delete;
+    QDataflowInletQueue & operator=(const QDataflowInletQueue &) = delete;
+
+    Policy policy() const {return policy_;}
+    int capacity() const;
+
+    // for monitoring; approximate while other threads push or pop
+    int size() const;
+    bool isEmpty() const {return size() == 0;}
+    quint64 droppedCount() const {return dropped_.load(std::memory_order_relaxed);}
+
+    // false only when a Block queue is full and wait is false
+    bool push(const QDataflowMessage &message, quint64 order = 0, bool wait = true);
+    bool pop(QDataflowMessage &message, quint64 *order = nullptr);
+
+private:
+    bool tryPush(const QDataflowMessage &message, quint64 order);
+
+    struct Cell
+    {
+        std::atomic<quintptr> sequence;
+        quint64 order;
+        QDataflowMessage message;
+    };
+
+    const Policy policy_;
+    const quintptr mask_;
+    Cell *cells_;
+    // producers and the consumer write these; keep them off each other's line
+    alignas(64) std::atomic<quintptr> enqueuePos_;
+    alignas(64) std::atomic<quintptr> dequeuePos_;
+    // CoalesceLatest: cells_[0] is the slot
+    alignas(64) std::atomic_flag latestLock_;
+    std::atomic<bool> latestFull_;
+    std::atomic<quint64> dropped_;
+};
+
+#endif // QDATAFLOWINLETQUEUE_H
@@ -0,0 +1,184 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowkernels.h"
+
+#include <cmath>
+
+#if !defined(QDATAFLOW_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define QDATAFLOW_SSE2
+#include <emmintrin.h>
+#endif
+
+struct QDataflowAddOp
+{
+    static float scalar(float a, float b) {return a + b;}
+#ifdef QDATAFLOW_SSE2
+    static __m128 vector(__m128 a, __m128 b) {return _mm_add_ps(a, b);}
+#endif
+};
+
+struct QDataflowSubOp
+{
+    static float scalar(float a, float b) {return a - b;}
+#ifdef QDATAFLOW_SSE2
+    static __m128 vector(__m128 a, __m128 b) {return _mm_sub_ps(a, b);}
+#endif
+};
+
+struct QDataflowMulOp
+{
+    static float scalar(float a, float b) {return a * b;}
+#ifdef QDATAFLOW_SSE2
+    static __m128 vector(__m128 a, __m128 b) {return _mm_mul_ps(a, b);}
+#endif
+};
+
+struct QDataflowDivOp
+{
+    static float scalar(float a, float b) {return a / b;}
+#ifdef QDATAFLOW_SSE2
+    static __m128 vector(__m128 a, __m128 b) {return _mm_div_ps(a, b);}
+#endif
+};
+
+template<typename Op>
+static void binary(float *dst, const float *a, const float *b, int count)
+{
+    int i = 0;
+#ifdef QDATAFLOW_SSE2
+    // two vectors per iteration keep both arithmetic ports busy
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128 r0 = Op::vector(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        const __m128 r1 = Op::vector(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        _mm_storeu_ps(dst + i, r0);
+        _mm_storeu_ps(dst + i + 4, r1);
+    }
+    for(; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, Op::vector(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+#endif
+    for(; i < count; i++)
+        dst[i] = Op::scalar(a[i], b[i]);
+}
+
+template<typename Op>
+static void binary(float *dst, const float *a, float b, int count)
+{
+    int i = 0;
+#ifdef QDATAFLOW_SSE2
+    const __m128 vb = _mm_set1_ps(b);
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128 r0 = Op::vector(_mm_loadu_ps(a + i), vb);
+        const __m128 r1 = Op::vector(_mm_loadu_ps(a + i + 4), vb);
+        _mm_storeu_ps(dst + i, r0);
+        _mm_storeu_ps(dst + i + 4, r1);
+    }
+    for(; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, Op::vector(_mm_loadu_ps(a + i), vb));
+#endif
+    for(; i < count; i++)
+        dst[i] = Op::scalar(a[i], b);
+}
+
+void QDataflowKernels::apply(Op op, float *dst, const float *a, const float *b, int count)
+{
+    switch(op)
+    {
+    case Add: add(dst, a, b, count); break;
+    case Sub: sub(dst, a, b, count); break;
+    case Mul: mul(dst, a, b, count); break;
+    case Div: div(dst, a, b, count); break;
+    case Pow: pow(dst, a, b, count); break;
+    }
+}
+
+void QDataflowKernels::apply(Op op, float *dst, const float *a, float b, int count)
+{
+    switch(op)
+    {
+    case Add: add(dst, a, b, count); break;
+    case Sub: sub(dst, a, b, count); break;
+    case Mul: mul(dst, a, b, count); break;
+    case Div: div(dst, a, b, count); break;
+    case Pow: pow(dst, a, b, count); break;
+    }
+}
+
+void QDataflowKernels::add(float *dst, const float *a, const float *b, int count)
+{
+    binary<QDataflowAddOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::sub(float *dst, const float *a, const float *b, int count)
+{
+    binary<QDataflowSubOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::mul(float *dst, const float *a, const float *b, int count)
+{
+    binary<QDataflowMulOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::div(float *dst, const float *a, const float *b, int count)
+{
+    binary<QDataflowDivOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::pow(float *dst, const float *a, const float *b, int count)
+{
+    for(int i = 0; i < count; i++)
+        dst[i] = std::pow(a[i], b[i]);
+}
+
+void QDataflowKernels::add(float *dst, const float *a, float b, int count)
+{
+    binary<QDataflowAddOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::sub(float *dst, const float *a, float b, int count)
+{
+    binary<QDataflowSubOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::mul(float *dst, const float *a, float b, int count)
+{
+    binary<QDataflowMulOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::div(float *dst, const float *a, float b, int count)
+{
+    binary<QDataflowDivOp>(dst, a, b, count);
+}
+
+void QDataflowKernels::pow(float *dst, const float *a, float b, int count)
+{
+    // the common exponents are cheaper done directly
+    if(b == 2.0f)
+    {
+        binary<QDataflowMulOp>(dst, a, a, count);
+        return;
+    }
+    if(b == 1.0f)
+    {
+        for(int i = 0; i < count; i++)
+            dst[i] = a[i];
+        return;
+    }
+    for(int i = 0; i < count; i++)
+        dst[i] = std::pow(a[i], b);
+}
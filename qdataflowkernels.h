@@ -0,0 +1,50 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWKERNELS_H
+#define QDATAFLOWKERNELS_H
+
+// Element-wise arithmetic on sample blocks, for block processing in
+// QDataflowMetaObject::onBlockReceived().
+//
+// With SSE2, which every x86-64 compiler enables, four samples are done per
+// instruction; other targets, and builds defining QDATAFLOW_NO_SIMD, use
+// plain loops. pow has no SIMD form and is always computed per sample.
+// dst may be the same block as either operand.
+class QDataflowKernels
+{
+public:
+    enum Op {Add, Sub, Mul, Div, Pow};
+
+    // dst[i] = a[i] op b[i]
+    static void apply(Op op, float *dst, const float *a, const float *b, int count);
+    // dst[i] = a[i] op b
+    static void apply(Op op, float *dst, const float *a, float b, int count);
+
+    static void add(float *dst, const float *a, const float *b, int count);
+    static void sub(float *dst, const float *a, const float *b, int count);
+    static void mul(float *dst, const float *a, const float *b, int count);
+    static void div(float *dst, const float *a, const float *b, int count);
+    static void pow(float *dst, const float *a, const float *b, int count);
+
+    static void add(float *dst, const float *a, float b, int count);
+    static void sub(float *dst, const float *a, float b, int count);
+    static void mul(float *dst, const float *a, float b, int count);
+    static void div(float *dst, const float *a, float b, int count);
+    static void pow(float *dst, const float *a, float b, int count);
+};
+
+#endif // QDATAFLOWKERNELS_H
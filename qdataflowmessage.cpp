@@ -0,0 +1,180 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowmessage.h"
+#include "qdataflowtyperegistry.h"
+
+QDataflowMessage::QDataflowMessage(const char *value)
+    : QDataflowMessage(QString::fromUtf8(value))
+{
+}
+
+QDataflowMessage::QDataflowMessage(const QString &value)
+    : type_(String), payload_(new QDataflowMessagePayloadT<QString>(QStringLiteral("string"), value))
+{
+    scalar_.i = 0;
+}
+
+QDataflowMessage::QDataflowMessage(const QByteArray &value)
+    : type_(Bytes), payload_(new QDataflowMessagePayloadT<QByteArray>(QStringLiteral("bytes"), value))
+{
+    scalar_.i = 0;
+}
+
+QDataflowMessage::QDataflowMessage(const QVector<float> &samples)
+    : type_(Samples), payload_(new QDataflowMessagePayloadT<QVector<float>>(QStringLiteral("samples"), samples))
+{
+    scalar_.i = 0;
+}
+
+QDataflowMessage QDataflowMessage::bang()
+{
+    QDataflowMessage msg;
+    msg.type_ = Bang;
+    return msg;
+}
+
+QString QDataflowMessage::typeName() const
+{
+    switch(type_)
+    {
+    case Invalid: return {};
+    case Bang: return QStringLiteral("bang");
+    case Int: return QStringLiteral("int");
+    case Double: return QStringLiteral("double");
+    case Bool: return QStringLiteral("bool");
+    case String:
+    case Bytes:
+    case Samples:
+    case Custom:
+        return payload_->typeName;
+    }
+    return {};
+}
+
+bool QDataflowMessage::isCompatibleWith(const QString &ioletType) const
+{
+    if(ioletType == "*") return isValid();
+    return ioletType == typeName();
+}
+
+bool QDataflowMessage::isCompatibleWith(int ioletTypeId, const QString &ioletType) const
+{
+    if(ioletTypeId == QDataflowTypeRegistry::AnyType) return isValid();
+    if(type_ == Custom) return ioletType == payload_->typeName;
+    return ioletTypeId == typeId();
+}
+
+int QDataflowMessage::typeId() const
+{
+    if(type_ == Invalid || type_ == Custom) return QDataflowTypeRegistry::InvalidId;
+    return int(type_);
+}
+
+qint64 QDataflowMessage::toInt() const
+{
+    switch(type_)
+    {
+    case Int: return scalar_.i;
+    case Double: return qint64(scalar_.d);
+    case Bool: return scalar_.b ? 1 : 0;
+    case String: return builtin<QString>().toLongLong();
+    default: return 0;
+    }
+}
+
+double QDataflowMessage::toDouble() const
+{
+    switch(type_)
+    {
+    case Int: return double(scalar_.i);
+    case Double: return scalar_.d;
+    case Bool: return scalar_.b ? 1.0 : 0.0;
+    case String: return builtin<QString>().toDouble();
+    default: return 0.0;
+    }
+}
+
+bool QDataflowMessage::toBool() const
+{
+    switch(type_)
+    {
+    case Int: return scalar_.i != 0;
+    case Double: return scalar_.d != 0.0;
+    case Bool: return scalar_.b;
+    default: return false;
+    }
+}
+
+QString QDataflowMessage::toString() const
+{
+    switch(type_)
+    {
+    case Int: return QString::number(scalar_.i);
+    case Double: return QString::number(scalar_.d);
+    case Bool: return scalar_.b ? QStringLiteral("true") : QStringLiteral("false");
+    case String: return builtin<QString>();
+    case Bytes: return QString::fromUtf8(builtin<QByteArray>());
+    default: return {};
+    }
+}
+
+QByteArray QDataflowMessage::toByteArray() const
+{
+    switch(type_)
+    {
+    case String: return builtin<QString>().toUtf8();
+    case Bytes: return builtin<QByteArray>();
+    default: return toString().toUtf8();
+    }
+}
+
+const float * QDataflowMessage::sampleData() const
+{
+    if(type_ != Samples) return nullptr;
+    return builtin<QVector<float>>().constData();
+}
+
+int QDataflowMessage::sampleCount() const
+{
+    if(type_ != Samples) return 0;
+    return builtin<QVector<float>>().size();
+}
+
+QVector<float> QDataflowMessage::toSamples() const
+{
+    switch(type_)
+    {
+    case Samples: return builtin<QVector<float>>();
+    case Int:
+    case Double:
+        return QVector<float>(1, float(toDouble()));
+    default: return {};
+    }
+}
+
+QDebug operator<<(QDebug debug, const QDataflowMessage &msg)
+{
+    QDebugStateSaver stateSaver(debug);
+    debug.nospace() << "QDataflowMessage";
+    debug.nospace() << "(" << msg.typeName();
+    if(msg.type() == QDataflowMessage::Samples)
+        debug.nospace() << ", size=" << msg.toSamples().size();
+    else if(msg.type() != QDataflowMessage::Custom && msg.type() != QDataflowMessage::Bang)
+        debug.nospace() << ", " << msg.toString();
+    debug.nospace() << ")";
+    return debug;
+}
@@ -0,0 +1,140 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWMESSAGE_H
+#define QDATAFLOWMESSAGE_H
+
+#include <QByteArray>
+#include <QDebug>
+#include <QSharedData>
+#include <QString>
+#include <QVector>
+#include <utility>
+
+// Immutable, reference counted payload. Copies of a message share it, so
+// fanning a message out to several inlets or threads never copies the data.
+class QDataflowMessagePayload : public QSharedData
+{
+public:
+    explicit QDataflowMessagePayload(const QString &typeName) : typeName(typeName) {}
+    virtual ~QDataflowMessagePayload() = default;
+
+    const QString typeName;
+};
+
+template<typename T>
+class QDataflowMessagePayloadT : public QDataflowMessagePayload
+{
+public:
+    QDataflowMessagePayloadT(const QString &typeName, T value)
+        : QDataflowMessagePayload(typeName), value(std::move(value)) {}
+
+    const T value;
+};
+
+// Scalars are stored inline; strings, byte arrays, sample blocks and custom
+// values live in a shared payload. typeName() is what gets matched against
+// the type() of the outlet a message is sent through.
+class QDataflowMessage
+{
+public:
+    enum Type {
+        Invalid,
+        Bang,
+        Int,
+        Double,
+        Bool,
+        String,
+        Bytes,
+        Samples,
+        Custom
+    };
+
+    QDataflowMessage() : type_(Invalid) {scalar_.i = 0;}
+    QDataflowMessage(int value) : type_(Int) {scalar_.i = value;}
+    QDataflowMessage(qint64 value) : type_(Int) {scalar_.i = value;}
+    QDataflowMessage(double value) : type_(Double) {scalar_.d = value;}
+    QDataflowMessage(bool value) : type_(Bool) {scalar_.b = value;}
+    // a pointer would otherwise silently become a bool message
+    QDataflowMessage(const void *) = delete;
+    QDataflowMessage(const char *value);
+    QDataflowMessage(const QString &value);
+    QDataflowMessage(const QByteArray &value);
+    QDataflowMessage(const QVector<float> &samples);
+
+    static QDataflowMessage bang();
+
+    template<typename T>
+    static QDataflowMessage fromValue(T value, const QString &typeName);
+
+    Type type() const {return type_;}
+    QString typeName() const;
+    bool isValid() const {return type_ != Invalid;}
+    bool isCompatibleWith(const QString &ioletType) const;
+    // built-in types are matched by their id in the model's type registry,
+    // which interns them right after "*" in the order of Type; custom
+    // payloads are matched by name
+    bool isCompatibleWith(int ioletTypeId, const QString &ioletType) const;
+    int typeId() const;
+
+    qint64 toInt() const;
+    double toDouble() const;
+    bool toBool() const;
+    QString toString() const;
+    QByteArray toByteArray() const;
+    QVector<float> toSamples() const;
+    // the samples in place, valid while the message exists; null and 0
+    // for other types
+    const float * sampleData() const;
+    int sampleCount() const;
+
+    // for custom payloads; null if the message does not hold a T
+    template<typename T>
+    const T * value() const;
+
+private:
+    // built-in payload types are known from type_ and need no dynamic_cast
+    template<typename T>
+    const T & builtin() const {return static_cast<const QDataflowMessagePayloadT<T>*>(payload_.data())->value;}
+
+    Type type_;
+    union {
+        qint64 i;
+        double d;
+        bool b;
+    } scalar_;
+    QExplicitlySharedDataPointer<QDataflowMessagePayload> payload_;
+};
+
+template<typename T>
+QDataflowMessage QDataflowMessage::fromValue(T value, const QString &typeName)
+{
+    QDataflowMessage msg;
+    msg.type_ = Custom;
+    msg.payload_ = new QDataflowMessagePayloadT<T>(typeName, std::move(value));
+    return msg;
+}
+
+template<typename T>
+const T * QDataflowMessage::value() const
+{
+    auto *payload = dynamic_cast<const QDataflowMessagePayloadT<T>*>(payload_.data());
+    return payload ? &payload->value : nullptr;
+}
+
+QDebug operator<<(QDebug debug, const QDataflowMessage &msg);
+
+#endif // QDATAFLOWMESSAGE_H
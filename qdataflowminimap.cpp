@@ -0,0 +1,185 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowminimap.h"
+#include "qdataflowcanvas.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+// the graph only knows node positions; boxes get a nominal size
+static const QSizeF minimapNodeSize(60, 24);
+
+static const qreal minimapMargin = 4;
+
+QDataflowMinimap::QDataflowMinimap(QWidget *parent)
+    : QWidget(parent)
+{
+    updateTimer_.setSingleShot(true);
+    updateTimer_.setInterval(16);
+    QObject::connect(&updateTimer_, &QTimer::timeout, this, static_cast<void (QWidget::*)()>(&QWidget::update));
+
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setCursor(Qt::PointingHandCursor);
+}
+
+QDataflowCanvas * QDataflowMinimap::canvas() const
+{
+    return canvas_;
+}
+
+void QDataflowMinimap::setCanvas(QDataflowCanvas *canvas)
+{
+    if(canvas == canvas_) return;
+
+    if(canvas_)
+    {
+        QObject::disconnect(canvas_.data(), nullptr, this, nullptr);
+        QObject::disconnect(canvas_->horizontalScrollBar(), nullptr, this, nullptr);
+        QObject::disconnect(canvas_->verticalScrollBar(), nullptr, this, nullptr);
+    }
+
+    canvas_ = canvas;
+    setModel(canvas ? canvas->model() : nullptr);
+    if(!canvas) return;
+
+    // scrolling, zooming and resizing all move the scroll bars
+    QObject::connect(canvas, &QDataflowCanvas::modelChanged, this, &QDataflowMinimap::setModel);
+    QObject::connect(canvas->horizontalScrollBar(), &QScrollBar::valueChanged, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(canvas->horizontalScrollBar(), &QScrollBar::rangeChanged, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(canvas->verticalScrollBar(), &QScrollBar::valueChanged, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(canvas->verticalScrollBar(), &QScrollBar::rangeChanged, this, &QDataflowMinimap::scheduleUpdate);
+}
+
+QSize QDataflowMinimap::sizeHint() const
+{
+    return QSize(200, 150);
+}
+
+void QDataflowMinimap::setModel(QDataflowModel *model)
+{
+    if(model_)
+        QObject::disconnect(model_.data(), nullptr, this, nullptr);
+
+    model_ = model;
+    scheduleUpdate();
+    if(!model) return;
+
+    QObject::connect(model, &QDataflowModel::nodeAdded, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(model, &QDataflowModel::nodeRemoved, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(model, &QDataflowModel::nodePosChanged, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(model, &QDataflowModel::connectionAdded, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(model, &QDataflowModel::connectionRemoved, this, &QDataflowMinimap::scheduleUpdate);
+    QObject::connect(model, &QDataflowModel::transactionCommitted, this, &QDataflowMinimap::scheduleUpdate);
+}
+
+void QDataflowMinimap::scheduleUpdate()
+{
+    if(!updateTimer_.isActive())
+        updateTimer_.start();
+}
+
+void QDataflowMinimap::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    updateTimer_.stop();
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    bounds_ = QRectF();
+    target_ = QRectF();
+    if(!canvas_ || !model_) return;
+
+    const QDataflowGraph &graph = model_->graph();
+    nodeRects_.clear();
+    edgeLines_.clear();
+    nodeRects_.reserve(graph.nodeCount());
+    edgeLines_.reserve(graph.edgeCount());
+
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+    {
+        if(!graph.containsNode(id)) continue;
+        const QRectF r(graph.pos(id), minimapNodeSize);
+        nodeRects_.push_back(r);
+        bounds_ |= r;
+    }
+
+    // from below the source box to the top of the destination box
+    const QPointF outletOffset(minimapNodeSize.width() / 2, minimapNodeSize.height());
+    const QPointF inletOffset(minimapNodeSize.width() / 2, 0);
+    for(int e = 0; e < graph.edgeIdBound(); e++)
+    {
+        if(!graph.containsEdge(e)) continue;
+        edgeLines_.push_back(QLineF(graph.pos(graph.edgeSource(e)) + outletOffset, graph.pos(graph.edgeDest(e)) + inletOffset));
+    }
+
+    const QRectF shown = canvas_->mapToScene(canvas_->viewport()->rect()).boundingRect();
+    bounds_ |= shown;
+    if(bounds_.width() <= 0 || bounds_.height() <= 0) return;
+
+    const QRectF area = QRectF(rect()).adjusted(minimapMargin, minimapMargin, -minimapMargin, -minimapMargin);
+    const qreal scale = qMin(area.width() / bounds_.width(), area.height() / bounds_.height());
+    if(scale <= 0) return;
+    target_ = QRectF(QPointF(), bounds_.size() * scale);
+    target_.moveCenter(area.center());
+
+    painter.translate(target_.topLeft());
+    painter.scale(scale, scale);
+    painter.translate(-bounds_.topLeft());
+
+    // zero width pens stay one pixel wide at any scale
+    painter.setPen(QPen(palette().text(), 0));
+    painter.drawLines(edgeLines_);
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(palette().mid());
+    painter.drawRects(nodeRects_);
+
+    painter.setPen(QPen(palette().highlight(), 0));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(shown);
+}
+
+QPointF QDataflowMinimap::toScene(const QPointF &widgetPos) const
+{
+    const qreal scale = target_.width() / bounds_.width();
+    return bounds_.topLeft() + (widgetPos - target_.topLeft()) / scale;
+}
+
+void QDataflowMinimap::mousePressEvent(QMouseEvent *event)
+{
+    if(!canvas_ || target_.isEmpty() || event->button() != Qt::LeftButton)
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    canvas_->centerOn(toScene(event->pos()));
+    event->accept();
+}
+
+void QDataflowMinimap::mouseMoveEvent(QMouseEvent *event)
+{
+    if(!canvas_ || target_.isEmpty() || !(event->buttons() & Qt::LeftButton))
+    {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+    canvas_->centerOn(toScene(event->pos()));
+    event->accept();
+}
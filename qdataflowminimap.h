@@ -0,0 +1,71 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWMINIMAP_H
+#define QDATAFLOWMINIMAP_H
+
+#include <QLineF>
+#include <QPointer>
+#include <QRectF>
+#include <QTimer>
+#include <QVector>
+#include <QWidget>
+
+class QDataflowCanvas;
+class QDataflowModel;
+
+// An overview of the whole model, with the part shown by a canvas framed.
+// It creates no items: nodes and connections are drawn straight from the
+// flat position and edge arrays of the model's QDataflowGraph, as one batch
+// of rectangles and one batch of lines, so it stays cheap for models far
+// larger than the canvas would build items for. Clicking or dragging
+// centers the canvas on that point.
+class QDataflowMinimap : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit QDataflowMinimap(QWidget *parent = {});
+
+    QDataflowCanvas * canvas() const;
+    void setCanvas(QDataflowCanvas *canvas);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private Q_SLOTS:
+    void setModel(QDataflowModel *model);
+    void scheduleUpdate();
+
+private:
+    QPointF toScene(const QPointF &widgetPos) const;
+
+    QPointer<QDataflowCanvas> canvas_;
+    QPointer<QDataflowModel> model_;
+    // model edits and canvas repaints are coalesced to one repaint per frame
+    QTimer updateTimer_;
+    // the scene rect drawn, and where it went on the widget
+    QRectF bounds_;
+    QRectF target_;
+    // kept between repaints for their capacity
+    QVector<QRectF> nodeRects_;
+    QVector<QLineF> edgeLines_;
+};
+
+#endif // QDATAFLOWMINIMAP_H
@@ -16,21 +16,60 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "qdataflowmodel.h"
-#include "qdataflowcanvas.h"
+#include "qdataflownodefactory.h"
+#include "qdataflowscheduler.h"
 #include "utility.h"
 
+#include <algorithm>
+
+bool QDataflowModelChangeSet::isEmpty() const
+{
+    return addedNodes.isEmpty() && removedNodes.isEmpty() &&
+            addedConnections.isEmpty() && removedConnections.isEmpty() &&
+            addedNodeIds.isEmpty() && addedConnectionIds.isEmpty() &&
+            changedNodes.isEmpty();
+}
+
 QDataflowModel::QDataflowModel(QObject *parent)
-    : QObject(parent)
+    : QObject(parent), transactionDepth_(0), dispatchCompiled_(false), scheduler_(), analysis_(&graph_), rejectCycles_(false), undoLog_(this)
 {
 
 }
 
+QDataflowModel::~QDataflowModel()
+{
+    if(scheduler_) scheduler_->waitForIdle();
+    undoLog_.setEnabled(false);
+
+    // factories unbind the nodes while the model is still whole
+    while(!factories_.isEmpty())
+        delete factories_.last();
+
+    // the objects are owned through the id tables and deleted while the
+    // graph is still there; removed ones are included, as views may refer
+    // to them until the model goes away
+    qDeleteAll(connectionsById_);
+    qDeleteAll(nodesById_);
+
+    // the pools are shared by all models; the last one frees the arenas
+    QDataflowModelConnection::pool().clear();
+    QDataflowModelNode::pool().clear();
+    QDataflowModelInlet::pool().clear();
+    QDataflowModelOutlet::pool().clear();
+}
+
 QDataflowModelNode * QDataflowModel::newNode(const QPoint &pos, const QString &text, int inletCount, int outletCount)
 {
     QDataflowModelNode *node = new QDataflowModelNode(this, pos, text, inletCount, outletCount);
     return node;
 }
 
+QDataflowModelNode * QDataflowModel::newNode(const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes)
+{
+    QDataflowModelNode *node = new QDataflowModelNode(this, pos, text, inletTypes, outletTypes);
+    return node;
+}
+
 QDataflowModelConnection * QDataflowModel::newConnection(QDataflowModelNode *sourceNode, int sourceOutlet, QDataflowModelNode *destNode, int destInlet)
 {
     QDataflowModelConnection *conn = new QDataflowModelConnection(this, sourceNode->outlet(sourceOutlet), destNode->inlet(destInlet));
@@ -40,33 +79,152 @@ QDataflowModelConnection * QDataflowModel::newConnection(QDataflowModelNode *sou
 QDataflowModelNode * QDataflowModel::create(const QPoint &pos, const QString &text, int inletCount, int outletCount)
 {
     QDataflowModelNode *node = newNode(pos, text, inletCount, outletCount);
-    nodes_.insert(node);
+    insertNode(node);
+    return node;
+}
+
+QDataflowModelNode * QDataflowModel::create(const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes)
+{
+    QDataflowModelNode *node = newNode(pos, text, inletTypes, outletTypes);
+    insertNode(node);
+    return node;
+}
+
+int QDataflowModel::createNode(const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes)
+{
+    const int id = graph_.addNode(pos, text, false);
+    graph_.setInletTypes(id, internTypes(inletTypes));
+    graph_.setOutletTypes(id, internTypes(outletTypes));
+    analysis_.addNode(id);
+    {
+        QMutexLocker locker(&handlesMutex_);
+        nodesById_.resize(graph_.nodeIdBound());
+    }
+    // reported like a node added while a transaction is open; the command
+    // closes after the node was set up by whoever handles the commit
+    beginTransaction();
+    undoLog_.recordCreate(id);
+    pendingChanges_.addedNodeIds.push_back(id);
+    pendingAddedNodeIds_.insert(id);
+    commitTransaction();
+    return id;
+}
+
+int QDataflowModel::connectNodes(int sourceNode, int sourceOutlet, int destNode, int destInlet)
+{
+    if(!graph_.containsNode(sourceNode) || !graph_.containsNode(destNode)) return QDataflowGraph::InvalidId;
+    if(sourceOutlet < 0 || sourceOutlet >= graph_.outletCount(sourceNode)) return QDataflowGraph::InvalidId;
+    if(destInlet < 0 || destInlet >= graph_.inletCount(destNode)) return QDataflowGraph::InvalidId;
+    if(graph_.findEdge(sourceNode, sourceOutlet, destNode, destInlet) != QDataflowGraph::InvalidId) return QDataflowGraph::InvalidId;
+    if(!graph_.types().isCompatible(graph_.outletType(sourceNode, sourceOutlet), graph_.inletType(destNode, destInlet)))
+    {
+        qDebug() << "cannot connect outlet" << sourceOutlet << "of node" << sourceNode << "to inlet" << destInlet << "of node" << destNode;
+        return QDataflowGraph::InvalidId;
+    }
+    if(rejectCycles_ && analysis_.wouldCreateCycle(sourceNode, destNode))
+    {
+        qDebug() << "connecting node" << sourceNode << "to node" << destNode << "would create a cycle";
+        return QDataflowGraph::InvalidId;
+    }
+    const int id = graph_.addEdge(sourceNode, sourceOutlet, destNode, destInlet);
+    analysis_.addEdge(sourceNode, destNode);
+    {
+        QMutexLocker locker(&handlesMutex_);
+        connectionsById_.resize(graph_.edgeIdBound());
+    }
+    if(QDataflowModelNode *source = findNode(sourceNode))
+        source->outlet(sourceOutlet)->invalidateDispatchTable();
+    beginTransaction();
+    undoLog_.recordConnect(sourceNode, sourceOutlet, destNode, destInlet);
+    pendingChanges_.addedConnectionIds.push_back(id);
+    pendingAddedConnectionIds_.insert(id);
+    commitTransaction();
+    return id;
+}
+
+QVector<QDataflowGraph::TypeId> QDataflowModel::internTypes(const QStringList &types)
+{
+    QVector<QDataflowGraph::TypeId> ids;
+    ids.reserve(types.size());
+    for(const QString &type : types)
+        ids.push_back(graph_.internType(type));
+    return ids;
+}
+
+void QDataflowModel::insertNode(QDataflowModelNode *node)
+{
+    // the graph takes over the state the object held until now
+    const int id = graph_.addNode(node->pos_, node->text_, node->valid_);
+    const int previousId = node->lastId_;
+    node->id_ = node->lastId_ = id;
+    node->text_.clear();
+    analysis_.addNode(id);
+    {
+        QMutexLocker locker(&handlesMutex_);
+        nodesById_.resize(graph_.nodeIdBound());
+        // a node added again is owned by its new slot only
+        if(previousId != QDataflowGraph::InvalidId && nodesById_[previousId] == node)
+            nodesById_[previousId] = nullptr;
+        nodesById_[id] = node;
+    }
+    updateGraphIOlets(node);
+    connectNodeSignals(node);
+    // the command closes after the node was set up by whoever handles
+    // nodeAdded(), so that the iolet types are recorded too
+    undoLog_.beginCommand();
+    undoLog_.recordCreate(id);
+    if(transactionDepth_) recordNodeAdded(node);
+    else Q_EMIT nodeAdded(node);
+    undoLog_.endCommand();
+}
+
+void QDataflowModel::connectNodeSignals(QDataflowModelNode *node)
+{
     QObject::connect(node, &QDataflowModelNode::validChanged, this, &QDataflowModel::onValidChanged);
     QObject::connect(node, &QDataflowModelNode::posChanged, this, &QDataflowModel::onPosChanged);
     QObject::connect(node, &QDataflowModelNode::textChanged, this, &QDataflowModel::onTextChanged);
     QObject::connect(node, &QDataflowModelNode::inletCountChanged, this, &QDataflowModel::onInletCountChanged);
     QObject::connect(node, &QDataflowModelNode::outletCountChanged, this, &QDataflowModel::onOutletCountChanged);
-    Q_EMIT nodeAdded(node);
-    return node;
+    QObject::connect(node, &QDataflowModelNode::inletTypesChanged, this, &QDataflowModel::onInletTypesChanged);
+    QObject::connect(node, &QDataflowModelNode::outletTypesChanged, this, &QDataflowModel::onOutletTypesChanged);
 }
 
-void QDataflowModel::remove(QDataflowModelNode *node)
+void QDataflowModel::disconnectNodeSignals(QDataflowModelNode *node)
 {
-    if(!node) return;
-    if(!nodes_.contains(node)) return;
-    for(auto *inlet : as_const(node->inlets()))
-        for(auto *conn : as_const(inlet->connections()))
-            removeConnection(conn);
-    for(auto *outlet : as_const(node->outlets()))
-        for(auto *conn : as_const(outlet->connections()))
-            removeConnection(conn);
     QObject::disconnect(node, &QDataflowModelNode::validChanged, this, &QDataflowModel::onValidChanged);
     QObject::disconnect(node, &QDataflowModelNode::posChanged, this, &QDataflowModel::onPosChanged);
     QObject::disconnect(node, &QDataflowModelNode::textChanged, this, &QDataflowModel::onTextChanged);
     QObject::disconnect(node, &QDataflowModelNode::inletCountChanged, this, &QDataflowModel::onInletCountChanged);
     QObject::disconnect(node, &QDataflowModelNode::outletCountChanged, this, &QDataflowModel::onOutletCountChanged);
-    nodes_.remove(node);
-    Q_EMIT nodeRemoved(node);
+    QObject::disconnect(node, &QDataflowModelNode::inletTypesChanged, this, &QDataflowModel::onInletTypesChanged);
+    QObject::disconnect(node, &QDataflowModelNode::outletTypesChanged, this, &QDataflowModel::onOutletTypesChanged);
+}
+
+void QDataflowModel::remove(QDataflowModelNode *node)
+{
+    if(!node) return;
+    const int id = node->id_;
+    if(!graph_.containsNode(id) || findNode(id) != node) return;
+    undoLog_.beginCommand();
+    // removeConnection() sees every connection, which gets its object
+    // first if it had none
+    QVector<QDataflowGraph::EdgeId> edges;
+    for(QDataflowGraph::EdgeId e : graph_.inEdges(id)) edges.push_back(e);
+    for(QDataflowGraph::EdgeId e : graph_.outEdges(id)) edges.push_back(e);
+    for(QDataflowGraph::EdgeId e : as_const(edges))
+        removeConnection(connectionById(e));
+    disconnectNodeSignals(node);
+    undoLog_.recordRemove(id);
+    // the object holds on to the state the graph drops
+    node->valid_ = graph_.isValid(id);
+    node->pos_ = graph_.pos(id);
+    node->text_ = graph_.text(id);
+    graph_.removeNode(id);
+    analysis_.removeNode(id);
+    node->id_ = QDataflowGraph::InvalidId;
+    if(transactionDepth_) recordNodeRemoved(node);
+    else Q_EMIT nodeRemoved(node);
+    undoLog_.endCommand();
 }
 
 QDataflowModelConnection * QDataflowModel::connect(QDataflowModelConnection *conn)
@@ -80,9 +238,15 @@ QDataflowModelConnection * QDataflowModel::connect(QDataflowModelConnection *con
 QDataflowModelConnection * QDataflowModel::connect(QDataflowModelNode *sourceNode, int sourceOutlet, QDataflowModelNode *destNode, int destInlet)
 {
     if(!sourceNode || !destNode) return {};
+    if(!sourceNode->outlet(sourceOutlet) || !destNode->inlet(destInlet)) return {};
     if(!findConnections(sourceNode, sourceOutlet, destNode, destInlet).isEmpty()) return {};
     QDataflowModelConnection *conn = newConnection(sourceNode, sourceOutlet, destNode, destInlet);
     addConnection(conn);
+    if(conn->id_ == QDataflowGraph::InvalidId)
+    {
+        delete conn;
+        return {};
+    }
     return conn;
 }
 
@@ -106,12 +270,259 @@ void QDataflowModel::disconnect(QDataflowModelNode *sourceNode, int sourceOutlet
 
 QSet<QDataflowModelNode*> QDataflowModel::nodes()
 {
-    return nodes_;
+    QSet<QDataflowModelNode*> ret;
+    ret.reserve(graph_.nodeCount());
+    for(int id = 0; id < graph_.nodeIdBound(); id++)
+        if(QDataflowModelNode *node = nodeById(id))
+            ret.insert(node);
+    return ret;
 }
 
 QSet<QDataflowModelConnection*> QDataflowModel::connections()
 {
-    return connections_;
+    QSet<QDataflowModelConnection*> ret;
+    ret.reserve(graph_.edgeCount());
+    for(int id = 0; id < graph_.edgeIdBound(); id++)
+        if(QDataflowModelConnection *conn = connectionById(id))
+            ret.insert(conn);
+    return ret;
+}
+
+void QDataflowModel::reserve(int nodeCount, int connectionCount)
+{
+    graph_.reserve(graph_.nodeIdBound() + nodeCount, graph_.edgeIdBound() + connectionCount);
+    analysis_.reserve(graph_.nodeIdBound() + nodeCount);
+    QMutexLocker locker(&handlesMutex_);
+    nodesById_.reserve(graph_.nodeIdBound() + nodeCount);
+    connectionsById_.reserve(graph_.edgeIdBound() + connectionCount);
+}
+
+const QDataflowGraph & QDataflowModel::graph() const
+{
+    return graph_;
+}
+
+QDataflowTypeRegistry * QDataflowModel::typeRegistry()
+{
+    return &graph_.types();
+}
+
+const QDataflowGraphAnalysis & QDataflowModel::analysis() const
+{
+    return analysis_;
+}
+
+bool QDataflowModel::rejectsCycles() const
+{
+    return rejectCycles_;
+}
+
+void QDataflowModel::setRejectCycles(bool reject)
+{
+    rejectCycles_ = reject;
+}
+
+QDataflowModelNode * QDataflowModel::nodeById(int id) const
+{
+    if(!graph_.containsNode(id)) return {};
+    QMutexLocker locker(&handlesMutex_);
+    return const_cast<QDataflowModel*>(this)->nodeHandle(id);
+}
+
+QDataflowModelConnection * QDataflowModel::connectionById(int id) const
+{
+    if(!graph_.containsEdge(id)) return {};
+    QMutexLocker locker(&handlesMutex_);
+    return const_cast<QDataflowModel*>(this)->connectionHandle(id);
+}
+
+QDataflowModelNode * QDataflowModel::findNode(int id) const
+{
+    if(!graph_.containsNode(id)) return {};
+    QMutexLocker locker(&handlesMutex_);
+    return nodesById_[id];
+}
+
+QDataflowModelConnection * QDataflowModel::findConnection(int id) const
+{
+    if(!graph_.containsEdge(id)) return {};
+    QMutexLocker locker(&handlesMutex_);
+    return connectionsById_[id];
+}
+
+QDataflowModelNode * QDataflowModel::nodeHandle(int id)
+{
+    QDataflowModelNode *&node = nodesById_[id];
+    if(node) return node;
+
+    QStringList inletTypes, outletTypes;
+    for(int i = 0; i < graph_.inletCount(id); i++)
+        inletTypes << graph_.typeName(graph_.inletType(id, i));
+    for(int i = 0; i < graph_.outletCount(id); i++)
+        outletTypes << graph_.typeName(graph_.outletType(id, i));
+    QDataflowModelNode *created = newNode(graph_.pos(id), graph_.text(id), inletTypes, outletTypes);
+    // it lives with the model, whichever thread asked for it first
+    if(created->thread() != thread())
+        created->moveToThread(thread());
+    created->id_ = created->lastId_ = id;
+    created->text_.clear();
+    connectNodeSignals(created);
+    for(auto *factory : as_const(factories_))
+        factory->attach(created);
+    node = created;
+    return node;
+}
+
+QDataflowModelConnection * QDataflowModel::connectionHandle(int id)
+{
+    QDataflowModelConnection *&conn = connectionsById_[id];
+    if(conn) return conn;
+
+    QDataflowModelConnection *created = newConnection(nodeHandle(graph_.edgeSource(id)), graph_.edgeOutlet(id), nodeHandle(graph_.edgeDest(id)), graph_.edgeInlet(id));
+    if(created->thread() != thread())
+        created->moveToThread(thread());
+    created->id_ = created->lastId_ = id;
+    conn = created;
+    return conn;
+}
+
+void QDataflowModel::setNodeValid(int id, bool valid)
+{
+    graph_.setValid(id, valid);
+}
+
+void QDataflowModel::setNodeIOletTypes(int id, const QStringList &inletTypes, const QStringList &outletTypes)
+{
+    // only for nodes without connections, which no type change can break
+    undoLog_.beginIoletChange(id);
+    graph_.setInletTypes(id, internTypes(inletTypes));
+    graph_.setOutletTypes(id, internTypes(outletTypes));
+    undoLog_.endIoletChange(id);
+}
+
+void QDataflowModel::beginTransaction()
+{
+    transactionDepth_++;
+    undoLog_.beginCommand();
+}
+
+void QDataflowModel::commitTransaction()
+{
+    if(transactionDepth_ <= 0) return;
+    if(--transactionDepth_ > 0)
+    {
+        undoLog_.endCommand();
+        return;
+    }
+
+    QDataflowModelChangeSet changes;
+    std::swap(changes, pendingChanges_);
+    pendingAddedNodes_.clear();
+    pendingAddedConnections_.clear();
+    // the ids still pending are the ones that were not removed again
+    auto pending = [](const QSet<int> &ids, QVector<int> &added)
+    {
+        added.erase(std::remove_if(added.begin(), added.end(), [&ids](int id) {return !ids.contains(id);}), added.end());
+    };
+    pending(pendingAddedNodeIds_, changes.addedNodeIds);
+    pending(pendingAddedConnectionIds_, changes.addedConnectionIds);
+    pendingAddedNodeIds_.clear();
+    pendingAddedConnectionIds_.clear();
+
+    if(!changes.isEmpty())
+        Q_EMIT transactionCommitted(changes);
+    undoLog_.endCommand();
+}
+
+bool QDataflowModel::isInTransaction() const
+{
+    return transactionDepth_ > 0;
+}
+
+bool QDataflowModel::isDispatchCompiled() const
+{
+    return dispatchCompiled_;
+}
+
+void QDataflowModel::setDispatchCompiled(bool compiled)
+{
+    dispatchCompiled_ = compiled;
+}
+
+QDataflowProfiler * QDataflowModel::profiler()
+{
+    return &profiler_;
+}
+
+QDataflowUndoLog * QDataflowModel::undoLog()
+{
+    return &undoLog_;
+}
+
+QDataflowScheduler * QDataflowModel::scheduler() const
+{
+    return scheduler_;
+}
+
+void QDataflowModel::setScheduler(QDataflowScheduler *scheduler)
+{
+    if(scheduler_)
+        scheduler_->waitForIdle();
+    scheduler_ = scheduler;
+}
+
+void QDataflowModel::recordNodeAdded(QDataflowModelNode *node)
+{
+    pendingChanges_.addedNodes.push_back(node);
+    pendingAddedNodes_.insert(node);
+}
+
+void QDataflowModel::recordNodeRemoved(QDataflowModelNode *node)
+{
+    pendingChanges_.changedNodes.remove(node);
+    if(pendingAddedNodeIds_.remove(node->lastId_)) return;
+    if(pendingAddedNodes_.remove(node))
+        pendingChanges_.addedNodes.removeOne(node);
+    else
+        pendingChanges_.removedNodes.push_back(node);
+}
+
+void QDataflowModel::recordNodeChange(QDataflowModelNode *node, QDataflowModelChangeSet::NodeChange change)
+{
+    // nodes added in this transaction will be picked up in their final state
+    if(pendingAddedNodes_.contains(node) || pendingAddedNodeIds_.contains(node->id_)) return;
+    pendingChanges_.changedNodes[node] |= change;
+}
+
+void QDataflowModel::recordConnectionAdded(QDataflowModelConnection *conn)
+{
+    pendingChanges_.addedConnections.push_back(conn);
+    pendingAddedConnections_.insert(conn);
+}
+
+void QDataflowModel::recordConnectionRemoved(QDataflowModelConnection *conn)
+{
+    if(pendingAddedConnectionIds_.remove(conn->lastId_)) return;
+    if(pendingAddedConnections_.remove(conn))
+        pendingChanges_.addedConnections.removeOne(conn);
+    else
+        pendingChanges_.removedConnections.push_back(conn);
+}
+
+void QDataflowModel::updateGraphIOlets(QDataflowModelNode *node)
+{
+    if(node->id_ == QDataflowGraph::InvalidId) return;
+
+    QVector<QDataflowGraph::TypeId> types;
+    types.reserve(qMax(node->inletCount(), node->outletCount()));
+    for(auto *inlet : as_const(node->inlets_))
+        types.push_back(inlet->typeId());
+    graph_.setInletTypes(node->id_, types);
+
+    types.clear();
+    for(auto *outlet : as_const(node->outlets_))
+        types.push_back(outlet->typeId());
+    graph_.setOutletTypes(node->id_, types);
 }
 
 void QDataflowModel::addConnection(QDataflowModelConnection *conn)
@@ -123,21 +534,43 @@ void QDataflowModel::addConnection(QDataflowModelConnection *conn)
         qDebug() << "cannoct connect outlet" << conn->source() << "to inlet" << conn->dest();
         return;
     }
-    conn->setParent(this);
-    connections_.insert(conn);
-    conn->source()->addConnection(conn);
-    conn->dest()->addConnection(conn);
-    Q_EMIT connectionAdded(conn);
+    const QDataflowGraph::NodeId sourceId = conn->source()->node()->id(), destId = conn->dest()->node()->id();
+    if(findNode(sourceId) != conn->source()->node() || findNode(destId) != conn->dest()->node()) return;
+    if(rejectCycles_ && analysis_.wouldCreateCycle(sourceId, destId))
+    {
+        qDebug() << "connecting outlet" << conn->source() << "to inlet" << conn->dest() << "would create a cycle";
+        return;
+    }
+    conn->model_ = this;
+    const int previousId = conn->lastId_;
+    conn->id_ = conn->lastId_ = graph_.addEdge(sourceId, conn->source()->index(), destId, conn->dest()->index());
+    analysis_.addEdge(sourceId, destId);
+    {
+        QMutexLocker locker(&handlesMutex_);
+        connectionsById_.resize(graph_.edgeIdBound());
+        if(previousId != QDataflowGraph::InvalidId && connectionsById_[previousId] == conn)
+            connectionsById_[previousId] = nullptr;
+        connectionsById_[conn->id_] = conn;
+    }
+    conn->source()->invalidateDispatchTable();
+    undoLog_.recordConnect(sourceId, conn->source()->index(), destId, conn->dest()->index());
+    if(transactionDepth_) recordConnectionAdded(conn);
+    else Q_EMIT connectionAdded(conn);
 }
 
 void QDataflowModel::removeConnection(QDataflowModelConnection *conn)
 {
     if(!conn) return;
-    if(!connections_.contains(conn)) return;
-    conn->source()->removeConnection(conn);
-    conn->dest()->removeConnection(conn);
-    connections_.remove(conn);
-    Q_EMIT connectionRemoved(conn);
+    const int id = conn->id_;
+    if(findConnection(id) != conn) return;
+    const QDataflowGraph::NodeId sourceId = graph_.edgeSource(id), destId = graph_.edgeDest(id);
+    undoLog_.recordDisconnect(sourceId, graph_.edgeOutlet(id), destId, graph_.edgeInlet(id));
+    graph_.removeEdge(id);
+    analysis_.removeEdge(sourceId, destId);
+    conn->source()->invalidateDispatchTable();
+    conn->id_ = QDataflowGraph::InvalidId;
+    if(transactionDepth_) recordConnectionRemoved(conn);
+    else Q_EMIT connectionRemoved(conn);
 }
 
 QList<QDataflowModelConnection*> QDataflowModel::findConnections(QDataflowModelConnection *conn) const
@@ -156,93 +589,171 @@ QList<QDataflowModelConnection*> QDataflowModel::findConnections(QDataflowModelN
 {
     if(!sourceNode || !destNode) return QList<QDataflowModelConnection*>();
     QList<QDataflowModelConnection*> ret;
-    for(auto *conn : as_const(connections_))
-    {
-        QDataflowModelOutlet *src = conn->source();
-        QDataflowModelInlet *dst = conn->dest();
-        if(src->node() == sourceNode && src->index() == sourceOutlet && dst->node() == destNode && dst->index() == destInlet)
-            ret.push_back(conn);
-    }
+    QDataflowModelOutlet *source = sourceNode->outlet(sourceOutlet);
+    QDataflowModelInlet *dest = destNode->inlet(destInlet);
+    if(!source || !dest) return ret;
+    if(QDataflowModelConnection *conn = source->connection(dest))
+        ret.push_back(conn);
     return ret;
 }
 
 void QDataflowModel::onValidChanged(bool valid)
 {
-    if(QDataflowModelNode *node = dynamic_cast<QDataflowModelNode*>(sender()))
-        Q_EMIT nodeValidChanged(node, valid);
+    if(QDataflowModelNode *node = qobject_cast<QDataflowModelNode*>(sender()))
+    {
+        if(transactionDepth_) recordNodeChange(node, QDataflowModelChangeSet::ValidChanged);
+        else Q_EMIT nodeValidChanged(node, valid);
+    }
 }
 
 void QDataflowModel::onPosChanged(const QPoint &pos)
 {
-    if(QDataflowModelNode *node = dynamic_cast<QDataflowModelNode*>(sender()))
-        Q_EMIT nodePosChanged(node, pos);
+    if(QDataflowModelNode *node = qobject_cast<QDataflowModelNode*>(sender()))
+    {
+        if(transactionDepth_) recordNodeChange(node, QDataflowModelChangeSet::PosChanged);
+        else Q_EMIT nodePosChanged(node, pos);
+    }
 }
 
 void QDataflowModel::onTextChanged(const QString &text)
 {
-    if(QDataflowModelNode *node = dynamic_cast<QDataflowModelNode*>(sender()))
-        Q_EMIT nodeTextChanged(node, text);
+    if(QDataflowModelNode *node = qobject_cast<QDataflowModelNode*>(sender()))
+    {
+        if(transactionDepth_) recordNodeChange(node, QDataflowModelChangeSet::TextChanged);
+        else Q_EMIT nodeTextChanged(node, text);
+    }
 }
 
 void QDataflowModel::onInletCountChanged(int count)
 {
-    if(QDataflowModelNode *node = dynamic_cast<QDataflowModelNode*>(sender()))
-        Q_EMIT nodeInletCountChanged(node, count);
+    if(QDataflowModelNode *node = qobject_cast<QDataflowModelNode*>(sender()))
+    {
+        if(transactionDepth_) recordNodeChange(node, QDataflowModelChangeSet::InletCountChanged);
+        else Q_EMIT nodeInletCountChanged(node, count);
+    }
 }
 
 void QDataflowModel::onOutletCountChanged(int count)
 {
-    if(QDataflowModelNode *node = dynamic_cast<QDataflowModelNode*>(sender()))
-        Q_EMIT nodeOutletCountChanged(node, count);
+    if(QDataflowModelNode *node = qobject_cast<QDataflowModelNode*>(sender()))
+    {
+        if(transactionDepth_) recordNodeChange(node, QDataflowModelChangeSet::OutletCountChanged);
+        else Q_EMIT nodeOutletCountChanged(node, count);
+    }
+}
+
+void QDataflowModel::onInletTypesChanged()
+{
+    if(QDataflowModelNode *node = qobject_cast<QDataflowModelNode*>(sender()))
+    {
+        if(transactionDepth_) recordNodeChange(node, QDataflowModelChangeSet::InletTypesChanged);
+        else Q_EMIT nodeInletTypesChanged(node);
+    }
+}
+
+void QDataflowModel::onOutletTypesChanged()
+{
+    if(QDataflowModelNode *node = qobject_cast<QDataflowModelNode*>(sender()))
+    {
+        if(transactionDepth_) recordNodeChange(node, QDataflowModelChangeSet::OutletTypesChanged);
+        else Q_EMIT nodeOutletTypesChanged(node);
+    }
 }
 
 QDataflowModelNode::QDataflowModelNode(QDataflowModel *parent, const QPoint &pos, const QString &text, int inletCount, int outletCount)
-    : QObject(parent), valid_(false), pos_(pos), text_(text), dataflowMetaObject_()
+    : model_(parent), id_(QDataflowGraph::InvalidId), lastId_(QDataflowGraph::InvalidId), valid_(false), pos_(pos), text_(text), dataflowMetaObject_(nullptr), factory_(nullptr)
 {
     for(int i = 0; i < inletCount; i++) addInlet();
     for(int i = 0; i < outletCount; i++) addOutlet();
 }
 
 QDataflowModelNode::QDataflowModelNode(QDataflowModel *parent, const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes)
-    : QObject(parent), valid_(false), pos_(pos), text_(text), dataflowMetaObject_()
+    : model_(parent), id_(QDataflowGraph::InvalidId), lastId_(QDataflowGraph::InvalidId), valid_(false), pos_(pos), text_(text), dataflowMetaObject_(nullptr), factory_(nullptr)
+{
+    for(auto &inletType : inletTypes) addInlet({}, inletType);
+    for(auto &outletType : outletTypes) addOutlet({}, outletType);
+}
+
+QDataflowModelNode::~QDataflowModelNode()
 {
-    for(auto &inletType : inletTypes) addInlet(inletType);
-    for(auto &outletType : outletTypes) addOutlet(outletType);
+    delete dataflowMetaObject_.exchange(nullptr);
 }
 
 QDataflowModel * QDataflowModelNode::model()
 {
-    return static_cast<QDataflowModel*>(parent());
+    return model_;
+}
+
+int QDataflowModelNode::id() const
+{
+    return id_;
 }
 
 QDataflowMetaObject * QDataflowModelNode::dataflowMetaObject() const
 {
-    return dataflowMetaObject_;
+    QDataflowMetaObject *mo = dataflowMetaObject_.load(std::memory_order_acquire);
+    if(!mo)
+        if(QDataflowNodeFactory *factory = factory_.load(std::memory_order_acquire))
+            mo = factory->instantiate(const_cast<QDataflowModelNode*>(this));
+    return mo;
 }
 
 void QDataflowModelNode::setDataflowMetaObject(QDataflowMetaObject *dataflowMetaObject)
 {
-    if(dataflowMetaObject_)
-        delete dataflowMetaObject_;
+    // no longer created on demand
+    factory_ = nullptr;
+
+    // the old meta object may still have messages in flight
+    if(QDataflowScheduler *scheduler = model_->scheduler())
+        scheduler->waitForIdle();
+
+    if(dataflowMetaObject)
+        dataflowMetaObject->node_ = this;
 
-    dataflowMetaObject_ = dataflowMetaObject;
+    delete dataflowMetaObject_.exchange(dataflowMetaObject);
 
-    if(dataflowMetaObject_)
-        dataflowMetaObject_->node_ = this;
+    // dispatch tables feeding this node hold on to the old meta object
+    invalidateUpstreamDispatchTables();
+}
+
+void QDataflowModelNode::beginIoletChange()
+{
+    if(id_ != QDataflowGraph::InvalidId) model_->undoLog_.beginIoletChange(id_);
+}
+
+void QDataflowModelNode::endIoletChange()
+{
+    // the graph gets the new iolet types before the undo log reads them
+    if(id_ == QDataflowGraph::InvalidId) return;
+    model_->updateGraphIOlets(this);
+    model_->undoLog_.endIoletChange(id_);
+}
+
+void QDataflowModelNode::invalidateUpstreamDispatchTables()
+{
+    // senders without an object have no table yet
+    if(id_ == QDataflowGraph::InvalidId) return;
+    const QDataflowGraph &graph = model_->graph_;
+    for(QDataflowGraph::EdgeId e : graph.inEdges(id_))
+        if(QDataflowModelNode *source = model_->findNode(graph.edgeSource(e)))
+            source->outlet(graph.edgeOutlet(e))->invalidateDispatchTable();
 }
 
 bool QDataflowModelNode::isValid() const
 {
+    if(id_ != QDataflowGraph::InvalidId) return model_->graph_.isValid(id_);
     return valid_;
 }
 
 QPoint QDataflowModelNode::pos() const
 {
+    if(id_ != QDataflowGraph::InvalidId) return model_->graph_.pos(id_);
     return pos_;
 }
 
 QString QDataflowModelNode::text() const
 {
+    if(id_ != QDataflowGraph::InvalidId) return model_->graph_.text(id_);
     return text_;
 }
 
@@ -284,23 +795,47 @@ int QDataflowModelNode::outletCount() const
 
 void QDataflowModelNode::setValid(bool valid)
 {
-    if(valid_ == valid) return;
-    valid_ = valid;
+    if(isValid() == valid) return;
+    if(id_ != QDataflowGraph::InvalidId) model_->graph_.setValid(id_, valid);
+    else valid_ = valid;
     Q_EMIT validChanged(valid);
 }
 
 void QDataflowModelNode::setPos(const QPoint &pos)
 {
-    if(pos_ == pos) return;
-    pos_ = pos;
+    const QPoint old = this->pos();
+    if(old == pos) return;
+    if(id_ != QDataflowGraph::InvalidId)
+    {
+        model_->undoLog_.recordMove(id_, old, pos);
+        model_->graph_.setPos(id_, pos);
+    }
+    else
+    {
+        pos_ = pos;
+    }
     Q_EMIT posChanged(pos);
 }
 
 void QDataflowModelNode::setText(const QString &text)
 {
-    if(text_ == text) return;
-    text_ = text;
+    const QString old = this->text();
+    if(old == text) return;
+    // the new node class may change the iolets and drop connections;
+    // undoing the edit has to bring them back with the text
+    const bool recorded = id_ != QDataflowGraph::InvalidId;
+    if(recorded)
+    {
+        model_->undoLog_.beginCommand();
+        model_->undoLog_.recordText(id_, old, text);
+        model_->graph_.setText(id_, text);
+    }
+    else
+    {
+        text_ = text;
+    }
     Q_EMIT textChanged(text);
+    if(recorded) model_->undoLog_.endCommand();
 }
 
 void QDataflowModelNode::addInlet(const QString &name, const QString &type)
@@ -311,16 +846,19 @@ void QDataflowModelNode::addInlet(const QString &name, const QString &type)
 void QDataflowModelNode::removeLastInlet()
 {
     if(inlets_.isEmpty()) return;
+    beginIoletChange();
     QDataflowModelInlet *inlet = inlets_.back();
     for(auto *conn : as_const(inlet->connections()))
-        model()->disconnect(conn);
+        model_->disconnect(conn);
     inlets_.pop_back();
+    endIoletChange();
     Q_EMIT inletCountChanged(inletCount());
 }
 
 void QDataflowModelNode::setInletCount(int count)
 {
     if(inletCount() == count) return;
+    beginIoletChange();
 
     bool shouldBlockSignals = blockSignals(true);
 
@@ -331,6 +869,7 @@ void QDataflowModelNode::setInletCount(int count)
         removeLastInlet();
 
     blockSignals(shouldBlockSignals);
+    endIoletChange();
 
     Q_EMIT inletCountChanged(count);
 }
@@ -338,16 +877,38 @@ void QDataflowModelNode::setInletCount(int count)
 void QDataflowModelNode::setInletTypes(const QStringList &types)
 {
     int oldCount = inletCount();
+    bool typesChanged = false;
+    beginIoletChange();
 
     bool shouldBlockSignals = blockSignals(true);
 
-    while(inletCount() > 0)
+    // inlets present in both lists are kept, with their connections;
+    // a changed type only drops the connections it no longer accepts
+    const int common = qMin(oldCount, types.size());
+    for(int i = 0; i < common; i++)
+    {
+        QDataflowModelInlet *inlet = inlets_[i];
+        if(inlet->type() == types[i]) continue;
+        inlet->setType(types[i]);
+        typesChanged = true;
+        for(auto *conn : as_const(inlet->connections()))
+        {
+            if(!conn->source()->canMakeConnectionTo(inlet) || !inlet->canAcceptConnectionFrom(conn->source()))
+                model_->disconnect(conn);
+        }
+    }
+
+    while(inletCount() > types.size())
         removeLastInlet();
 
-    for(auto &type : types)
-        addInlet({}, type);
+    for(int i = inletCount(); i < types.size(); i++)
+        addInlet({}, types[i]);
 
     blockSignals(shouldBlockSignals);
+    endIoletChange();
+
+    if(typesChanged)
+        Q_EMIT inletTypesChanged();
 
     int newCount = inletCount();
     if(oldCount != newCount)
@@ -375,16 +936,19 @@ void QDataflowModelNode::addOutlet(QString name, QString type)
 void QDataflowModelNode::removeLastOutlet()
 {
     if(outlets_.isEmpty()) return;
+    beginIoletChange();
     QDataflowModelOutlet *outlet = outlets_.back();
     for(auto *conn : as_const(outlet->connections()))
-        model()->disconnect(conn);
+        model_->disconnect(conn);
     outlets_.pop_back();
+    endIoletChange();
     Q_EMIT outletCountChanged(outletCount());
 }
 
 void QDataflowModelNode::setOutletCount(int count)
 {
     if(outletCount() == count) return;
+    beginIoletChange();
 
     bool shouldBlockSignals = blockSignals(true);
 
@@ -395,6 +959,7 @@ void QDataflowModelNode::setOutletCount(int count)
         removeLastOutlet();
 
     blockSignals(shouldBlockSignals);
+    endIoletChange();
 
     Q_EMIT outletCountChanged(count);
 }
@@ -402,16 +967,36 @@ void QDataflowModelNode::setOutletCount(int count)
 void QDataflowModelNode::setOutletTypes(const QStringList &types)
 {
     int oldCount = outletCount();
+    bool typesChanged = false;
+    beginIoletChange();
 
     bool shouldBlockSignals = blockSignals(true);
 
-    while(outletCount() > 0)
+    const int common = qMin(oldCount, types.size());
+    for(int i = 0; i < common; i++)
+    {
+        QDataflowModelOutlet *outlet = outlets_[i];
+        if(outlet->type() == types[i]) continue;
+        outlet->setType(types[i]);
+        typesChanged = true;
+        for(auto *conn : as_const(outlet->connections()))
+        {
+            if(!outlet->canMakeConnectionTo(conn->dest()) || !conn->dest()->canAcceptConnectionFrom(outlet))
+                model_->disconnect(conn);
+        }
+    }
+
+    while(outletCount() > types.size())
         removeLastOutlet();
 
-    for(auto &type : types)
-        addOutlet({}, type);
+    for(int i = outletCount(); i < types.size(); i++)
+        addOutlet({}, types[i]);
 
     blockSignals(shouldBlockSignals);
+    endIoletChange();
+
+    if(typesChanged)
+        Q_EMIT outletTypesChanged();
 
     int newCount = outletCount();
     if(oldCount != newCount)
@@ -434,16 +1019,20 @@ void QDataflowModelNode::setOutletTypes(std::initializer_list<const char *> type
 void QDataflowModelNode::addInlet(QDataflowModelInlet *inlet)
 {
     if(!inlet) return;
+    beginIoletChange();
     inlet->setParent(this);
     inlets_.append(inlet);
+    endIoletChange();
     Q_EMIT inletCountChanged(inletCount());
 }
 
 void QDataflowModelNode::addOutlet(QDataflowModelOutlet *outlet)
 {
     if(!outlet) return;
+    beginIoletChange();
     outlet->setParent(this);
     outlets_.append(outlet);
+    endIoletChange();
     Q_EMIT outletCountChanged(outletCount());
 }
 
@@ -452,7 +1041,7 @@ QDebug operator<<(QDebug debug, const QDataflowModelNode &node)
     QDebugStateSaver stateSaver(debug);
     debug.nospace() << "QDataflowModelNode";
     debug.nospace() << "(" << reinterpret_cast<const void*>(&node) <<
-                       ", text=" << node.text() << ")";
+                       ", id=" << node.id() << ", text=" << node.text() << ")";
     return debug;
 }
 
@@ -462,9 +1051,14 @@ QDebug operator<<(QDebug debug, const QDataflowModelNode *node)
 }
 
 QDataflowModelIOlet::QDataflowModelIOlet(QDataflowModelNode *parent, int index, const QString &name, const QString &type)
-    : QObject(parent), node_(parent), index_(index), name_(name), type_(type)
+    : QObject(parent), node_(parent), index_(index), inlet_(false), name_(name), type_(type), typeId_(QDataflowGraph::InvalidId)
 {
-
+    // iolets of the same type share the model's copy of the string
+    if(QDataflowModel *model = node_ ? node_->model() : nullptr)
+    {
+        typeId_ = model->graph_.internType(type);
+        type_ = model->graph_.typeName(typeId_);
+    }
 }
 
 QDataflowModel * QDataflowModelIOlet::model()
@@ -487,29 +1081,82 @@ QString QDataflowModelIOlet::type() const
     return type_;
 }
 
-void QDataflowModelIOlet::addConnection(QDataflowModelConnection *conn)
+int QDataflowModelIOlet::typeId() const
 {
-    connections_.push_back(conn);
+    return typeId_;
 }
 
-void QDataflowModelIOlet::removeConnection(QDataflowModelConnection *conn)
+void QDataflowModelIOlet::setType(const QString &type)
 {
-    connections_.removeAll(conn);
+    type_ = type;
+    if(QDataflowModel *model = node_ ? node_->model() : nullptr)
+    {
+        typeId_ = model->graph_.internType(type);
+        type_ = model->graph_.typeName(typeId_);
+    }
 }
 
 QList<QDataflowModelConnection*> QDataflowModelIOlet::connections() const
 {
-    return connections_;
+    QList<QDataflowModelConnection*> ret;
+    const int node = node_ ? node_->id_ : QDataflowGraph::InvalidId;
+    if(node == QDataflowGraph::InvalidId) return ret;
+    QDataflowModel *model = node_->model_;
+    const QDataflowGraph &graph = model->graph_;
+    if(inlet_)
+    {
+        for(QDataflowGraph::EdgeId e : graph.inEdges(node))
+            if(graph.edgeInlet(e) == index_) ret.push_back(model->connectionById(e));
+    }
+    else
+    {
+        for(QDataflowGraph::EdgeId e : graph.outEdges(node))
+            if(graph.edgeOutlet(e) == index_) ret.push_back(model->connectionById(e));
+    }
+    return ret;
+}
+
+QDataflowModelConnection * QDataflowModelIOlet::connection(QDataflowModelIOlet *peer) const
+{
+    if(!peer || peer->inlet_ == inlet_ || !node_ || !peer->node_ || node_->model_ != peer->node_->model_) return {};
+    const QDataflowModelIOlet *source = inlet_ ? peer : this, *dest = inlet_ ? this : peer;
+    QDataflowModel *model = node_->model_;
+    return model->connectionById(model->graph_.findEdge(source->node_->id_, source->index_, dest->node_->id_, dest->index_));
 }
 
 QDataflowModelInlet::QDataflowModelInlet(QDataflowModelNode *parent, int index, const QString &name, const QString &type)
-    : QDataflowModelIOlet(parent, index, name, type)
+    : QDataflowModelIOlet(parent, index, name, type), queue_(nullptr)
+{
+    inlet_ = true;
+}
+
+QDataflowModelInlet::~QDataflowModelInlet()
 {
+    delete queue_;
+}
+
+void QDataflowModelInlet::setQueue(int capacity, QDataflowInletQueue::Policy policy)
+{
+    if(capacity < 1)
+    {
+        qWarning() << "invalid queue capacity" << capacity << "for inlet" << this;
+        return;
+    }
+    delete queue_;
+    queue_ = new QDataflowInletQueue(capacity, policy);
+}
 
+void QDataflowModelInlet::clearQueue()
+{
+    delete queue_;
+    queue_ = nullptr;
 }
 
 bool QDataflowModelInlet::canAcceptConnectionFrom(QDataflowModelOutlet *outlet)
 {
+    if(QDataflowModel *mdl = model())
+        if(outlet->model() == mdl)
+            return mdl->typeRegistry()->isCompatible(outlet->typeId(), typeId());
     if(type() == "*") return true;
     return type() == outlet->type();
 }
@@ -529,17 +1176,107 @@ QDebug operator<<(QDebug debug, const QDataflowModelInlet *inlet)
 }
 
 QDataflowModelOutlet::QDataflowModelOutlet(QDataflowModelNode *parent, int index, const QString &name, const QString &type)
-    : QDataflowModelIOlet(parent, index, name, type)
+    : QDataflowModelIOlet(parent, index, name, type), dispatchTable_(nullptr), retiredDispatchTables_(nullptr), dispatchTableGeneration_(0)
 {
 
 }
 
+QDataflowModelOutlet::~QDataflowModelOutlet()
+{
+    delete dispatchTable_.load();
+    deleteDispatchTables(retiredDispatchTables_.load());
+}
+
 bool QDataflowModelOutlet::canMakeConnectionTo(QDataflowModelInlet *inlet)
 {
+    if(QDataflowModel *mdl = model())
+        if(inlet->model() == mdl)
+            return mdl->typeRegistry()->isCompatible(typeId(), inlet->typeId());
     if(inlet->type() == "*") return true;
     return type() == inlet->type();
 }
 
+QVector<QDataflowDispatchTarget> QDataflowModelOutlet::dispatchTable() const
+{
+    const quint64 orderGeneration = node()->model()->analysis().orderGeneration();
+    const DispatchTable *table = dispatchTable_.load(std::memory_order_acquire);
+    if(table && table->orderGeneration == orderGeneration) return table->targets;
+
+    QMutexLocker locker(&dispatchTableMutex_);
+    // another sender may have rebuilt it meanwhile
+    table = dispatchTable_.load(std::memory_order_acquire);
+    if(table && table->orderGeneration == orderGeneration) return table->targets;
+
+    const quint64 generation = dispatchTableGeneration_.load();
+    DispatchTable *built = new DispatchTable{buildDispatchTable(), orderGeneration, nullptr};
+    const QVector<QDataflowDispatchTarget> targets = built->targets;
+    // published only if nothing invalidated it meanwhile; the caller
+    // still uses it for this one message. Other senders may have loaded
+    // the table replaced, so it is only retired
+    if(generation == dispatchTableGeneration_.load() && dispatchTable_.compare_exchange_strong(table, built, std::memory_order_acq_rel))
+    {
+        if(table)
+        {
+            DispatchTable *retired = const_cast<DispatchTable*>(table);
+            retired->next = retiredDispatchTables_.load();
+            while(!retiredDispatchTables_.compare_exchange_weak(retired->next, retired)) {}
+        }
+    }
+    else
+    {
+        delete built;
+    }
+    return targets;
+}
+
+QVector<QDataflowDispatchTarget> QDataflowModelOutlet::buildDispatchTable() const
+{
+    QVector<QDataflowDispatchTarget> table;
+    QVector<int> order;
+    QDataflowModelNode *source = node();
+    QDataflowModel *model = source->model();
+    const QDataflowGraph &graph = model->graph();
+    const QDataflowGraphAnalysis &analysis = model->analysis();
+    for(QDataflowGraph::EdgeId e : graph.outEdges(source->id()))
+    {
+        if(graph.edgeOutlet(e) != index()) continue;
+        if(QDataflowMetaObject *mo = model->nodeById(graph.edgeDest(e))->dataflowMetaObject())
+        {
+            table.push_back({mo, graph.edgeInlet(e), e});
+            order.push_back(analysis.topologicalIndex(graph.edgeDest(e)));
+        }
+    }
+
+    // a receiver is reached before the ones it may forward to
+    QVector<int> positions(table.size());
+    for(int i = 0; i < positions.size(); i++) positions[i] = i;
+    std::stable_sort(positions.begin(), positions.end(), [&order](int a, int b) {return order[a] < order[b];});
+    QVector<QDataflowDispatchTarget> sorted;
+    sorted.reserve(table.size());
+    for(int i : as_const(positions))
+        sorted.push_back(table[i]);
+    return sorted;
+}
+
+void QDataflowModelOutlet::invalidateDispatchTable()
+{
+    // no sender holds on to the table: they copy the targets out, and
+    // the model is not edited while another thread sends
+    dispatchTableGeneration_++;
+    delete dispatchTable_.exchange(nullptr, std::memory_order_acq_rel);
+    deleteDispatchTables(retiredDispatchTables_.exchange(nullptr));
+}
+
+void QDataflowModelOutlet::deleteDispatchTables(const DispatchTable *table)
+{
+    while(table)
+    {
+        const DispatchTable *next = table->next;
+        delete table;
+        table = next;
+    }
+}
+
 QDebug operator<<(QDebug debug, const QDataflowModelOutlet &outlet)
 {
     QDebugStateSaver stateSaver(debug);
@@ -555,13 +1292,18 @@ QDebug operator<<(QDebug debug, const QDataflowModelOutlet *outlet)
 }
 
 QDataflowModelConnection::QDataflowModelConnection(QDataflowModel *parent, QDataflowModelOutlet *source, QDataflowModelInlet *dest)
-    : QObject(parent), source_(source), dest_(dest)
+    : model_(parent), id_(QDataflowGraph::InvalidId), lastId_(QDataflowGraph::InvalidId), source_(source), dest_(dest)
 {
 }
 
 QDataflowModel * QDataflowModelConnection::model()
 {
-    return static_cast<QDataflowModel*>(parent());
+    return model_;
+}
+
+int QDataflowModelConnection::id() const
+{
+    return id_;
 }
 
 QDataflowModelOutlet * QDataflowModelConnection::source() const
@@ -589,23 +1331,183 @@ QDebug operator<<(QDebug debug, const QDataflowModelConnection *conn)
 }
 
 QDataflowMetaObject::QDataflowMetaObject(QDataflowModelNode *node)
-    : node_(node)
+    : node_(node), blockProcessing_(false), scheduled_(false), sendOrder_(0)
 {
 }
 
-void QDataflowMetaObject::onDataReceved(int inlet, void *data)
+void QDataflowMetaObject::onDataReceved(int inlet, const QDataflowMessage &message)
 {
     Q_UNUSED(inlet);
-    Q_UNUSED(data);
+    Q_UNUSED(message);
 }
 
-void QDataflowMetaObject::sendData(int outletIndex, void *data)
+void QDataflowMetaObject::onBlockReceived(int inlet, const float *samples, int count)
 {
-    for(auto *conn : as_const(outlet(outletIndex)->connections()))
+    Q_UNUSED(inlet);
+    Q_UNUSED(samples);
+    Q_UNUSED(count);
+}
+
+bool QDataflowMetaObject::setArguments(const QStringList &args)
+{
+    Q_UNUSED(args);
+    return false;
+}
+
+void QDataflowMetaObject::process(int inlet, const QDataflowMessage &message)
+{
+    if(blockProcessing_ && message.type() == QDataflowMessage::Samples)
+        onBlockReceived(inlet, message.sampleData(), message.sampleCount());
+    else
+        onDataReceved(inlet, message);
+}
+
+void QDataflowMetaObject::receive(int inlet, const QDataflowMessage &message)
+{
+#ifndef QDATAFLOW_NO_PROFILING
+    QDataflowProfiler *profiler = node_->model()->profiler();
+    if(profiler->isEnabled())
     {
-        QDataflowMetaObject *mo = conn->dest()->node()->dataflowMetaObject();
-        if(mo)
-            mo->onDataReceved(conn->dest()->index(), data);
+        QDataflowProfiler::Scope scope(profiler, node_->id());
+        process(inlet, message);
+        return;
+    }
+#endif
+    process(inlet, message);
+}
+
+bool QDataflowMetaObject::takeMessage(QDataflowScheduledMessage &msg)
+{
+    // messages leave in the order they were sent, whichever inlet queue or
+    // the mailbox they are in. Seeing a message also makes everything its
+    // sender sent before visible, so the queues and the mailbox are looked
+    // at again until the oldest candidate stays the same
+    const int n = node_->inletCount();
+    if(staged_.size() < n) staged_.resize(n);
+    int best = -1;
+    quint64 bestOrder = 0;
+    for(;;)
+    {
+        bool queued = false;
+        int oldest = -1;
+        quint64 oldestOrder = 0;
+        for(int i = 0; i < n; i++)
+        {
+            QDataflowScheduledMessage &staged = staged_[i];
+            if(QDataflowInletQueue *queue = node_->inlet(i)->queue())
+            {
+                queued = true;
+                if(staged.inlet < 0 && queue->pop(staged.message, &staged.order))
+                    staged.inlet = i;
+            }
+            if(staged.inlet >= 0 && (oldest < 0 || staged.order < oldestOrder))
+            {
+                oldest = i;
+                oldestOrder = staged.order;
+            }
+        }
+        {
+            // index n stands for the mailbox
+            QMutexLocker locker(&mailboxMutex_);
+            if(!mailbox_.isEmpty() && (oldest < 0 || mailbox_.head().order < oldestOrder))
+            {
+                oldest = n;
+                oldestOrder = mailbox_.head().order;
+            }
+        }
+        if(oldest < 0) return false;
+        const bool settled = oldest == best && oldestOrder == bestOrder;
+        best = oldest;
+        bestOrder = oldestOrder;
+        if(!queued || settled) break;
+    }
+
+    if(best == n)
+    {
+        QMutexLocker locker(&mailboxMutex_);
+        if(mailbox_.isEmpty()) return false;
+        msg = mailbox_.dequeue();
+        return true;
+    }
+    msg = std::move(staged_[best]);
+    staged_[best].inlet = -1;
+    staged_[best].message = QDataflowMessage();
+    return true;
+}
+
+bool QDataflowMetaObject::hasMessages()
+{
+    for(const QDataflowScheduledMessage &staged : as_const(staged_))
+        if(staged.inlet >= 0) return true;
+    return hasIncomingMessages();
+}
+
+bool QDataflowMetaObject::hasIncomingMessages()
+{
+    for(int i = node_->inletCount() - 1; i >= 0; i--)
+    {
+        QDataflowInletQueue *queue = node_->inlet(i)->queue();
+        if(queue && !queue->isEmpty()) return true;
+    }
+
+    QMutexLocker locker(&mailboxMutex_);
+    return !mailbox_.isEmpty();
+}
+
+void QDataflowMetaObject::sendData(int outletIndex, const QDataflowMessage &message)
+{
+    QDataflowModelOutlet *o = outlet(outletIndex);
+    if(!o) return;
+
+    // built-in types compare by id rather than by name
+    if(!message.isCompatibleWith(o->typeId(), o->type()))
+    {
+        qWarning() << "cannot send" << message << "through outlet" << o;
+        return;
+    }
+
+    QDataflowModel *model = node_->model();
+    QDataflowScheduler *scheduler = model->scheduler();
+    QDataflowProfiler *profiler = model->profiler()->isEnabled() ? model->profiler() : nullptr;
+
+    auto deliver = [scheduler](QDataflowMetaObject *mo, int inlet, const QDataflowMessage &msg)
+    {
+        if(scheduler)
+            scheduler->post(mo, inlet, msg);
+        else
+            mo->receive(inlet, msg);
+    };
+
+    // all receivers share the message payload
+    if(model->isDispatchCompiled())
+    {
+        // a shallow copy keeps the table alive if a receiver edits the graph
+        const QVector<QDataflowDispatchTarget> targets = o->dispatchTable();
+        for(const QDataflowDispatchTarget &target : targets)
+        {
+            if(profiler) profiler->recordEdge(target.connection);
+            deliver(target.metaObject, target.inlet, message);
+        }
+        return;
+    }
+
+    // a receiver may edit the graph, so the edges are copied first; they
+    // are delivered in the compiled table's order
+    const QDataflowGraph &graph = model->graph();
+    const QDataflowGraphAnalysis &analysis = model->analysis();
+    QVector<QDataflowGraph::EdgeId> edges;
+    for(QDataflowGraph::EdgeId e : graph.outEdges(node_->id()))
+        if(graph.edgeOutlet(e) == outletIndex) edges.push_back(e);
+    std::stable_sort(edges.begin(), edges.end(), [&](QDataflowGraph::EdgeId a, QDataflowGraph::EdgeId b) {
+        return analysis.topologicalIndex(graph.edgeDest(a)) < analysis.topologicalIndex(graph.edgeDest(b));
+    });
+    for(QDataflowGraph::EdgeId e : as_const(edges))
+    {
+        if(!graph.containsEdge(e)) continue;
+        QDataflowMetaObject *mo = model->nodeById(graph.edgeDest(e))->dataflowMetaObject();
+        if(!mo) continue;
+        if(profiler) profiler->recordEdge(e);
+        deliver(mo, graph.edgeInlet(e), message);
     }
 }
 
@@ -618,8 +1520,11 @@ QDataflowModelDebugSignals::QDataflowModelDebugSignals(QDataflowModel *parent)
     QObject::connect(parent, &QDataflowModel::nodeTextChanged, this, &QDataflowModelDebugSignals::onNodeTextChanged);
     QObject::connect(parent, &QDataflowModel::nodeInletCountChanged, this, &QDataflowModelDebugSignals::onNodeInletCountChanged);
     QObject::connect(parent, &QDataflowModel::nodeOutletCountChanged, this, &QDataflowModelDebugSignals::onNodeOutletCountChanged);
+    QObject::connect(parent, &QDataflowModel::nodeInletTypesChanged, this, &QDataflowModelDebugSignals::onNodeInletTypesChanged);
+    QObject::connect(parent, &QDataflowModel::nodeOutletTypesChanged, this, &QDataflowModelDebugSignals::onNodeOutletTypesChanged);
     QObject::connect(parent, &QDataflowModel::connectionAdded, this, &QDataflowModelDebugSignals::onConnectionAdded);
     QObject::connect(parent, &QDataflowModel::connectionRemoved, this, &QDataflowModelDebugSignals::onConnectionRemoved);
+    QObject::connect(parent, &QDataflowModel::transactionCommitted, this, &QDataflowModelDebugSignals::onTransactionCommitted);
 }
 
 QDebug QDataflowModelDebugSignals::debug() const
@@ -657,6 +1562,16 @@ void QDataflowModelDebugSignals::onNodeOutletCountChanged(QDataflowModelNode *no
     debug() << "nodeOutletCountChanged" << node << count;
 }
 
+void QDataflowModelDebugSignals::onNodeInletTypesChanged(QDataflowModelNode *node)
+{
+    debug() << "nodeInletTypesChanged" << node;
+}
+
+void QDataflowModelDebugSignals::onNodeOutletTypesChanged(QDataflowModelNode *node)
+{
+    debug() << "nodeOutletTypesChanged" << node;
+}
+
 void QDataflowModelDebugSignals::onConnectionAdded(QDataflowModelConnection *conn)
 {
     debug() << "connectionAdded" << conn;
@@ -666,3 +1581,13 @@ void QDataflowModelDebugSignals::onConnectionRemoved(QDataflowModelConnection *c
 {
     debug() << "connectionRemoved" << conn;
 }
+
+void QDataflowModelDebugSignals::onTransactionCommitted(const QDataflowModelChangeSet &changes)
+{
+    debug() << "transactionCommitted"
+            << "addedNodes=" << changes.addedNodes.size()
+            << "removedNodes=" << changes.removedNodes.size()
+            << "addedConnections=" << changes.addedConnections.size()
+            << "removedConnections=" << changes.removedConnections.size()
+            << "changedNodes=" << changes.changedNodes.size();
+}
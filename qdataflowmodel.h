@@ -19,42 +19,151 @@
 #define QDATAFLOWMODEL_H
 
 #include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
 #include <QSet>
 #include <QList>
 #include <QPoint>
 #include <QString>
 #include <QStringList>
+#include <QVector>
 #include <QDebug>
+#include <atomic>
 #include <initializer_list>
 
+#include "qdataflowgraph.h"
+#include "qdataflowgraphanalysis.h"
+#include "qdataflowmessage.h"
+#include "qdataflowpool.h"
+#include "qdataflowprofiler.h"
+#include "qdataflowundolog.h"
+
 class QDataflowModelNode;
 class QDataflowModelIOlet;
 class QDataflowModelInlet;
 class QDataflowModelOutlet;
 class QDataflowModelConnection;
 class QDataflowMetaObject;
+class QDataflowNodeFactory;
+class QDataflowScheduler;
+
+struct QDataflowModelChangeSet
+{
+    enum NodeChange
+    {
+        ValidChanged = 0x01,
+        PosChanged = 0x02,
+        TextChanged = 0x04,
+        InletCountChanged = 0x08,
+        OutletCountChanged = 0x10,
+        InletTypesChanged = 0x20,
+        OutletTypesChanged = 0x40
+    };
+
+    QList<QDataflowModelNode*> addedNodes;
+    QList<QDataflowModelNode*> removedNodes;
+    QList<QDataflowModelConnection*> addedConnections;
+    QList<QDataflowModelConnection*> removedConnections;
+    // added by QDataflowModel::createNode() and connectNodes(), without
+    // objects; those removed again before the commit are left out
+    QVector<int> addedNodeIds;
+    QVector<int> addedConnectionIds;
+    // nodes that existed before the transaction, with a mask of NodeChange values;
+    // the new values are read back from the node itself
+    QHash<QDataflowModelNode*, int> changedNodes;
+
+    bool isEmpty() const;
+};
 
 class QDataflowModel : public QObject
 {
     Q_OBJECT
 public:
     explicit QDataflowModel(QObject *parent = {});
+    // deletes all node and connection objects, removed ones included, and
+    // hands the pools' memory back once no model is left using it
+    ~QDataflowModel() override;
 
 protected:
+    // also called by nodeById() and connectionById() for the nodes and
+    // connections that have no object yet, possibly on a worker thread
+    // building a dispatch table; they must not call back into the model
     virtual QDataflowModelNode * newNode(const QPoint &pos, const QString &text, int inletCount, int outletCount);
+    virtual QDataflowModelNode * newNode(const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes);
     virtual QDataflowModelConnection * newConnection(QDataflowModelNode *sourceNode, int sourceOutlet, QDataflowModelNode *destNode, int destInlet);
 
 public:
     virtual QDataflowModelNode * create(const QPoint &pos, const QString &text, int inletCount, int outletCount);
+    virtual QDataflowModelNode * create(const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes);
     virtual void remove(QDataflowModelNode *node);
     virtual QDataflowModelConnection * connect(QDataflowModelConnection *conn);
     virtual QDataflowModelConnection * connect(QDataflowModelNode *sourceNode, int sourceOutlet, QDataflowModelNode *destNode, int destInlet);
     virtual void disconnect(QDataflowModelConnection *conn);
     virtual void disconnect(QDataflowModelNode *sourceNode, int sourceOutlet, QDataflowModelNode *destNode, int destInlet);
 
+    // bulk insertion without objects, e.g. when loading a patch: the new
+    // node or connection is reported in transactionCommitted() by id and
+    // gets its object when nodeById() or connectionById() is first asked
+    // for it; connectNodes() does not go through addConnection(). Return
+    // the graph id, InvalidId when refused.
+    int createNode(const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes);
+    int connectNodes(int sourceNode, int sourceOutlet, int destNode, int destInlet);
+
+    // create the objects of all nodes and connections that have none;
+    // traversals should use graph() instead
     QSet<QDataflowModelNode*> nodes();
     QSet<QDataflowModelConnection*> connections();
 
+    // preallocates for bulk insertion, e.g. when loading a patch
+    void reserve(int nodeCount, int connectionCount);
+
+    // the structure and the node attributes; QDataflowModelNode::id() and
+    // QDataflowModelConnection::id() index into it
+    const QDataflowGraph & graph() const;
+    // the object of a node or connection of the model, created on first
+    // use and kept until the model is deleted; null for removed ids
+    QDataflowModelNode * nodeById(int id) const;
+    QDataflowModelConnection * connectionById(int id) const;
+
+    // iolet type ids and the rules for which types connect; rules added
+    // later do not affect existing connections
+    QDataflowTypeRegistry * typeRegistry();
+
+    // topological order, feedback loops and independent components of
+    // the node graph, kept up to date on every edit
+    const QDataflowGraphAnalysis & analysis() const;
+
+    // refuse connections that would close a feedback loop; without a
+    // scheduler, a loop makes sendData() recurse until the stack runs out
+    bool rejectsCycles() const;
+    void setRejectCycles(bool reject);
+
+    // while a transaction is open, the per-item signals are held back and
+    // transactionCommitted() is emitted once when the outermost one commits
+    void beginTransaction();
+    void commitTransaction();
+    bool isInTransaction() const;
+
+    // in compiled mode QDataflowMetaObject::sendData() walks a flat per-outlet
+    // table of (meta object, inlet) targets instead of the graph's edges.
+    // Either way the receivers get the message in topological order
+    bool isDispatchCompiled() const;
+    void setDispatchCompiled(bool compiled);
+
+    // when set, sendData() posts messages to the scheduler instead of
+    // calling onDataReceved() directly; the scheduler is not owned
+    QDataflowScheduler * scheduler() const;
+    void setScheduler(QDataflowScheduler *scheduler);
+
+    // per-node and per-connection message counts and handler times;
+    // disabled until profiler()->setEnabled(true)
+    QDataflowProfiler * profiler();
+
+    // coalesced undo/redo history of the edits, and the journal for
+    // incremental saves; disabled until undoLog()->setEnabled(true)
+    QDataflowUndoLog * undoLog();
+
 protected:
     virtual void addConnection(QDataflowModelConnection *conn);
     virtual void removeConnection(QDataflowModelConnection *conn);
@@ -70,8 +179,13 @@ Q_SIGNALS:
     void nodeTextChanged(QDataflowModelNode *node, const QString &text);
     void nodeInletCountChanged(QDataflowModelNode *node, int count);
     void nodeOutletCountChanged(QDataflowModelNode *node, int count);
+    // types of existing iolets changed in place; iolet identity and the
+    // connections that still type check are kept
+    void nodeInletTypesChanged(QDataflowModelNode *node);
+    void nodeOutletTypesChanged(QDataflowModelNode *node);
     void connectionAdded(QDataflowModelConnection *conn);
     void connectionRemoved(QDataflowModelConnection *conn);
+    void transactionCommitted(const QDataflowModelChangeSet &changes);
 
 private Q_SLOTS:
     virtual void onValidChanged(bool valid);
@@ -79,13 +193,70 @@ private Q_SLOTS:
     virtual void onTextChanged(const QString &text);
     virtual void onInletCountChanged(int count);
     virtual void onOutletCountChanged(int count);
+    virtual void onInletTypesChanged();
+    virtual void onOutletTypesChanged();
+
+private:
+    // the object of a node or connection, if it has one; no handle is created
+    QDataflowModelNode * findNode(int id) const;
+    QDataflowModelConnection * findConnection(int id) const;
+    // with handlesMutex_ held
+    QDataflowModelNode * nodeHandle(int id);
+    QDataflowModelConnection * connectionHandle(int id);
+    void connectNodeSignals(QDataflowModelNode *node);
+    void disconnectNodeSignals(QDataflowModelNode *node);
+    QVector<QDataflowGraph::TypeId> internTypes(const QStringList &types);
+    // QDataflowNodeFactory setting up a node that has no object
+    void setNodeValid(int id, bool valid);
+    void setNodeIOletTypes(int id, const QStringList &inletTypes, const QStringList &outletTypes);
+    void insertNode(QDataflowModelNode *node);
+    void recordNodeAdded(QDataflowModelNode *node);
+    void recordNodeRemoved(QDataflowModelNode *node);
+    void recordNodeChange(QDataflowModelNode *node, QDataflowModelChangeSet::NodeChange change);
+    void recordConnectionAdded(QDataflowModelConnection *conn);
+    void recordConnectionRemoved(QDataflowModelConnection *conn);
+    void updateGraphIOlets(QDataflowModelNode *node);
+
+    int transactionDepth_;
+    bool dispatchCompiled_;
+    QDataflowScheduler *scheduler_;
+    QDataflowModelChangeSet pendingChanges_;
+    QSet<QDataflowModelNode*> pendingAddedNodes_;
+    QSet<QDataflowModelConnection*> pendingAddedConnections_;
+    QSet<int> pendingAddedNodeIds_;
+    QSet<int> pendingAddedConnectionIds_;
+    QDataflowGraph graph_;
+    QDataflowGraphAnalysis analysis_;
+    bool rejectCycles_;
+    // the objects by graph id, null until first asked for; removed ones
+    // stay until the model is deleted, as views may still refer to them
+    mutable QMutex handlesMutex_;
+    mutable QVector<QDataflowModelNode*> nodesById_;
+    mutable QVector<QDataflowModelConnection*> connectionsById_;
+    // attached to the node objects created on demand
+    QList<QDataflowNodeFactory*> factories_;
+    QDataflowProfiler profiler_;
+    QDataflowUndoLog undoLog_;
+
+    friend class QDataflowModelNode;
+    friend class QDataflowModelIOlet;
+    friend class QDataflowModelOutlet;
+    friend class QDataflowNodeFactory;
+};
+
+class QDataflowModelTransaction
+{
+public:
+    explicit QDataflowModelTransaction(QDataflowModel *model) : model_(model) {model_->beginTransaction();}
+    ~QDataflowModelTransaction() {model_->commitTransaction();}
 
 private:
-    QSet<QDataflowModelNode*> nodes_;
-    QSet<QDataflowModelConnection*> connections_;
+    Q_DISABLE_COPY(QDataflowModelTransaction)
+
+    QDataflowModel *model_;
 };
 
-class QDataflowModelNode : public QObject
+class QDataflowModelNode : public QObject, public QDataflowPooled<QDataflowModelNode>
 {
     Q_OBJECT
 protected:
@@ -93,8 +264,18 @@ protected:
     explicit QDataflowModelNode(QDataflowModel *parent, const QPoint &pos, const QString &text, const QStringList &inletTypes, const QStringList &outletTypes);
 
 public:
-    QDataflowModel * model();
+    ~QDataflowModelNode() override;
 
+    QDataflowModel * model();
+    // QDataflowGraph node id; InvalidId while not part of the model, when
+    // pos, text, validity and iolet types are the object's own
+    int id() const;
+    // the id it had when last added, still set after removal so views can
+    // find their item for it
+    int lastId() const {return lastId_;}
+
+    // a node set up by a QDataflowNodeFactory gets its meta object when
+    // this is first called, typically by the first message sent to it
     QDataflowMetaObject * dataflowMetaObject() const;
     void setDataflowMetaObject(QDataflowMetaObject *dataflowMetaObject);
 
@@ -115,6 +296,8 @@ Q_SIGNALS:
     void textChanged(const QString &text);
     void inletCountChanged(int count);
     void outletCountChanged(int count);
+    void inletTypesChanged();
+    void outletTypesChanged();
 
 public Q_SLOTS:
     void setPos(const QPoint &pos);
@@ -135,14 +318,28 @@ protected Q_SLOTS:
     void addOutlet(QDataflowModelOutlet *outlet);
 
 private:
+    // around every edit of the iolets of a node in the model
+    void beginIoletChange();
+    void endIoletChange();
+    // the dispatch tables of the outlets feeding this node name its meta
+    // object, or left it out while it had none
+    void invalidateUpstreamDispatchTables();
+
+    QDataflowModel *model_;
+    int id_;
+    int lastId_;
+    // read from the graph while the node is part of the model
     bool valid_;
     QPoint pos_;
     QString text_;
     QList<QDataflowModelInlet*> inlets_;
     QList<QDataflowModelOutlet*> outlets_;
-    QDataflowMetaObject *dataflowMetaObject_;
+    // created lazily, possibly on a worker thread, when factory_ is set
+    std::atomic<QDataflowMetaObject*> dataflowMetaObject_;
+    std::atomic<QDataflowNodeFactory*> factory_;
 
     friend class QDataflowModel;
+    friend class QDataflowNodeFactory;
 };
 
 QDebug operator<<(QDebug debug, const QDataflowModelNode &node);
@@ -161,52 +358,113 @@ public:
     int index() const;
     QString name() const;
     QString type() const;
+    // interned in the model's QDataflowGraph
+    int typeId() const;
 
-    void addConnection(QDataflowModelConnection *conn);
-    void removeConnection(QDataflowModelConnection *conn);
+    // from the graph, in the order they were made; the connections get
+    // their objects
     QList<QDataflowModelConnection*> connections() const;
+    QDataflowModelConnection * connection(QDataflowModelIOlet *peer) const;
+
+protected:
+    void setType(const QString &type);
 
 private:
-    QList<QDataflowModelConnection*> connections_;
     QDataflowModelNode *node_;
     int index_;
+    bool inlet_;
     QString name_;
     QString type_;
+    int typeId_;
+
+    friend class QDataflowModelNode;
+    friend class QDataflowModelInlet;
 };
 
-class QDataflowModelInlet : public QDataflowModelIOlet
+class QDataflowModelInlet : public QDataflowModelIOlet, public QDataflowPooled<QDataflowModelInlet>
 {
     Q_OBJECT
 protected:
     explicit QDataflowModelInlet(QDataflowModelNode *parent, int index, const QString &name = {}, const QString &type = QStringLiteral("*"));
 
 public:
+    ~QDataflowModelInlet() override;
+
     bool canAcceptConnectionFrom(QDataflowModelOutlet *outlet);
 
+    // with a scheduler, messages to a queued inlet wait in its lock-free
+    // queue instead of the meta object's mailbox, and a full queue pushes
+    // back on the producer as its policy says; without one (the default)
+    // or without a scheduler nothing changes. Not while messages are in
+    // flight: call QDataflowScheduler::waitForIdle() first.
+    QDataflowInletQueue * queue() const {return queue_;}
+    void setQueue(int capacity, QDataflowInletQueue::Policy policy = QDataflowInletQueue::DropOldest);
+    void clearQueue();
+
 private:
+    QDataflowInletQueue *queue_;
+
     friend class QDataflowModelNode;
 };
 
 QDebug operator<<(QDebug debug, const QDataflowModelInlet &inlet);
 QDebug operator<<(QDebug debug, const QDataflowModelInlet *inlet);
 
-class QDataflowModelOutlet : public QDataflowModelIOlet
+struct QDataflowDispatchTarget
+{
+    QDataflowMetaObject *metaObject;
+    int inlet;
+    int connection;
+};
+
+class QDataflowModelOutlet : public QDataflowModelIOlet, public QDataflowPooled<QDataflowModelOutlet>
 {
     Q_OBJECT
 protected:
     explicit QDataflowModelOutlet(QDataflowModelNode *parent, int index, const QString &name = {}, const QString &type = QStringLiteral("*"));
 
 public:
+    ~QDataflowModelOutlet() override;
+
     bool canMakeConnectionTo(QDataflowModelInlet *inlet);
 
+    // the receivers in topological order, ties in connection order.
+    // Senders load it without a lock; the first one after
+    // invalidateDispatchTable(), or after the topological order changed,
+    // rebuilds it under a lock. The copy returned stays valid while the
+    // table is rebuilt or invalidated. Invalidated from the thread that
+    // edits the model, as the scheduler requires, never while another
+    // thread sends.
+    QVector<QDataflowDispatchTarget> dispatchTable() const;
+    void invalidateDispatchTable();
+
 private:
+    struct DispatchTable
+    {
+        QVector<QDataflowDispatchTarget> targets;
+        quint64 orderGeneration;
+        const DispatchTable *next;
+    };
+
+    QVector<QDataflowDispatchTarget> buildDispatchTable() const;
+    static void deleteDispatchTables(const DispatchTable *table);
+
+    mutable std::atomic<const DispatchTable*> dispatchTable_;
+    // replaced while senders may still be reading them; freed by the
+    // next invalidation
+    mutable std::atomic<const DispatchTable*> retiredDispatchTables_;
+    // serializes rebuilds by senders on several threads
+    mutable QMutex dispatchTableMutex_;
+    // bumped by every invalidation; a table built across one is not kept
+    std::atomic<quint64> dispatchTableGeneration_;
+
     friend class QDataflowModelNode;
 };
 
 QDebug operator<<(QDebug debug, const QDataflowModelOutlet &outlet);
 QDebug operator<<(QDebug debug, const QDataflowModelOutlet *outlet);
 
-class QDataflowModelConnection : public QObject
+class QDataflowModelConnection : public QObject, public QDataflowPooled<QDataflowModelConnection>
 {
     Q_OBJECT
 protected:
@@ -214,11 +472,17 @@ protected:
 
 public:
     QDataflowModel * model();
+    // QDataflowGraph edge id; InvalidId while not part of the model
+    int id() const;
+    int lastId() const {return lastId_;}
 
     QDataflowModelOutlet * source() const;
     QDataflowModelInlet * dest() const;
 
 private:
+    QDataflowModel *model_;
+    int id_;
+    int lastId_;
     QDataflowModelOutlet *source_;
     QDataflowModelInlet *dest_;
 
@@ -228,6 +492,14 @@ private:
 QDebug operator<<(QDebug debug, const QDataflowModelConnection &conn);
 QDebug operator<<(QDebug debug, const QDataflowModelConnection *conn);
 
+struct QDataflowScheduledMessage
+{
+    int inlet = -1;
+    QDataflowMessage message;
+    // when it was sent, relative to the other messages to the same object
+    quint64 order = 0;
+};
+
 class QDataflowMetaObject
 {
 public:
@@ -244,13 +516,45 @@ public:
     int outletCount() {return node_->outletCount();}
     void setOutletCount(int c) {node_->setOutletCount(c);}
     void setOutletTypes(std::initializer_list<const char*> types) {node_->setOutletTypes(types);}
-    virtual void onDataReceved(int inlet, void *data);
-    void sendData(int outlet, void *data);
+    virtual void onDataReceved(int inlet, const QDataflowMessage &message);
+    // the message must match the outlet type() unless that is "*"
+    void sendData(int outlet, const QDataflowMessage &message);
+
+    // in block mode "samples" messages are handed to onBlockReceived() as
+    // one contiguous span, for loops the compiler can vectorize or for
+    // QDataflowKernels; other messages still go to onDataReceved()
+    bool isBlockProcessing() const {return blockProcessing_;}
+    void setBlockProcessing(bool block) {blockProcessing_ = block;}
+    virtual void onBlockReceived(int inlet, const float *samples, int count);
+
+    // QDataflowNodeFactory: the node text changed but names the same class;
+    // return false to have the meta object created again instead
+    virtual bool setArguments(const QStringList &args);
 
 private:
+    // calls onDataReceved() or onBlockReceived(), timed when profiling
+    void receive(int inlet, const QDataflowMessage &message);
+    void process(int inlet, const QDataflowMessage &message);
+    // the oldest message in the inlet queues and the mailbox
+    bool takeMessage(QDataflowScheduledMessage &msg);
+    // staged messages included; only for the worker running this object
+    bool hasMessages();
+    // the inlet queues and the mailbox only; safe once the object may be
+    // scheduled on another worker
+    bool hasIncomingMessages();
+
     QDataflowModelNode *node_;
+    bool blockProcessing_;
+    QMutex mailboxMutex_;
+    QQueue<QDataflowScheduledMessage> mailbox_;
+    std::atomic<bool> scheduled_;
+    std::atomic<quint64> sendOrder_;
+    // the head of every inlet queue, by inlet; only the worker running
+    // this object touches it
+    QVector<QDataflowScheduledMessage> staged_;
 
     friend class QDataflowModelNode;
+    friend class QDataflowScheduler;
 };
 
 class QDataflowModelDebugSignals : public QObject
@@ -269,8 +573,11 @@ private Q_SLOTS:
     void onNodeTextChanged(QDataflowModelNode *node, const QString &text);
     void onNodeInletCountChanged(QDataflowModelNode *node, int count);
     void onNodeOutletCountChanged(QDataflowModelNode *node, int count);
+    void onNodeInletTypesChanged(QDataflowModelNode *node);
+    void onNodeOutletTypesChanged(QDataflowModelNode *node);
     void onConnectionAdded(QDataflowModelConnection *conn);
     void onConnectionRemoved(QDataflowModelConnection *conn);
+    void onTransactionCommitted(const QDataflowModelChangeSet &changes);
 };
 
 #endif // QDATAFLOWMODEL_H
@@ -0,0 +1,307 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflownodefactory.h"
+#include "qdataflowscheduler.h"
+
+// texts are few compared to nodes; the cache is dropped when it gets
+// this large instead of tracking which texts are still in use
+static const int argumentCacheLimit = 4096;
+
+QDataflowNodeFactory::QDataflowNodeFactory(QDataflowModel *parent)
+    : QObject(parent), model_(parent), lazy_(true)
+{
+    model_->factories_.push_back(this);
+    QObject::connect(parent, &QDataflowModel::nodeAdded, this, &QDataflowNodeFactory::onNodeAdded);
+    QObject::connect(parent, &QDataflowModel::nodeRemoved, this, &QDataflowNodeFactory::onNodeRemoved);
+    QObject::connect(parent, &QDataflowModel::nodeTextChanged, this, &QDataflowNodeFactory::onNodeTextChanged);
+    QObject::connect(parent, &QDataflowModel::transactionCommitted, this, &QDataflowNodeFactory::onTransactionCommitted);
+}
+
+QDataflowNodeFactory::~QDataflowNodeFactory()
+{
+    model_->factories_.removeOne(this);
+    QMutexLocker lock(&mutex_);
+    for(auto it = bindings_.constBegin(); it != bindings_.constEnd(); ++it)
+    {
+        QDataflowNodeFactory *self = this;
+        if(QDataflowModelNode *node = model_->findNode(it.key()))
+            node->factory_.compare_exchange_strong(self, nullptr);
+    }
+}
+
+void QDataflowNodeFactory::registerClass(const QString &name, const QStringList &inletTypes, const QStringList &outletTypes, const Constructor &constructor)
+{
+    classes_.insert(name, {inletTypes, outletTypes, constructor});
+}
+
+bool QDataflowNodeFactory::isRegistered(const QString &name) const
+{
+    return classes_.contains(name);
+}
+
+QStringList QDataflowNodeFactory::classNames() const
+{
+    return classes_.keys();
+}
+
+QStringList QDataflowNodeFactory::arguments(const QString &text)
+{
+    auto it = argumentCache_.constFind(text);
+    if(it != argumentCache_.constEnd()) return *it;
+
+    QStringList args;
+    int start = -1;
+    for(int i = 0; i <= text.size(); i++)
+    {
+        const bool space = i == text.size() || text[i].isSpace();
+        if(space && start >= 0)
+        {
+            args << text.mid(start, i - start);
+            start = -1;
+        }
+        else if(!space && start < 0)
+        {
+            start = i;
+        }
+    }
+
+    if(argumentCache_.size() >= argumentCacheLimit)
+        argumentCache_.clear();
+    argumentCache_.insert(text, args);
+    return args;
+}
+
+QString QDataflowNodeFactory::className(QDataflowModelNode *node) const
+{
+    if(!node) return {};
+    return className(node->id());
+}
+
+QString QDataflowNodeFactory::className(int id) const
+{
+    QMutexLocker lock(&mutex_);
+    return bindings_.value(id).className;
+}
+
+bool QDataflowNodeFactory::isLazy() const
+{
+    return lazy_;
+}
+
+void QDataflowNodeFactory::setLazy(bool lazy)
+{
+    lazy_ = lazy;
+}
+
+void QDataflowNodeFactory::setup(QDataflowModelNode *node)
+{
+    if(!node || node->id() == QDataflowGraph::InvalidId) return;
+
+    const QStringList args = arguments(node->text());
+    auto cls = classes_.constFind(args.value(0));
+    if(cls == classes_.constEnd())
+    {
+        if(unbind(node))
+            node->setDataflowMetaObject(nullptr);
+        node->setValid(false);
+        return;
+    }
+
+    Binding binding;
+    bool bound = false;
+    {
+        QMutexLocker lock(&mutex_);
+        auto it = bindings_.constFind(node->id());
+        if(it != bindings_.constEnd() && node->factory_.load() == this)
+        {
+            binding = *it;
+            bound = true;
+        }
+    }
+
+    // same class and signature: the iolets stay as they are, and so does
+    // the meta object unless it refuses the new arguments
+    if(bound && binding.className == cls.key() && binding.cls.inletTypes == cls->inletTypes && binding.cls.outletTypes == cls->outletTypes)
+    {
+        QDataflowMetaObject *mo = node->dataflowMetaObject_.load(std::memory_order_acquire);
+        bool keep = !mo || binding.args == args;
+        if(!keep)
+        {
+            if(QDataflowScheduler *scheduler = node->model()->scheduler())
+                scheduler->waitForIdle();
+            keep = mo->setArguments(args);
+        }
+        if(keep)
+        {
+            QMutexLocker lock(&mutex_);
+            Binding &b = bindings_[node->id()];
+            b.args = args;
+            b.cls = *cls;
+            lock.unlock();
+            node->setValid(true);
+            return;
+        }
+    }
+
+    // stop instantiate() first, so that no meta object of the old class
+    // appears after the check
+    QDataflowMetaObject *old;
+    {
+        QMutexLocker lock(&mutex_);
+        node->factory_ = nullptr;
+        old = node->dataflowMetaObject_.load(std::memory_order_acquire);
+    }
+    if(old)
+        node->setDataflowMetaObject(nullptr);
+
+    // iolets whose type stays keep their connections
+    node->setInletTypes(cls->inletTypes);
+    node->setOutletTypes(cls->outletTypes);
+
+    {
+        QMutexLocker lock(&mutex_);
+        bindings_.insert(node->id(), {cls.key(), args, *cls});
+    }
+    node->factory_.store(this, std::memory_order_release);
+    // a sender upstream may have rebuilt its table while factory_ was
+    // null, and left this node out of it
+    node->invalidateUpstreamDispatchTables();
+
+    if(!lazy_)
+        node->dataflowMetaObject();
+    node->setValid(true);
+}
+
+void QDataflowNodeFactory::setup(int id)
+{
+    // a node with an object, or one the object is needed for: a meta
+    // object built right away, or connections a type change may drop
+    const QDataflowGraph &graph = model_->graph();
+    if(!graph.containsNode(id)) return;
+    if(QDataflowModelNode *node = model_->findNode(id))
+    {
+        setup(node);
+        return;
+    }
+    if(!lazy_)
+    {
+        setup(model_->nodeById(id));
+        return;
+    }
+
+    const QStringList args = arguments(graph.text(id));
+    auto cls = classes_.constFind(args.value(0));
+    if(cls == classes_.constEnd())
+    {
+        {
+            QMutexLocker lock(&mutex_);
+            bindings_.remove(id);
+        }
+        model_->setNodeValid(id, false);
+        return;
+    }
+
+    bool sameTypes = graph.inletCount(id) == cls->inletTypes.size() && graph.outletCount(id) == cls->outletTypes.size();
+    for(int i = 0; sameTypes && i < graph.inletCount(id); i++)
+        sameTypes = graph.typeName(graph.inletType(id, i)) == cls->inletTypes[i];
+    for(int i = 0; sameTypes && i < graph.outletCount(id); i++)
+        sameTypes = graph.typeName(graph.outletType(id, i)) == cls->outletTypes[i];
+    if(!sameTypes)
+    {
+        if(!graph.inEdges(id).isEmpty() || !graph.outEdges(id).isEmpty())
+        {
+            setup(model_->nodeById(id));
+            return;
+        }
+        model_->setNodeIOletTypes(id, cls->inletTypes, cls->outletTypes);
+    }
+
+    // no dispatch table names a node without an object, so none needs
+    // to be invalidated
+    {
+        QMutexLocker lock(&mutex_);
+        bindings_.insert(id, {cls.key(), args, *cls});
+    }
+    model_->setNodeValid(id, true);
+}
+
+void QDataflowNodeFactory::onNodeAdded(QDataflowModelNode *node)
+{
+    setup(node);
+}
+
+void QDataflowNodeFactory::onNodeRemoved(QDataflowModelNode *node)
+{
+    unbind(node);
+}
+
+void QDataflowNodeFactory::onNodeTextChanged(QDataflowModelNode *node, const QString &text)
+{
+    Q_UNUSED(text);
+    setup(node);
+}
+
+void QDataflowNodeFactory::onTransactionCommitted(const QDataflowModelChangeSet &changes)
+{
+    for(auto *node : changes.removedNodes)
+        unbind(node);
+    for(auto *node : changes.addedNodes)
+        setup(node);
+    for(int id : changes.addedNodeIds)
+        setup(id);
+    for(auto it = changes.changedNodes.constBegin(); it != changes.changedNodes.constEnd(); ++it)
+        if(it.value() & QDataflowModelChangeSet::TextChanged)
+            setup(it.key());
+}
+
+QDataflowMetaObject * QDataflowNodeFactory::instantiate(QDataflowModelNode *node)
+{
+    QMutexLocker lock(&mutex_);
+    // another thread may have been first
+    if(QDataflowMetaObject *mo = node->dataflowMetaObject_.load(std::memory_order_acquire))
+        return mo;
+    if(node->factory_.load() != this) return {};
+    auto it = bindings_.constFind(node->id());
+    if(it == bindings_.constEnd()) return {};
+
+    QDataflowMetaObject *mo = it->cls.constructor ? it->cls.constructor(node, it->args) : nullptr;
+    if(!mo)
+    {
+        qWarning() << "QDataflowNodeFactory: cannot create" << it->className << "for" << node;
+        node->factory_ = nullptr;
+        return {};
+    }
+    mo->setNode(node);
+    node->dataflowMetaObject_.store(mo, std::memory_order_release);
+    return mo;
+}
+
+void QDataflowNodeFactory::attach(QDataflowModelNode *node)
+{
+    QMutexLocker lock(&mutex_);
+    if(bindings_.contains(node->id()))
+        node->factory_.store(this, std::memory_order_release);
+}
+
+bool QDataflowNodeFactory::unbind(QDataflowModelNode *node)
+{
+    // a removed node is unbound by the id it had
+    QMutexLocker lock(&mutex_);
+    QDataflowNodeFactory *self = this;
+    node->factory_.compare_exchange_strong(self, nullptr);
+    return bindings_.remove(node->lastId()) > 0;
+}
@@ -0,0 +1,119 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWNODEFACTORY_H
+#define QDATAFLOWNODEFACTORY_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+#include "qdataflowmodel.h"
+
+// Sets up the nodes of a model from the class named by the first word of
+// their text, like QDataflowModelDebugSignals it attaches to the model:
+//
+//   QDataflowNodeFactory *factory = new QDataflowNodeFactory(model);
+//   factory->registerClass("add", {"int", "int"}, {"int"},
+//       [](QDataflowModelNode *node, const QStringList &args) {return new Add(node, args);});
+//
+// Nodes get the declared iolet types when added or when their text changes;
+// iolets whose type stays are kept, with their connections. The meta object
+// is only created when the node is first asked for it, normally by the
+// first message sent to it, so loading a large patch builds no meta objects.
+// Nodes added by id are set up in the graph, without an object, unless
+// they are connected and their types change; bindings are by node id, and
+// the object created on demand later picks its binding up.
+// The constructor may then run on a scheduler worker thread: it must not
+// change the node, which already has the declared iolets.
+//
+// A text change that names the same class keeps the meta object if it
+// accepts the new arguments (QDataflowMetaObject::setArguments()).
+class QDataflowNodeFactory : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<QDataflowMetaObject*(QDataflowModelNode *node, const QStringList &args)> Constructor;
+
+    explicit QDataflowNodeFactory(QDataflowModel *parent);
+    ~QDataflowNodeFactory() override;
+
+    // replaces a class of the same name; nodes already set up keep the old
+    // declaration until their text changes
+    void registerClass(const QString &name, const QStringList &inletTypes, const QStringList &outletTypes, const Constructor &constructor);
+    bool isRegistered(const QString &name) const;
+    QStringList classNames() const;
+
+    // the words of a node text, class name first; cached by text
+    QStringList arguments(const QString &text);
+    // class of a node set up by this factory, empty for unknown classes
+    QString className(QDataflowModelNode *node) const;
+    QString className(int id) const;
+
+    // create meta objects on first use; when false, they are created
+    // right away by setup()
+    bool isLazy() const;
+    void setLazy(bool lazy);
+
+    // called for added nodes and text changes; nodes of unknown classes
+    // are marked invalid and lose their meta object
+    void setup(QDataflowModelNode *node);
+    void setup(int id);
+
+private Q_SLOTS:
+    void onNodeAdded(QDataflowModelNode *node);
+    void onNodeRemoved(QDataflowModelNode *node);
+    void onNodeTextChanged(QDataflowModelNode *node, const QString &text);
+    void onTransactionCommitted(const QDataflowModelChangeSet &changes);
+
+private:
+    struct Class
+    {
+        QStringList inletTypes;
+        QStringList outletTypes;
+        Constructor constructor;
+    };
+
+    struct Binding
+    {
+        QString className;
+        QStringList args;
+        Class cls;
+    };
+
+    // the constructors run with mutex_ held
+    QDataflowMetaObject * instantiate(QDataflowModelNode *node);
+    // a node object the model created on demand, possibly on a worker
+    // thread
+    void attach(QDataflowModelNode *node);
+    bool unbind(QDataflowModelNode *node);
+
+    QDataflowModel *model_;
+    QHash<QString, Class> classes_;
+    QHash<QString, QStringList> argumentCache_;
+    bool lazy_;
+    // guards bindings_ against instantiate() and attach() on worker threads
+    mutable QMutex mutex_;
+    QHash<int, Binding> bindings_;
+
+    friend class QDataflowModel;
+    friend class QDataflowModelNode;
+};
+
+#endif // QDATAFLOWNODEFACTORY_H
@@ -0,0 +1,354 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowpatchfile.h"
+#include "qdataflowmodel.h"
+#include "utility.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QVector>
+#include <QtEndian>
+#include <QDebug>
+
+namespace {
+
+const quint32 patchMagic = 0x50464451; // "QDFP"
+const quint32 patchVersion = 1;
+
+// all fields are little-endian quint32, so every table stays 4-byte aligned
+struct PatchHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 stringCount;
+    quint32 stringBytes;
+    quint32 nodeCount;
+    quint32 typeCount;
+    quint32 edgeCount;
+    quint32 reserved;
+};
+
+struct PatchString
+{
+    quint32 offset;
+    quint32 size;
+};
+
+struct PatchNode
+{
+    quint32 x;
+    quint32 y;
+    quint32 text;
+    quint32 firstType;
+    quint32 inletCount;
+    quint32 outletCount;
+};
+
+struct PatchEdge
+{
+    quint32 source;
+    quint32 outlet;
+    quint32 dest;
+    quint32 inlet;
+};
+
+inline quint32 le(quint32 value)
+{
+    return qFromLittleEndian(value);
+}
+
+template<typename T>
+void appendTable(QByteArray &out, const QVector<T> &table)
+{
+    out.append(reinterpret_cast<const char*>(table.constData()), int(table.size() * sizeof(T)));
+}
+
+} // namespace
+
+bool QDataflowPatchFile::save(QDataflowModel *model, const QString &fileName)
+{
+    if(!model) return false;
+
+    const QDataflowGraph &graph = model->graph();
+
+    QHash<QString, quint32> stringIndex;
+    QVector<QString> strings;
+    auto intern = [&](const QString &s) -> quint32
+    {
+        auto it = stringIndex.constFind(s);
+        if(it != stringIndex.constEnd()) return *it;
+        const quint32 index = strings.size();
+        strings.push_back(s);
+        stringIndex.insert(s, index);
+        return index;
+    };
+
+    // records are written in node id order; edges refer to record indices,
+    // which are dense even when ids have holes
+    QVector<quint32> nodeRecord(graph.nodeIdBound());
+    QVector<PatchNode> nodes;
+    QVector<quint32> types;
+    nodes.reserve(graph.nodeCount());
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+    {
+        if(!graph.containsNode(id)) continue;
+        nodeRecord[id] = nodes.size();
+        PatchNode rec;
+        rec.x = qToLittleEndian(quint32(graph.pos(id).x()));
+        rec.y = qToLittleEndian(quint32(graph.pos(id).y()));
+        rec.text = qToLittleEndian(intern(graph.text(id)));
+        rec.firstType = qToLittleEndian(quint32(types.size()));
+        rec.inletCount = qToLittleEndian(quint32(graph.inletCount(id)));
+        rec.outletCount = qToLittleEndian(quint32(graph.outletCount(id)));
+        for(int i = 0; i < graph.inletCount(id); i++)
+            types.push_back(qToLittleEndian(intern(graph.typeName(graph.inletType(id, i)))));
+        for(int i = 0; i < graph.outletCount(id); i++)
+            types.push_back(qToLittleEndian(intern(graph.typeName(graph.outletType(id, i)))));
+        nodes.push_back(rec);
+    }
+
+    QVector<PatchEdge> edges;
+    edges.reserve(graph.edgeCount());
+    for(int id = 0; id < graph.edgeIdBound(); id++)
+    {
+        if(!graph.containsEdge(id)) continue;
+        PatchEdge rec;
+        rec.source = qToLittleEndian(nodeRecord[graph.edgeSource(id)]);
+        rec.outlet = qToLittleEndian(quint32(graph.edgeOutlet(id)));
+        rec.dest = qToLittleEndian(nodeRecord[graph.edgeDest(id)]);
+        rec.inlet = qToLittleEndian(quint32(graph.edgeInlet(id)));
+        edges.push_back(rec);
+    }
+
+    QVector<PatchString> stringRecs;
+    QByteArray stringBytes;
+    stringRecs.reserve(strings.size());
+    for(auto &s : as_const(strings))
+    {
+        const QByteArray utf8 = s.toUtf8();
+        PatchString rec;
+        rec.offset = qToLittleEndian(quint32(stringBytes.size()));
+        rec.size = qToLittleEndian(quint32(utf8.size()));
+        stringBytes.append(utf8);
+        stringRecs.push_back(rec);
+    }
+    while(stringBytes.size() % 4)
+        stringBytes.append('\0');
+
+    PatchHeader header;
+    header.magic = qToLittleEndian(patchMagic);
+    header.version = qToLittleEndian(patchVersion);
+    header.stringCount = qToLittleEndian(quint32(stringRecs.size()));
+    header.stringBytes = qToLittleEndian(quint32(stringBytes.size()));
+    header.nodeCount = qToLittleEndian(quint32(nodes.size()));
+    header.typeCount = qToLittleEndian(quint32(types.size()));
+    header.edgeCount = qToLittleEndian(quint32(edges.size()));
+    header.reserved = 0;
+
+    QByteArray out;
+    out.reserve(int(sizeof(header) + stringRecs.size() * sizeof(PatchString) + nodes.size() * sizeof(PatchNode)
+                    + types.size() * sizeof(quint32) + edges.size() * sizeof(PatchEdge)) + stringBytes.size());
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    appendTable(out, stringRecs);
+    appendTable(out, nodes);
+    appendTable(out, types);
+    appendTable(out, edges);
+    out.append(stringBytes);
+
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit())
+    {
+        qWarning() << "QDataflowPatchFile: cannot write" << fileName << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool QDataflowPatchFile::load(QDataflowModel *model, const QString &fileName)
+{
+    if(!model) return false;
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "QDataflowPatchFile: cannot open" << fileName << file.errorString();
+        return false;
+    }
+
+    // the tables are used straight from the mapping; files that cannot be
+    // mapped are read into memory instead
+    if(const uchar *data = file.map(0, file.size()))
+        return load(model, reinterpret_cast<const char*>(data), file.size());
+
+    const QByteArray data = file.readAll();
+    return load(model, data.constData(), data.size());
+}
+
+bool QDataflowPatchFile::load(QDataflowModel *model, const char *data, qint64 size)
+{
+    if(!model || !data) return false;
+
+    // records are read in place and need the alignment of their fields
+    if(quintptr(data) % alignof(quint32))
+    {
+        const QByteArray copy(data, int(size));
+        return load(model, copy.constData(), copy.size());
+    }
+
+    auto invalid = [](const char *what)
+    {
+        qWarning() << "QDataflowPatchFile: invalid patch:" << what;
+        return false;
+    };
+
+    if(size < qint64(sizeof(PatchHeader))) return invalid("truncated header");
+    const PatchHeader *header = reinterpret_cast<const PatchHeader*>(data);
+    if(le(header->magic) != patchMagic) return invalid("bad magic");
+    if(le(header->version) != patchVersion) return invalid("unsupported version");
+
+    const quint32 stringCount = le(header->stringCount);
+    const quint32 stringBytes = le(header->stringBytes);
+    const quint32 nodeCount = le(header->nodeCount);
+    const quint32 typeCount = le(header->typeCount);
+    const quint32 edgeCount = le(header->edgeCount);
+
+    // 64-bit arithmetic: the counts cannot overflow the size check
+    const quint64 stringsAt = sizeof(PatchHeader);
+    const quint64 nodesAt = stringsAt + quint64(stringCount) * sizeof(PatchString);
+    const quint64 typesAt = nodesAt + quint64(nodeCount) * sizeof(PatchNode);
+    const quint64 edgesAt = typesAt + quint64(typeCount) * sizeof(quint32);
+    const quint64 bytesAt = edgesAt + quint64(edgeCount) * sizeof(PatchEdge);
+    if(bytesAt + stringBytes > quint64(size)) return invalid("truncated tables");
+
+    const PatchString *stringRecs = reinterpret_cast<const PatchString*>(data + stringsAt);
+    const PatchNode *nodes = reinterpret_cast<const PatchNode*>(data + nodesAt);
+    const quint32 *types = reinterpret_cast<const quint32*>(data + typesAt);
+    const PatchEdge *edges = reinterpret_cast<const PatchEdge*>(data + edgesAt);
+    const char *bytes = data + bytesAt;
+
+    // everything is checked before the model is touched
+    for(quint32 i = 0; i < stringCount; i++)
+        if(quint64(le(stringRecs[i].offset)) + le(stringRecs[i].size) > stringBytes)
+            return invalid("string out of range");
+    for(quint32 i = 0; i < typeCount; i++)
+        if(le(types[i]) >= stringCount)
+            return invalid("type out of range");
+    for(quint32 i = 0; i < nodeCount; i++)
+    {
+        const PatchNode &rec = nodes[i];
+        if(le(rec.text) >= stringCount)
+            return invalid("node text out of range");
+        if(quint64(le(rec.firstType)) + le(rec.inletCount) + le(rec.outletCount) > typeCount)
+            return invalid("node types out of range");
+    }
+    for(quint32 i = 0; i < edgeCount; i++)
+    {
+        const PatchEdge &rec = edges[i];
+        if(le(rec.source) >= nodeCount || le(rec.dest) >= nodeCount)
+            return invalid("edge node out of range");
+        if(le(rec.outlet) >= le(nodes[le(rec.source)].outletCount) || le(rec.inlet) >= le(nodes[le(rec.dest)].inletCount))
+            return invalid("edge iolet out of range");
+    }
+
+    QVector<QString> strings(int(stringCount));
+    for(quint32 i = 0; i < stringCount; i++)
+        strings[int(i)] = QString::fromUtf8(bytes + le(stringRecs[i].offset), int(le(stringRecs[i].size)));
+
+    // by id: the nodes get their objects only once something asks for them
+    QDataflowModelTransaction transaction(model);
+    model->reserve(int(nodeCount), int(edgeCount));
+
+    QVector<int> created(int(nodeCount));
+    QStringList inletTypes, outletTypes;
+    for(quint32 i = 0; i < nodeCount; i++)
+    {
+        const PatchNode &rec = nodes[i];
+        const quint32 *type = types + le(rec.firstType);
+        inletTypes.clear();
+        outletTypes.clear();
+        for(quint32 j = le(rec.inletCount); j > 0; j--)
+            inletTypes.push_back(strings[int(le(*type++))]);
+        for(quint32 j = le(rec.outletCount); j > 0; j--)
+            outletTypes.push_back(strings[int(le(*type++))]);
+        const QPoint pos(qint32(le(rec.x)), qint32(le(rec.y)));
+        created[int(i)] = model->createNode(pos, strings[int(le(rec.text))], inletTypes, outletTypes);
+    }
+
+    for(quint32 i = 0; i < edgeCount; i++)
+    {
+        const PatchEdge &rec = edges[i];
+        model->connectNodes(created[int(le(rec.source))], int(le(rec.outlet)), created[int(le(rec.dest))], int(le(rec.inlet)));
+    }
+
+    return true;
+}
+
+bool QDataflowPatchFile::exportText(QDataflowModel *model, const QString &fileName)
+{
+    if(!model) return false;
+
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qWarning() << "QDataflowPatchFile: cannot write" << fileName << file.errorString();
+        return false;
+    }
+
+    const QDataflowGraph &graph = model->graph();
+    QVector<int> nodeRecord(graph.nodeIdBound());
+    int nodeCount = 0;
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << "# node <index> <x> <y> <inlet types> <outlet types> <text>\n";
+    out << "# connection <source> <outlet> <dest> <inlet>\n";
+
+    auto typeList = [](const QStringList &types)
+    {
+        return types.isEmpty() ? QStringLiteral("-") : types.join(QLatin1Char(','));
+    };
+
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+    {
+        if(!graph.containsNode(id)) continue;
+        nodeRecord[id] = nodeCount;
+        QStringList inletTypes, outletTypes;
+        for(int i = 0; i < graph.inletCount(id); i++)
+            inletTypes << graph.typeName(graph.inletType(id, i));
+        for(int i = 0; i < graph.outletCount(id); i++)
+            outletTypes << graph.typeName(graph.outletType(id, i));
+        out << "node " << nodeCount++ << ' ' << graph.pos(id).x() << ' ' << graph.pos(id).y() << ' '
+            << typeList(inletTypes) << ' ' << typeList(outletTypes) << ' ' << graph.text(id) << '\n';
+    }
+
+    for(int id = 0; id < graph.edgeIdBound(); id++)
+    {
+        if(!graph.containsEdge(id)) continue;
+        out << "connection " << nodeRecord[graph.edgeSource(id)] << ' ' << graph.edgeOutlet(id) << ' '
+            << nodeRecord[graph.edgeDest(id)] << ' ' << graph.edgeInlet(id) << '\n';
+    }
+
+    out.flush();
+    if(out.status() != QTextStream::Ok || !file.commit())
+    {
+        qWarning() << "QDataflowPatchFile: cannot write" << fileName << file.errorString();
+        return false;
+    }
+    return true;
+}
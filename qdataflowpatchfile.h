@@ -0,0 +1,53 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWPATCHFILE_H
+#define QDATAFLOWPATCHFILE_H
+
+#include <QString>
+
+class QDataflowModel;
+
+// Saves and loads the structure of a QDataflowModel: node positions,
+// texts and iolet types, and the connections.
+//
+// The binary format is a little-endian image of fixed-size tables that is
+// mapped and read in place:
+//
+//   header
+//   string records   {offset, size} into the string bytes, UTF-8
+//   node records     {x, y, text, firstType, inletCount, outletCount}
+//   iolet types      string indices, inlets then outlets of each node
+//   edge records     {source, outlet, dest, inlet}, nodes by record index
+//   string bytes
+//
+// Strings are shared: each distinct text and type is stored and decoded
+// once. A load is one model transaction, so views see a single
+// transactionCommitted() no matter the size of the patch.
+class QDataflowPatchFile
+{
+public:
+    static bool save(QDataflowModel *model, const QString &fileName);
+    // adds the patch to the model; nothing is added if the file is invalid
+    static bool load(QDataflowModel *model, const QString &fileName);
+    static bool load(QDataflowModel *model, const char *data, qint64 size);
+
+    // one line per node and per connection, for diffing and inspection;
+    // it cannot be loaded back
+    static bool exportText(QDataflowModel *model, const QString &fileName);
+};
+
+#endif // QDATAFLOWPATCHFILE_H
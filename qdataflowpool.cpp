@@ -0,0 +1,96 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowpool.h"
+
+static std::size_t alignedSlotSize(std::size_t size)
+{
+    const std::size_t a = alignof(std::max_align_t);
+    size = qMax(size, sizeof(void*));
+    return (size + a - 1) / a * a;
+}
+
+QDataflowPool::QDataflowPool(std::size_t slotSize, int slotsPerChunk)
+    : slotSize_(alignedSlotSize(slotSize)), slotsPerChunk_(qMax(1, slotsPerChunk)), freeList_(), live_(0)
+{
+}
+
+QDataflowPool::~QDataflowPool()
+{
+    // objects still alive at exit keep their memory
+    if(live_ == 0)
+        releaseChunks();
+}
+
+void * QDataflowPool::allocate()
+{
+    QMutexLocker locker(&mutex_);
+
+    if(!freeList_)
+    {
+        char *chunk = static_cast<char*>(::operator new(slotSize_ * slotsPerChunk_));
+        chunks_.push_back(chunk);
+        for(int i = slotsPerChunk_ - 1; i >= 0; i--)
+        {
+            FreeSlot *slot = reinterpret_cast<FreeSlot*>(chunk + i * slotSize_);
+            slot->next = freeList_;
+            freeList_ = slot;
+        }
+    }
+
+    FreeSlot *slot = freeList_;
+    freeList_ = slot->next;
+    live_++;
+    return slot;
+}
+
+void QDataflowPool::deallocate(void *p)
+{
+    QMutexLocker locker(&mutex_);
+
+    FreeSlot *slot = static_cast<FreeSlot*>(p);
+    slot->next = freeList_;
+    freeList_ = slot;
+    live_--;
+}
+
+bool QDataflowPool::clear()
+{
+    QMutexLocker locker(&mutex_);
+    if(live_ > 0) return false;
+    releaseChunks();
+    return true;
+}
+
+int QDataflowPool::liveCount() const
+{
+    QMutexLocker locker(&mutex_);
+    return live_;
+}
+
+int QDataflowPool::chunkCount() const
+{
+    QMutexLocker locker(&mutex_);
+    return chunks_.size();
+}
+
+void QDataflowPool::releaseChunks()
+{
+    for(char *chunk : chunks_)
+        ::operator delete(chunk);
+    chunks_.clear();
+    freeList_ = nullptr;
+}
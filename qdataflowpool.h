@@ -0,0 +1,90 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWPOOL_H
+#define QDATAFLOWPOOL_H
+
+#include <QMutex>
+#include <QVector>
+#include <cstddef>
+#include <new>
+
+// Fixed-size slot allocator. Slots are carved from chunks and recycled
+// through a free list. Chunks are kept while the pool exists, so freeing
+// and allocating again around zero live slots costs nothing; clear() gives
+// them back once nothing is allocated.
+class QDataflowPool
+{
+public:
+    explicit QDataflowPool(std::size_t slotSize, int slotsPerChunk = 256);
+    ~QDataflowPool();
+
+    void * allocate();
+    void deallocate(void *p);
+    // releases all chunks; refused while slots are live
+    bool clear();
+
+    std::size_t slotSize() const {return slotSize_;}
+    int liveCount() const;
+    int chunkCount() const;
+
+private:
+    Q_DISABLE_COPY(QDataflowPool)
+
+    struct FreeSlot
+    {
+        FreeSlot *next;
+    };
+
+    void releaseChunks();
+
+    mutable QMutex mutex_;
+    const std::size_t slotSize_;
+    const int slotsPerChunk_;
+    QVector<char*> chunks_;
+    FreeSlot *freeList_;
+    int live_;
+};
+
+// Gives T class-specific operator new/delete backed by one pool per T.
+// Subclasses of T that are larger fall through to the global heap.
+template<typename T>
+class QDataflowPooled
+{
+public:
+    static void * operator new(std::size_t size)
+    {
+        if(size != sizeof(T)) return ::operator new(size);
+        return pool().allocate();
+    }
+
+    static void operator delete(void *p, std::size_t size)
+    {
+        if(!p) return;
+        if(size != sizeof(T)) ::operator delete(p);
+        else pool().deallocate(p);
+    }
+
+    // never destroyed: objects deleted by other static destructors at
+    // exit still find their pool
+    static QDataflowPool & pool()
+    {
+        static QDataflowPool *pool = new QDataflowPool(sizeof(T));
+        return *pool;
+    }
+};
+
+#endif // QDATAFLOWPOOL_H
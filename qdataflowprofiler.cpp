@@ -0,0 +1,157 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowprofiler.h"
+#include "utility.h"
+
+#include <QThread>
+
+// tells profilers apart in the per-thread cache, even at a reused address
+static std::atomic<quint64> nextProfilerSerial(1);
+
+thread_local QDataflowProfiler::Scope *QDataflowProfiler::Scope::current_ = nullptr;
+
+QDataflowProfiler::QDataflowProfiler()
+    : serial_(nextProfilerSerial++), enabled_(false)
+{
+}
+
+QDataflowProfiler::~QDataflowProfiler()
+{
+    qDeleteAll(threads_);
+}
+
+void QDataflowProfiler::setEnabled(bool enabled)
+{
+#ifndef QDATAFLOW_NO_PROFILING
+    enabled_ = enabled;
+#else
+    Q_UNUSED(enabled);
+#endif
+}
+
+void QDataflowProfiler::reset()
+{
+    QMutexLocker locker(&mutex_);
+    for(auto *counters : as_const(threads_))
+    {
+        QMutexLocker counterLocker(&counters->mutex);
+        counters->nodes.clear();
+        counters->edges.clear();
+    }
+}
+
+QDataflowProfile QDataflowProfiler::profile() const
+{
+    QDataflowProfile ret;
+    QMutexLocker locker(&mutex_);
+    for(auto *counters : threads_)
+    {
+        QMutexLocker counterLocker(&counters->mutex);
+        if(ret.nodes.size() < counters->nodes.size())
+            ret.nodes.resize(counters->nodes.size());
+        for(int i = 0; i < counters->nodes.size(); i++)
+        {
+            const QDataflowProfile::Node &from = counters->nodes[i];
+            QDataflowProfile::Node &to = ret.nodes[i];
+            to.messages += from.messages;
+            to.totalNs += from.totalNs;
+            to.selfNs += from.selfNs;
+            to.maxNs = qMax(to.maxNs, from.maxNs);
+            to.maxQueueDepth = qMax(to.maxQueueDepth, from.maxQueueDepth);
+        }
+        if(ret.edges.size() < counters->edges.size())
+            ret.edges.resize(counters->edges.size());
+        for(int i = 0; i < counters->edges.size(); i++)
+            ret.edges[i] += counters->edges[i];
+    }
+    return ret;
+}
+
+QDataflowProfiler::ThreadCounters * QDataflowProfiler::counters()
+{
+    // the last profiler this thread recorded into is found without a lock
+    struct Cache
+    {
+        quint64 serial;
+        ThreadCounters *counters;
+    };
+    static thread_local Cache cache = {0, nullptr};
+    if(cache.serial == serial_) return cache.counters;
+
+    QMutexLocker locker(&mutex_);
+    ThreadCounters *&counters = threads_[QThread::currentThreadId()];
+    if(!counters) counters = new ThreadCounters;
+    cache = {serial_, counters};
+    return counters;
+}
+
+void QDataflowProfiler::recordCall(int node, qint64 totalNs, qint64 selfNs)
+{
+    if(node < 0) return;
+    ThreadCounters *c = counters();
+    QMutexLocker locker(&c->mutex);
+    if(node >= c->nodes.size())
+        c->nodes.resize(node + 1);
+    QDataflowProfile::Node &n = c->nodes[node];
+    n.messages++;
+    n.totalNs += totalNs;
+    n.selfNs += selfNs;
+    n.maxNs = qMax(n.maxNs, totalNs);
+}
+
+void QDataflowProfiler::recordEdge(int connection)
+{
+    if(connection < 0) return;
+    ThreadCounters *c = counters();
+    QMutexLocker locker(&c->mutex);
+    if(connection >= c->edges.size())
+        c->edges.resize(connection + 1);
+    c->edges[connection]++;
+}
+
+void QDataflowProfiler::recordQueueDepth(int node, int depth)
+{
+    if(node < 0) return;
+    ThreadCounters *c = counters();
+    QMutexLocker locker(&c->mutex);
+    if(node >= c->nodes.size())
+        c->nodes.resize(node + 1);
+    QDataflowProfile::Node &n = c->nodes[node];
+    n.maxQueueDepth = qMax(n.maxQueueDepth, depth);
+}
+
+QDataflowProfiler::Scope::Scope(QDataflowProfiler *profiler, int node)
+    : profiler_(profiler), node_(node), childNs_(0), parent_(current_)
+{
+    current_ = this;
+    timer_.start();
+}
+
+QDataflowProfiler::Scope::~Scope()
+{
+    const qint64 ns = timer_.nsecsElapsed();
+    current_ = parent_;
+    // the scopes of every profiler on this thread share one stack; only
+    // the caller timed by the same profiler gets this call off its self time
+    for(Scope *scope = parent_; scope; scope = scope->parent_)
+    {
+        if(scope->profiler_ != profiler_) continue;
+        scope->childNs_ += ns;
+        break;
+    }
+    profiler_->recordCall(node_, ns, ns - childNs_);
+}
@@ -0,0 +1,112 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWPROFILER_H
+#define QDATAFLOWPROFILER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+
+// Aggregated counters, indexed by QDataflowModelNode::id() and
+// QDataflowModelConnection::id(); ids without traffic are zero.
+struct QDataflowProfile
+{
+    struct Node
+    {
+        quint64 messages = 0;
+        // time in onDataReceved(); self time excludes receivers that were
+        // called synchronously from it
+        qint64 totalNs = 0;
+        qint64 selfNs = 0;
+        qint64 maxNs = 0;
+        // largest mailbox seen, with a scheduler
+        int maxQueueDepth = 0;
+    };
+
+    QVector<Node> nodes;
+    QVector<quint64> edges;
+
+    Node node(int id) const {return id >= 0 && id < nodes.size() ? nodes[id] : Node();}
+    quint64 edgeMessages(int id) const {return id >= 0 && id < edges.size() ? edges[id] : 0;}
+};
+
+// Message and timing counters for one model (see QDataflowModel::profiler()).
+//
+// Every thread records into its own block of counters, which only that
+// thread writes to; profile() sums the blocks. Recording is off until
+// setEnabled(true), and compiled out entirely with QDATAFLOW_NO_PROFILING.
+class QDataflowProfiler
+{
+public:
+    QDataflowProfiler();
+    ~QDataflowProfiler();
+
+#ifndef QDATAFLOW_NO_PROFILING
+    bool isEnabled() const {return enabled_.load(std::memory_order_relaxed);}
+#else
+    bool isEnabled() const {return false;}
+#endif
+    void setEnabled(bool enabled);
+    void reset();
+
+    QDataflowProfile profile() const;
+
+    // times one onDataReceved() call
+    class Scope
+    {
+    public:
+        Scope(QDataflowProfiler *profiler, int node);
+        ~Scope();
+
+    private:
+        Q_DISABLE_COPY(Scope)
+
+        QDataflowProfiler *profiler_;
+        int node_;
+        qint64 childNs_;
+        Scope *parent_;
+        QElapsedTimer timer_;
+
+        static thread_local Scope *current_;
+    };
+
+    void recordEdge(int connection);
+    void recordQueueDepth(int node, int depth);
+
+private:
+    Q_DISABLE_COPY(QDataflowProfiler)
+
+    struct ThreadCounters
+    {
+        // uncontended except while profile() or reset() read it
+        QMutex mutex;
+        QVector<QDataflowProfile::Node> nodes;
+        QVector<quint64> edges;
+    };
+
+    ThreadCounters * counters();
+    void recordCall(int node, qint64 totalNs, qint64 selfNs);
+
+    const quint64 serial_;
+    std::atomic<bool> enabled_;
+    mutable QMutex mutex_;
+    QHash<Qt::HANDLE, ThreadCounters*> threads_;
+};
+
+#endif // QDATAFLOWPROFILER_H
@@ -0,0 +1,186 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowsceneindex.h"
+
+#include <QSet>
+#include <QtMath>
+#include <limits>
+
+template<typename T>
+QDataflowGridIndex<T>::QDataflowGridIndex(qreal cellSize)
+    : cellSize_(cellSize)
+{
+}
+
+template<typename T>
+int QDataflowGridIndex<T>::cellCoord(qreal v) const
+{
+    return qFloor(v / cellSize_);
+}
+
+template<typename T>
+typename QDataflowGridIndex<T>::CellKey QDataflowGridIndex<T>::key(int cx, int cy)
+{
+    return (CellKey(quint32(cx)) << 32) | CellKey(quint32(cy));
+}
+
+template<typename T>
+void QDataflowGridIndex<T>::insert(T item, const QRectF &sceneRect)
+{
+    const int x0 = cellCoord(sceneRect.left()), x1 = cellCoord(sceneRect.right());
+    const int y0 = cellCoord(sceneRect.top()), y1 = cellCoord(sceneRect.bottom());
+    QVector<CellKey> cells;
+    cells.reserve((x1 - x0 + 1) * (y1 - y0 + 1));
+    for(int cy = y0; cy <= y1; cy++)
+        for(int cx = x0; cx <= x1; cx++)
+            cells.push_back(key(cx, cy));
+    setCells(item, std::move(cells));
+}
+
+template<typename T>
+void QDataflowGridIndex<T>::insert(T item, const QLineF &sceneLine)
+{
+    // grid traversal (Amanatides & Woo): visit exactly the cells the segment crosses
+    const QPointF p1 = sceneLine.p1(), p2 = sceneLine.p2();
+    int cx = cellCoord(p1.x()), cy = cellCoord(p1.y());
+    const int ex = cellCoord(p2.x()), ey = cellCoord(p2.y());
+    const qreal dx = p2.x() - p1.x(), dy = p2.y() - p1.y();
+    const int stepX = dx > 0 ? 1 : -1, stepY = dy > 0 ? 1 : -1;
+    const qreal inf = std::numeric_limits<qreal>::infinity();
+    qreal tMaxX = dx != 0 ? ((cx + (stepX > 0 ? 1 : 0)) * cellSize_ - p1.x()) / dx : inf;
+    qreal tMaxY = dy != 0 ? ((cy + (stepY > 0 ? 1 : 0)) * cellSize_ - p1.y()) / dy : inf;
+    const qreal tDeltaX = dx != 0 ? cellSize_ / qAbs(dx) : inf;
+    const qreal tDeltaY = dy != 0 ? cellSize_ / qAbs(dy) : inf;
+
+    const int steps = qAbs(ex - cx) + qAbs(ey - cy);
+    QVector<CellKey> cells;
+    cells.reserve(steps + 1);
+    cells.push_back(key(cx, cy));
+    for(int i = 0; i < steps; i++)
+    {
+        if(tMaxX < tMaxY)
+        {
+            cx += stepX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            cy += stepY;
+            tMaxY += tDeltaY;
+        }
+        cells.push_back(key(cx, cy));
+    }
+    setCells(item, std::move(cells));
+}
+
+template<typename T>
+void QDataflowGridIndex<T>::remove(T item)
+{
+    auto it = itemCells_.find(item);
+    if(it == itemCells_.end()) return;
+    for(CellKey k : *it)
+    {
+        auto cell = cells_.find(k);
+        if(cell == cells_.end()) continue;
+        cell->removeOne(item);
+        if(cell->isEmpty()) cells_.erase(cell);
+    }
+    itemCells_.erase(it);
+}
+
+template<typename T>
+void QDataflowGridIndex<T>::clear()
+{
+    cells_.clear();
+    itemCells_.clear();
+}
+
+template<typename T>
+QList<T> QDataflowGridIndex<T>::items(const QRectF &sceneRect) const
+{
+    const int x0 = cellCoord(sceneRect.left()), x1 = cellCoord(sceneRect.right());
+    const int y0 = cellCoord(sceneRect.top()), y1 = cellCoord(sceneRect.bottom());
+
+    QList<T> ret;
+    QSet<T> seen;
+    auto collect = [&](const QVector<T> &cell) {
+        for(const T &item : cell)
+        {
+            if(seen.contains(item)) continue;
+            seen.insert(item);
+            ret.push_back(item);
+        }
+    };
+
+    // a rect covering more cells than are occupied (zoomed out): walk the occupied ones
+    const qint64 area = qint64(x1 - x0 + 1) * qint64(y1 - y0 + 1);
+    if(area > cells_.size())
+    {
+        for(auto it = cells_.constBegin(); it != cells_.constEnd(); ++it)
+        {
+            const int cx = int(quint32(it.key() >> 32)), cy = int(quint32(it.key()));
+            if(cx >= x0 && cx <= x1 && cy >= y0 && cy <= y1)
+                collect(*it);
+        }
+        return ret;
+    }
+
+    for(int cy = y0; cy <= y1; cy++)
+    {
+        for(int cx = x0; cx <= x1; cx++)
+        {
+            auto it = cells_.constFind(key(cx, cy));
+            if(it != cells_.constEnd())
+                collect(*it);
+        }
+    }
+    return ret;
+}
+
+template<typename T>
+void QDataflowGridIndex<T>::setCells(T item, QVector<CellKey> &&cells)
+{
+    auto it = itemCells_.find(item);
+    if(it != itemCells_.end())
+    {
+        if(*it == cells) return;
+        remove(item);
+    }
+    for(CellKey k : cells)
+        cells_[k].push_back(item);
+    itemCells_.insert(item, std::move(cells));
+}
+
+template<typename T>
+QRectF QDataflowGridIndex<T>::bounds() const
+{
+    if(cells_.isEmpty()) return {};
+    int x0 = std::numeric_limits<int>::max(), y0 = x0;
+    int x1 = std::numeric_limits<int>::min(), y1 = x1;
+    for(auto it = cells_.constBegin(); it != cells_.constEnd(); ++it)
+    {
+        const int cx = int(quint32(it.key() >> 32)), cy = int(quint32(it.key()));
+        x0 = qMin(x0, cx);
+        x1 = qMax(x1, cx);
+        y0 = qMin(y0, cy);
+        y1 = qMax(y1, cy);
+    }
+    return QRectF(x0 * cellSize_, y0 * cellSize_, (x1 - x0 + 1) * cellSize_, (y1 - y0 + 1) * cellSize_);
+}
+
+template class QDataflowGridIndex<QGraphicsItem*>;
+template class QDataflowGridIndex<int>;
@@ -0,0 +1,66 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWSCENEINDEX_H
+#define QDATAFLOWSCENEINDEX_H
+
+#include <QHash>
+#include <QLineF>
+#include <QList>
+#include <QRectF>
+#include <QVector>
+
+class QGraphicsItem;
+
+// Uniform grid over scene coordinates. Entries are filed under every cell
+// their rect covers (nodes) or their segment passes through (connections),
+// and are re-filed only when that set of cells changes, which suits many
+// small entries that move one at a time. The canvas files its items, and
+// with lazy items also the graph ids of the nodes and edges that have none.
+template<typename T>
+class QDataflowGridIndex
+{
+public:
+    explicit QDataflowGridIndex(qreal cellSize = 128);
+
+    void insert(T entry, const QRectF &sceneRect);
+    void insert(T entry, const QLineF &sceneLine);
+    void remove(T entry);
+    void clear();
+
+    // candidates whose cells overlap the rect; callers do the exact test
+    QList<T> items(const QRectF &sceneRect) const;
+
+    QList<T> items() const {return itemCells_.keys();}
+
+    // the cells in use, or a null rect when the index is empty
+    QRectF bounds() const;
+
+private:
+    typedef quint64 CellKey;
+
+    int cellCoord(qreal v) const;
+    static CellKey key(int cx, int cy);
+    void setCells(T entry, QVector<CellKey> &&cells);
+
+    qreal cellSize_;
+    QHash<CellKey, QVector<T>> cells_;
+    QHash<T, QVector<CellKey>> itemCells_;
+};
+
+typedef QDataflowGridIndex<QGraphicsItem*> QDataflowSceneIndex;
+
+#endif // QDATAFLOWSCENEINDEX_H
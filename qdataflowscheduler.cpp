@@ -0,0 +1,272 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowscheduler.h"
+#include "qdataflowmodel.h"
+
+#include <QThread>
+
+// messages handled before a busy meta object goes back to the queue
+static const int schedulerBatchSize = 64;
+
+class QDataflowSchedulerWorker : public QThread
+{
+public:
+    QDataflowSchedulerWorker(QDataflowScheduler *scheduler, int index)
+        : scheduler_(scheduler), index_(index) {}
+
+    QDataflowScheduler * scheduler() const {return scheduler_;}
+    int index() const {return index_;}
+
+    static thread_local QDataflowSchedulerWorker *current;
+
+protected:
+    void run() override;
+
+private:
+    QDataflowScheduler *scheduler_;
+    int index_;
+};
+
+thread_local QDataflowSchedulerWorker *QDataflowSchedulerWorker::current = nullptr;
+
+void QDataflowSchedulerWorker::run()
+{
+    current = this;
+
+    QDataflowScheduler *s = scheduler_;
+    while(!s->stopping_)
+    {
+        if(QDataflowMetaObject *mo = s->take(index_))
+        {
+            s->run(mo);
+            continue;
+        }
+
+        // sleepingWorkers_ is raised before queuedTasks_ is checked, and
+        // schedule() raises queuedTasks_ before checking sleepingWorkers_,
+        // so at least one side sees the other and no wakeup is lost
+        QMutexLocker locker(&s->idleMutex_);
+        s->sleepingWorkers_++;
+        if(!s->stopping_ && s->queuedTasks_ == 0)
+            s->workAvailable_.wait(&s->idleMutex_);
+        s->sleepingWorkers_--;
+    }
+
+    current = nullptr;
+}
+
+QDataflowScheduler::QDataflowScheduler(int workerCount, QObject *parent)
+    : QObject(parent), queuedTasks_(0), activeTasks_(0), sleepingWorkers_(0), nextQueue_(0), stopping_(false)
+{
+    if(workerCount <= 0)
+        workerCount = qMax(1, QThread::idealThreadCount());
+
+    for(int i = 0; i < workerCount; i++)
+        queues_.push_back(new TaskQueue);
+
+    for(int i = 0; i < workerCount; i++)
+    {
+        QDataflowSchedulerWorker *worker = new QDataflowSchedulerWorker(this, i);
+        workers_.push_back(worker);
+        worker->start();
+    }
+}
+
+QDataflowScheduler::~QDataflowScheduler()
+{
+    stopping_ = true;
+    {
+        QMutexLocker locker(&idleMutex_);
+        workAvailable_.wakeAll();
+    }
+
+    for(auto *worker : workers_)
+    {
+        worker->wait();
+        delete worker;
+    }
+
+    qDeleteAll(queues_);
+}
+
+int QDataflowScheduler::workerCount() const
+{
+    return workers_.size();
+}
+
+void QDataflowScheduler::post(QDataflowMetaObject *mo, int inlet, const QDataflowMessage &message)
+{
+    if(!mo) return;
+
+    // a Block queue only holds back producers outside the pool: a worker
+    // waiting on a full queue could be the one that would drain it, so its
+    // message overflows into the mailbox instead
+    QDataflowModelInlet *in = mo->inlet(inlet);
+    QDataflowInletQueue *queue = in ? in->queue() : nullptr;
+    // the worker merges the queues and the mailbox back into this order
+    const quint64 order = mo->sendOrder_.fetch_add(1, std::memory_order_relaxed);
+    int depth;
+    if(queue && queue->push(message, order, !isWorkerThread()))
+    {
+        depth = queue->size();
+    }
+    else
+    {
+        QDataflowScheduledMessage msg;
+        msg.inlet = inlet;
+        msg.message = message;
+        msg.order = order;
+        QMutexLocker locker(&mo->mailboxMutex_);
+        mo->mailbox_.enqueue(std::move(msg));
+        depth = mo->mailbox_.size();
+    }
+
+#ifndef QDATAFLOW_NO_PROFILING
+    QDataflowProfiler *profiler = mo->node()->model()->profiler();
+    if(profiler->isEnabled())
+        profiler->recordQueueDepth(mo->node()->id(), depth);
+#else
+    Q_UNUSED(depth);
+#endif
+
+    if(!mo->scheduled_.exchange(true))
+    {
+        activeTasks_++;
+        schedule(mo);
+    }
+}
+
+void QDataflowScheduler::waitForIdle()
+{
+    if(isWorkerThread()) return;
+
+    QMutexLocker locker(&idleMutex_);
+    while(activeTasks_ > 0)
+        idle_.wait(&idleMutex_);
+}
+
+bool QDataflowScheduler::isWorkerThread() const
+{
+    QDataflowSchedulerWorker *worker = QDataflowSchedulerWorker::current;
+    return worker && worker->scheduler() == this;
+}
+
+void QDataflowScheduler::schedule(QDataflowMetaObject *mo, bool fair)
+{
+    // messages sent from a worker stay on that worker's deque, so a chain
+    // runs on one core until someone steals from it. The ones coming from
+    // outside go to the deque of their connected component: independent
+    // parts of the graph start on separate cores, and the work of one part
+    // stays together
+    QDataflowSchedulerWorker *worker = QDataflowSchedulerWorker::current;
+    int index;
+    if(worker && worker->scheduler() == this)
+    {
+        index = worker->index();
+    }
+    else
+    {
+        const int component = mo->node()->model()->analysis().componentOf(mo->node()->id());
+        index = component >= 0
+                ? int(unsigned(component) % unsigned(queues_.size()))
+                : int(nextQueue_++ % unsigned(queues_.size()));
+    }
+
+    queuedTasks_++;
+    {
+        TaskQueue *queue = queues_[index];
+        QMutexLocker locker(&queue->mutex);
+        if(fair) queue->tasks.push_front(mo);
+        else queue->tasks.push_back(mo);
+    }
+
+    if(sleepingWorkers_ > 0)
+    {
+        QMutexLocker locker(&idleMutex_);
+        workAvailable_.wakeOne();
+    }
+}
+
+QDataflowMetaObject * QDataflowScheduler::take(int workerIndex)
+{
+    const int n = queues_.size();
+    for(int i = 0; i < n; i++)
+    {
+        TaskQueue *queue = queues_[(workerIndex + i) % n];
+        QMutexLocker locker(&queue->mutex);
+        if(queue->tasks.empty()) continue;
+
+        QDataflowMetaObject *mo;
+        if(i == 0)
+        {
+            mo = queue->tasks.back();
+            queue->tasks.pop_back();
+        }
+        else
+        {
+            mo = queue->tasks.front();
+            queue->tasks.pop_front();
+        }
+        queuedTasks_--;
+        return mo;
+    }
+    return {};
+}
+
+void QDataflowScheduler::run(QDataflowMetaObject *mo)
+{
+    for(int processed = 0; ; )
+    {
+        if(processed == schedulerBatchSize)
+        {
+            if(mo->hasMessages())
+            {
+                // still scheduled: requeue at the stealing end to let others run
+                schedule(mo, true);
+                return;
+            }
+            processed = 0;
+        }
+
+        QDataflowScheduledMessage msg;
+        if(mo->takeMessage(msg))
+        {
+            mo->receive(msg.inlet, msg.message);
+            processed++;
+            continue;
+        }
+
+        // a producer that still saw the flag set did not schedule us, so
+        // look once more after clearing it. Nothing is staged now, and
+        // another worker may already be running mo and staging messages,
+        // so only the queues and the mailbox are looked at
+        mo->scheduled_ = false;
+        if(!mo->hasIncomingMessages() || mo->scheduled_.exchange(true))
+            break;
+    }
+
+    finished();
+}
+
+void QDataflowScheduler::finished()
+{
+    if(--activeTasks_ == 0)
+    {
+        QMutexLocker locker(&idleMutex_);
+        idle_.wakeAll();
+    }
+}
@@ -0,0 +1,93 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWSCHEDULER_H
+#define QDATAFLOWSCHEDULER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <atomic>
+#include <deque>
+
+class QDataflowMessage;
+class QDataflowMetaObject;
+class QDataflowSchedulerWorker;
+
+// Runs QDataflowMetaObject message handlers on a pool of worker threads.
+//
+// Every meta object has a mailbox. A meta object with pending messages is a
+// task; tasks live in per-worker deques, the owner takes from the back and
+// idle workers steal from the front. A meta object is only ever run by one
+// worker at a time, so messages to the same inlet are handled in the order
+// they were sent, while independent branches of the graph run in parallel.
+//
+// Inlets with a QDataflowInletQueue bypass the mailbox: producers push
+// without a lock, and the queue's policy applies when it is full. Messages
+// are numbered as they are sent, and the worker takes the oldest one from
+// the queues and the mailbox, so the order holds across them.
+//
+// Messages posted from outside the pool are queued by the connected
+// component of their receiver (QDataflowGraphAnalysis::componentOf()):
+// independent parts of the graph are spread over the workers, and the work
+// of one part starts on one worker.
+//
+// The graph must not be edited while messages are in flight: call
+// waitForIdle() first. Meta objects attached to a scheduled model must not
+// touch widgets from onDataReceved().
+class QDataflowScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    // workerCount <= 0 uses QThread::idealThreadCount()
+    explicit QDataflowScheduler(int workerCount = 0, QObject *parent = {});
+    ~QDataflowScheduler() override;
+
+    int workerCount() const;
+
+    void post(QDataflowMetaObject *mo, int inlet, const QDataflowMessage &message);
+    void waitForIdle();
+
+    bool isWorkerThread() const;
+
+private:
+    void schedule(QDataflowMetaObject *mo, bool fair = false);
+    QDataflowMetaObject * take(int workerIndex);
+    void run(QDataflowMetaObject *mo);
+    void finished();
+
+    struct TaskQueue
+    {
+        QMutex mutex;
+        std::deque<QDataflowMetaObject*> tasks;
+    };
+
+    QVector<QDataflowSchedulerWorker*> workers_;
+    QVector<TaskQueue*> queues_;
+    std::atomic<int> queuedTasks_;
+    std::atomic<int> activeTasks_;
+    std::atomic<int> sleepingWorkers_;
+    std::atomic<unsigned> nextQueue_;
+    std::atomic<bool> stopping_;
+    QMutex idleMutex_;
+    QWaitCondition workAvailable_;
+    QWaitCondition idle_;
+
+    friend class QDataflowSchedulerWorker;
+};
+
+#endif // QDATAFLOWSCHEDULER_H
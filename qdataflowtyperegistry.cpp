@@ -0,0 +1,76 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowtyperegistry.h"
+
+QDataflowTypeRegistry::QDataflowTypeRegistry()
+    : matrixStride_(0), matrixValid_(false)
+{
+    intern(QStringLiteral("*"));
+    // in the order of QDataflowMessage::Type, from Bang to Samples
+    for(const char *name : {"bang", "int", "double", "bool", "string", "bytes", "samples"})
+        intern(QString::fromLatin1(name));
+}
+
+QDataflowTypeRegistry::TypeId QDataflowTypeRegistry::intern(const QString &type)
+{
+    auto it = ids_.constFind(type);
+    if(it != ids_.constEnd()) return *it;
+    const TypeId id = names_.size();
+    names_.push_back(type);
+    ids_.insert(type, id);
+    matrixValid_ = false;
+    return id;
+}
+
+QDataflowTypeRegistry::TypeId QDataflowTypeRegistry::id(const QString &type) const
+{
+    return ids_.value(type, InvalidId);
+}
+
+const QString & QDataflowTypeRegistry::name(TypeId type) const
+{
+    static const QString none;
+    if(type < 0 || type >= names_.size()) return none;
+    return names_[type];
+}
+
+void QDataflowTypeRegistry::addConversion(TypeId from, TypeId to)
+{
+    if(from < 0 || to < 0 || from >= names_.size() || to >= names_.size()) return;
+    conversions_.push_back(qMakePair(from, to));
+    matrixValid_ = false;
+}
+
+void QDataflowTypeRegistry::buildMatrix() const
+{
+    const int n = names_.size();
+    matrixStride_ = (n + 63) / 64;
+    matrix_.fill(0, n * matrixStride_);
+
+    auto set = [&](TypeId from, TypeId to) {
+        matrix_[from * matrixStride_ + to / 64] |= quint64(1) << (to % 64);
+    };
+    for(TypeId t = 0; t < n; t++)
+    {
+        set(t, t);
+        set(t, AnyType);
+    }
+    for(auto &conversion : conversions_)
+        set(conversion.first, conversion.second);
+
+    matrixValid_ = true;
+}
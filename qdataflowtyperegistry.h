@@ -0,0 +1,74 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWTYPEREGISTRY_H
+#define QDATAFLOWTYPEREGISTRY_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// Interns iolet type names as small integer ids and answers whether an
+// outlet type may connect to an inlet type from a bit matrix.
+//
+// The rules are: an inlet of type "*" accepts any outlet, equal types
+// connect, and so does every pair added with addConversion(). The matrix
+// is rebuilt on the first query after a type or a rule is added, so checks
+// made while dragging a connection are a single bit test.
+class QDataflowTypeRegistry
+{
+public:
+    typedef int TypeId;
+
+    // "*" is interned first, then the built-in message types at the ids
+    // QDataflowMessage::typeId() returns
+    enum {InvalidId = -1, AnyType = 0};
+
+    QDataflowTypeRegistry();
+
+    TypeId intern(const QString &type);
+    TypeId id(const QString &type) const;
+    const QString & name(TypeId type) const;
+    int count() const {return names_.size();}
+
+    // outlets of type from may connect to inlets of type to; conversions
+    // do not chain
+    void addConversion(TypeId from, TypeId to);
+
+    bool isCompatible(TypeId outletType, TypeId inletType) const;
+
+private:
+    void buildMatrix() const;
+
+    QHash<QString, TypeId> ids_;
+    QVector<QString> names_;
+    QVector<QPair<TypeId, TypeId>> conversions_;
+
+    // row per outlet type, one bit per inlet type
+    mutable QVector<quint64> matrix_;
+    mutable int matrixStride_;
+    mutable bool matrixValid_;
+};
+
+inline bool QDataflowTypeRegistry::isCompatible(TypeId outletType, TypeId inletType) const
+{
+    if(outletType < 0 || inletType < 0 || outletType >= names_.size() || inletType >= names_.size()) return false;
+    if(!matrixValid_) buildMatrix();
+    return matrix_[outletType * matrixStride_ + inletType / 64] & (quint64(1) << (inletType % 64));
+}
+
+#endif // QDATAFLOWTYPEREGISTRY_H
@@ -0,0 +1,700 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowundolog.h"
+#include "qdataflowmodel.h"
+#include "utility.h"
+
+#include <QDataStream>
+#include <QIODevice>
+#include <QSet>
+
+static const quint32 journalMagic = 0x51444a31; // "QDJ1"
+static const QDataStream::Version streamVersion = QDataStream::Qt_5_0;
+// deque slot and QByteArray header, charged to every command
+static const qint64 commandOverhead = 32;
+
+quint32 QDataflowUndoLog::NodeKeys::key(int node)
+{
+    auto it = keys_.constFind(node);
+    if(it != keys_.constEnd()) return *it;
+    bind(next_, node);
+    return next_ - 1;
+}
+
+int QDataflowUndoLog::NodeKeys::node(quint32 key) const
+{
+    return nodes_.value(key, QDataflowGraph::InvalidId);
+}
+
+void QDataflowUndoLog::NodeKeys::bind(quint32 key, int node)
+{
+    keys_.insert(node, key);
+    nodes_.insert(key, node);
+    if(key >= next_) next_ = key + 1;
+}
+
+void QDataflowUndoLog::NodeKeys::unbind(int node)
+{
+    auto it = keys_.find(node);
+    if(it == keys_.end()) return;
+    nodes_.remove(*it);
+    keys_.erase(it);
+}
+
+void QDataflowUndoLog::NodeKeys::clear()
+{
+    keys_.clear();
+    nodes_.clear();
+    next_ = 0;
+}
+
+QDataflowUndoLog::QDataflowUndoLog(QDataflowModel *model)
+    : model_(model), enabled_(false), applying_(false), depth_(0), ioletDepth_(0), undoBytes_(0), redoBytes_(0),
+      commandLimit_(1000), memoryLimit_(16 << 20), journal_()
+{
+}
+
+QDataflowUndoLog::~QDataflowUndoLog()
+{
+}
+
+bool QDataflowUndoLog::isEnabled() const
+{
+    return enabled_;
+}
+
+void QDataflowUndoLog::setEnabled(bool enabled)
+{
+    if(enabled_ == enabled) return;
+    enabled_ = enabled;
+    if(enabled_) return;
+    // keys of nodes removed while not recording could not be dropped
+    clear();
+    keys_.clear();
+    journal_ = nullptr;
+}
+
+bool QDataflowUndoLog::canUndo() const
+{
+    return !undo_.empty();
+}
+
+bool QDataflowUndoLog::canRedo() const
+{
+    return !redo_.empty();
+}
+
+int QDataflowUndoLog::undoCount() const
+{
+    return int(undo_.size());
+}
+
+int QDataflowUndoLog::redoCount() const
+{
+    return int(redo_.size());
+}
+
+void QDataflowUndoLog::undo()
+{
+    if(undo_.empty()) return;
+    if(depth_ > 0)
+    {
+        qWarning() << "QDataflowUndoLog: cannot undo while a command is being recorded";
+        return;
+    }
+    const QByteArray command = undo_.back();
+    undo_.pop_back();
+    undoBytes_ -= command.size() + commandOverhead;
+    QVector<Op> ops;
+    if(!decode(command, &ops))
+    {
+        qWarning() << "QDataflowUndoLog: corrupt command";
+        return;
+    }
+    applying_ = true;
+    apply(model_, keys_, ops, true);
+    applying_ = false;
+    if(ops.isEmpty()) return;
+    // removals have picked up the current state of the nodes for redo
+    push(redo_, redoBytes_, encode(ops));
+    writeJournal(encode(inverse(ops)));
+    trim();
+}
+
+void QDataflowUndoLog::redo()
+{
+    if(redo_.empty()) return;
+    if(depth_ > 0)
+    {
+        qWarning() << "QDataflowUndoLog: cannot redo while a command is being recorded";
+        return;
+    }
+    const QByteArray command = redo_.back();
+    redo_.pop_back();
+    redoBytes_ -= command.size() + commandOverhead;
+    QVector<Op> ops;
+    if(!decode(command, &ops))
+    {
+        qWarning() << "QDataflowUndoLog: corrupt command";
+        return;
+    }
+    applying_ = true;
+    apply(model_, keys_, ops, false);
+    applying_ = false;
+    if(ops.isEmpty()) return;
+    const QByteArray applied = encode(ops);
+    push(undo_, undoBytes_, applied);
+    writeJournal(applied);
+    trim();
+}
+
+void QDataflowUndoLog::clear()
+{
+    current_.clear();
+    currentMoves_.clear();
+    currentTexts_.clear();
+    undo_.clear();
+    redo_.clear();
+    undoBytes_ = redoBytes_ = 0;
+}
+
+void QDataflowUndoLog::beginCommand()
+{
+    depth_++;
+}
+
+void QDataflowUndoLog::endCommand()
+{
+    if(depth_ <= 0) return;
+    if(--depth_ == 0) closeCommand();
+}
+
+int QDataflowUndoLog::commandLimit() const
+{
+    return commandLimit_;
+}
+
+void QDataflowUndoLog::setCommandLimit(int commands)
+{
+    commandLimit_ = qMax(0, commands);
+    trim();
+}
+
+qint64 QDataflowUndoLog::memoryLimit() const
+{
+    return memoryLimit_;
+}
+
+void QDataflowUndoLog::setMemoryLimit(qint64 bytes)
+{
+    memoryLimit_ = qMax(qint64(0), bytes);
+    trim();
+}
+
+qint64 QDataflowUndoLog::memoryUsage() const
+{
+    return undoBytes_ + redoBytes_;
+}
+
+QIODevice * QDataflowUndoLog::journal() const
+{
+    return journal_;
+}
+
+void QDataflowUndoLog::setJournal(QIODevice *device)
+{
+    journal_ = device;
+    if(!journal_) return;
+
+    // the nodes present now, in graph id order, are the ones a reload of
+    // the patch saved now creates in the same order
+    QVector<quint32> base;
+    const QDataflowGraph &graph = model_->graph();
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+        if(graph.containsNode(id))
+            base.push_back(keys_.key(id));
+
+    QDataStream out(journal_);
+    out.setVersion(streamVersion);
+    out << journalMagic << quint32(base.size());
+    for(quint32 key : as_const(base))
+        out << key;
+}
+
+bool QDataflowUndoLog::replay(QDataflowModel *model, QIODevice *device)
+{
+    if(!model || !device) return false;
+    QDataStream in(device);
+    in.setVersion(streamVersion);
+    quint32 magic = 0, count = 0;
+    in >> magic >> count;
+    if(in.status() != QDataStream::Ok || magic != journalMagic)
+    {
+        qWarning() << "QDataflowUndoLog: not a journal";
+        return false;
+    }
+
+    QVector<int> base;
+    const QDataflowGraph &graph = model->graph();
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+        if(graph.containsNode(id))
+            base.push_back(id);
+    if(quint32(base.size()) != count)
+    {
+        qWarning() << "QDataflowUndoLog: journal was started on" << count << "nodes, the model has" << base.size();
+        return false;
+    }
+    NodeKeys keys;
+    for(int node : as_const(base))
+    {
+        quint32 key = 0;
+        in >> key;
+        keys.bind(key, node);
+    }
+    if(in.status() != QDataStream::Ok)
+    {
+        qWarning() << "QDataflowUndoLog: truncated journal header";
+        return false;
+    }
+
+    QDataflowUndoLog *log = model->undoLog();
+    const bool applying = log->applying_;
+    log->applying_ = true;
+    bool ok = true;
+    {
+        QDataflowModelTransaction transaction(model);
+        while(!in.atEnd())
+        {
+            QByteArray command;
+            in >> command;
+            QVector<Op> ops;
+            if(in.status() != QDataStream::Ok || !decode(command, &ops))
+            {
+                qWarning() << "QDataflowUndoLog: journal ends in a truncated or invalid record";
+                ok = false;
+                break;
+            }
+            apply(model, keys, ops, false);
+        }
+    }
+    log->applying_ = applying;
+    return ok;
+}
+
+void QDataflowUndoLog::recordCreate(int node)
+{
+    if(!isRecording()) return;
+    Op op{};
+    op.type = Op::CreateNode;
+    op.node = keys_.key(node);
+    op.state = stateOf(model_->graph(), node);
+    append(std::move(op));
+}
+
+void QDataflowUndoLog::recordRemove(int node)
+{
+    if(!isRecording()) return;
+    Op op{};
+    op.type = Op::RemoveNode;
+    op.node = keys_.key(node);
+    op.state = stateOf(model_->graph(), node);
+    keys_.unbind(node);
+    append(std::move(op));
+}
+
+void QDataflowUndoLog::recordMove(int node, const QPoint &from, const QPoint &to)
+{
+    if(!isRecording()) return;
+    Op op{};
+    op.type = Op::MoveNode;
+    op.node = keys_.key(node);
+    op.from = from;
+    op.to = to;
+    append(std::move(op));
+}
+
+void QDataflowUndoLog::recordText(int node, const QString &from, const QString &to)
+{
+    if(!isRecording()) return;
+    Op op{};
+    op.type = Op::SetText;
+    op.node = keys_.key(node);
+    op.oldText = from;
+    op.state.text = to;
+    append(std::move(op));
+}
+
+void QDataflowUndoLog::recordConnect(int source, int outlet, int dest, int inlet)
+{
+    if(!isRecording()) return;
+    Op op{};
+    op.type = Op::Connect;
+    op.node = keys_.key(source);
+    op.outlet = outlet;
+    op.dest = keys_.key(dest);
+    op.inlet = inlet;
+    append(std::move(op));
+}
+
+void QDataflowUndoLog::recordDisconnect(int source, int outlet, int dest, int inlet)
+{
+    if(!isRecording()) return;
+    Op op{};
+    op.type = Op::Disconnect;
+    op.node = keys_.key(source);
+    op.outlet = outlet;
+    op.dest = keys_.key(dest);
+    op.inlet = inlet;
+    append(std::move(op));
+}
+
+void QDataflowUndoLog::beginIoletChange(int node)
+{
+    if(ioletDepth_++ > 0 || !isRecording()) return;
+    ioletsBefore_ = stateOf(model_->graph(), node);
+}
+
+void QDataflowUndoLog::endIoletChange(int node)
+{
+    if(ioletDepth_ <= 0 || --ioletDepth_ > 0 || !isRecording()) return;
+    const NodeState after = stateOf(model_->graph(), node);
+    if(after.inletTypes == ioletsBefore_.inletTypes && after.outletTypes == ioletsBefore_.outletTypes) return;
+    Op op{};
+    op.type = Op::SetIoletTypes;
+    op.node = keys_.key(node);
+    op.oldInletTypes = ioletsBefore_.inletTypes;
+    op.oldOutletTypes = ioletsBefore_.outletTypes;
+    op.state.inletTypes = after.inletTypes;
+    op.state.outletTypes = after.outletTypes;
+    append(std::move(op));
+}
+
+bool QDataflowUndoLog::isRecording() const
+{
+    return enabled_ && !applying_;
+}
+
+void QDataflowUndoLog::append(Op &&op)
+{
+    // a drag moves the same nodes on every frame; keep the first position
+    // and the last one
+    if(op.type == Op::MoveNode)
+    {
+        auto it = currentMoves_.constFind(op.node);
+        if(it != currentMoves_.constEnd())
+        {
+            current_[*it].to = op.to;
+            return;
+        }
+        currentMoves_.insert(op.node, current_.size());
+    }
+    else if(op.type == Op::SetText)
+    {
+        auto it = currentTexts_.constFind(op.node);
+        if(it != currentTexts_.constEnd())
+        {
+            current_[*it].state.text = op.state.text;
+            return;
+        }
+        currentTexts_.insert(op.node, current_.size());
+    }
+    current_.push_back(std::move(op));
+    if(depth_ == 0) closeCommand();
+}
+
+void QDataflowUndoLog::closeCommand()
+{
+    if(current_.isEmpty()) return;
+    QVector<Op> ops;
+    ops.reserve(current_.size());
+    QSet<quint32> created;
+    for(Op &op : current_)
+    {
+        switch(op.type)
+        {
+        case Op::CreateNode:
+            // the application sets up a new node, iolet types included,
+            // after it was added
+            if(model_->graph().containsNode(keys_.node(op.node)))
+                op.state = stateOf(model_->graph(), keys_.node(op.node));
+            created.insert(op.node);
+            break;
+        case Op::SetIoletTypes:
+            if(created.contains(op.node)) continue;
+            break;
+        case Op::MoveNode:
+            if(op.from == op.to) continue;
+            break;
+        case Op::SetText:
+            if(op.oldText == op.state.text) continue;
+            break;
+        default:
+            break;
+        }
+        ops.push_back(std::move(op));
+    }
+    current_.clear();
+    currentMoves_.clear();
+    currentTexts_.clear();
+    if(ops.isEmpty()) return;
+
+    const QByteArray command = encode(ops);
+    redo_.clear();
+    redoBytes_ = 0;
+    push(undo_, undoBytes_, command);
+    writeJournal(command);
+    trim();
+}
+
+void QDataflowUndoLog::push(std::deque<QByteArray> &stack, qint64 &bytes, const QByteArray &command)
+{
+    stack.push_back(command);
+    bytes += command.size() + commandOverhead;
+}
+
+void QDataflowUndoLog::trim()
+{
+    // each stack holds at most commandLimit() commands; over the memory
+    // limit the oldest undo commands go first, then the furthest redo ones
+    while(!undo_.empty() && (int(undo_.size()) > commandLimit_ || memoryUsage() > memoryLimit_))
+    {
+        undoBytes_ -= undo_.front().size() + commandOverhead;
+        undo_.pop_front();
+    }
+    while(!redo_.empty() && (int(redo_.size()) > commandLimit_ || memoryUsage() > memoryLimit_))
+    {
+        redoBytes_ -= redo_.front().size() + commandOverhead;
+        redo_.pop_front();
+    }
+}
+
+void QDataflowUndoLog::writeJournal(const QByteArray &command)
+{
+    if(!journal_) return;
+    QDataStream out(journal_);
+    out.setVersion(streamVersion);
+    out << command;
+}
+
+QDataflowUndoLog::NodeState QDataflowUndoLog::stateOf(const QDataflowGraph &graph, int node)
+{
+    NodeState state;
+    state.pos = graph.pos(node);
+    state.text = graph.text(node);
+    for(int i = 0; i < graph.inletCount(node); i++)
+        state.inletTypes << graph.typeName(graph.inletType(node, i));
+    for(int i = 0; i < graph.outletCount(node); i++)
+        state.outletTypes << graph.typeName(graph.outletType(node, i));
+    return state;
+}
+
+// a command is the op count followed by the ops, each a type byte and the
+// node key, then:
+//   create, remove     pos, text, inlet types, outlet types
+//   move               from, to
+//   set text           old text, new text
+//   set iolet types    old inlet and outlet types, new inlet and outlet types
+//   connect/disconnect outlet, dest key, inlet
+QByteArray QDataflowUndoLog::encode(const QVector<Op> &ops)
+{
+    QByteArray command;
+    QDataStream out(&command, QIODevice::WriteOnly);
+    out.setVersion(streamVersion);
+    out << quint32(ops.size());
+    for(const Op &op : ops)
+    {
+        out << quint8(op.type) << op.node;
+        switch(op.type)
+        {
+        case Op::CreateNode:
+        case Op::RemoveNode:
+            out << op.state.pos << op.state.text << op.state.inletTypes << op.state.outletTypes;
+            break;
+        case Op::MoveNode:
+            out << op.from << op.to;
+            break;
+        case Op::SetText:
+            out << op.oldText << op.state.text;
+            break;
+        case Op::Connect:
+        case Op::Disconnect:
+            out << op.outlet << op.dest << op.inlet;
+            break;
+        case Op::SetIoletTypes:
+            out << op.oldInletTypes << op.oldOutletTypes << op.state.inletTypes << op.state.outletTypes;
+            break;
+        }
+    }
+    return command;
+}
+
+bool QDataflowUndoLog::decode(const QByteArray &command, QVector<Op> *ops)
+{
+    QDataStream in(command);
+    in.setVersion(streamVersion);
+    quint32 count = 0;
+    in >> count;
+    // every op takes at least five bytes
+    if(count > quint32(command.size()) / 5) return false;
+    ops->reserve(int(count));
+    for(quint32 i = 0; i < count; i++)
+    {
+        Op op{};
+        quint8 type = 0;
+        in >> type >> op.node;
+        op.type = Op::Type(type);
+        switch(op.type)
+        {
+        case Op::CreateNode:
+        case Op::RemoveNode:
+            in >> op.state.pos >> op.state.text >> op.state.inletTypes >> op.state.outletTypes;
+            break;
+        case Op::MoveNode:
+            in >> op.from >> op.to;
+            break;
+        case Op::SetText:
+            in >> op.oldText >> op.state.text;
+            break;
+        case Op::Connect:
+        case Op::Disconnect:
+            in >> op.outlet >> op.dest >> op.inlet;
+            break;
+        case Op::SetIoletTypes:
+            in >> op.oldInletTypes >> op.oldOutletTypes >> op.state.inletTypes >> op.state.outletTypes;
+            break;
+        default:
+            return false;
+        }
+        if(in.status() != QDataStream::Ok) return false;
+        ops->push_back(std::move(op));
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+void QDataflowUndoLog::apply(QDataflowModel *model, NodeKeys &keys, QVector<Op> &ops, bool backward)
+{
+    // nodes and connections are created by id, so that replaying a journal
+    // on a patch loaded by id creates no node objects; the rest goes
+    // through the nodes' objects like any other edit
+    QDataflowModelTransaction transaction(model);
+    const QDataflowGraph &graph = model->graph();
+    QVector<bool> applied(ops.size(), false);
+    for(int n = 0; n < ops.size(); n++)
+    {
+        const int i = backward ? ops.size() - 1 - n : n;
+        Op &op = ops[i];
+        Op::Type type = op.type;
+        if(backward)
+        {
+            switch(type)
+            {
+            case Op::CreateNode: type = Op::RemoveNode; break;
+            case Op::RemoveNode: type = Op::CreateNode; break;
+            case Op::Connect: type = Op::Disconnect; break;
+            case Op::Disconnect: type = Op::Connect; break;
+            default: break;
+            }
+        }
+        const int id = keys.node(op.node);
+        switch(type)
+        {
+        case Op::CreateNode:
+        {
+            const int created = model->createNode(op.state.pos, op.state.text, op.state.inletTypes, op.state.outletTypes);
+            if(created != QDataflowGraph::InvalidId)
+            {
+                keys.bind(op.node, created);
+                applied[i] = true;
+            }
+            break;
+        }
+        case Op::RemoveNode:
+            if(QDataflowModelNode *node = model->nodeById(id))
+            {
+                op.state = stateOf(graph, id);
+                keys.unbind(id);
+                model->remove(node);
+                applied[i] = true;
+            }
+            break;
+        case Op::MoveNode:
+            if(QDataflowModelNode *node = model->nodeById(id))
+            {
+                node->setPos(backward ? op.from : op.to);
+                applied[i] = true;
+            }
+            break;
+        case Op::SetText:
+            if(QDataflowModelNode *node = model->nodeById(id))
+            {
+                node->setText(backward ? op.oldText : op.state.text);
+                applied[i] = true;
+            }
+            break;
+        case Op::SetIoletTypes:
+            if(QDataflowModelNode *node = model->nodeById(id))
+            {
+                node->setInletTypes(backward ? op.oldInletTypes : op.state.inletTypes);
+                node->setOutletTypes(backward ? op.oldOutletTypes : op.state.outletTypes);
+                applied[i] = true;
+            }
+            break;
+        case Op::Connect:
+            applied[i] = model->connectNodes(id, op.outlet, keys.node(op.dest), op.inlet) != QDataflowGraph::InvalidId;
+            break;
+        case Op::Disconnect:
+            if(QDataflowModelConnection *conn = model->connectionById(graph.findEdge(id, op.outlet, keys.node(op.dest), op.inlet)))
+            {
+                model->disconnect(conn);
+                applied[i] = true;
+            }
+            break;
+        }
+    }
+
+    // the command that goes on the other stack holds only what was done
+    QVector<Op> done;
+    done.reserve(ops.size());
+    for(int i = 0; i < ops.size(); i++)
+        if(applied[i]) done.push_back(std::move(ops[i]));
+    ops.swap(done);
+}
+
+QVector<QDataflowUndoLog::Op> QDataflowUndoLog::inverse(const QVector<Op> &ops)
+{
+    QVector<Op> inv;
+    inv.reserve(ops.size());
+    for(int i = ops.size() - 1; i >= 0; i--)
+    {
+        Op op = ops[i];
+        switch(op.type)
+        {
+        case Op::CreateNode: op.type = Op::RemoveNode; break;
+        case Op::RemoveNode: op.type = Op::CreateNode; break;
+        case Op::MoveNode: std::swap(op.from, op.to); break;
+        case Op::SetText: std::swap(op.oldText, op.state.text); break;
+        case Op::SetIoletTypes:
+            std::swap(op.oldInletTypes, op.state.inletTypes);
+            std::swap(op.oldOutletTypes, op.state.outletTypes);
+            break;
+        case Op::Connect: op.type = Op::Disconnect; break;
+        case Op::Disconnect: op.type = Op::Connect; break;
+        }
+        inv.push_back(std::move(op));
+    }
+    return inv;
+}
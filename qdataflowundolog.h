@@ -0,0 +1,184 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef QDATAFLOWUNDOLOG_H
+#define QDATAFLOWUNDOLOG_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QPoint>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <deque>
+
+class QIODevice;
+class QDataflowGraph;
+class QDataflowModel;
+
+// Undo and redo history of one model (see QDataflowModel::undoLog()).
+//
+// The model reports structural edits as deltas: node created or removed,
+// moved, text changed, iolets changed, connected or disconnected. A text
+// edit is one command with the iolet changes and disconnections it causes,
+// so undoing it brings the connections back. Everything recorded
+// while a transaction or a beginCommand()/endCommand() group is open
+// becomes one command, and repeated moves of a node within a command
+// are merged, so a whole drag is one move per node and a paste is one
+// batch of creates and connects. Closed commands are kept encoded as
+// compact byte records, oldest dropped first once commandLimit() or
+// memoryLimit() is exceeded.
+//
+// Nodes are referred to by keys that survive removal and re-creation, so
+// undoing a removal and then redoing older commands still finds them. Keys
+// map to graph node ids, and recording needs no node objects.
+//
+// Recording is off until setEnabled(true).
+class QDataflowUndoLog
+{
+public:
+    explicit QDataflowUndoLog(QDataflowModel *model);
+    ~QDataflowUndoLog();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    int undoCount() const;
+    int redoCount() const;
+    void undo();
+    void redo();
+    void clear();
+
+    // nestable; the command is closed by the outermost endCommand()
+    void beginCommand();
+    void endCommand();
+
+    int commandLimit() const;
+    void setCommandLimit(int commands);
+    qint64 memoryLimit() const;
+    void setMemoryLimit(qint64 bytes);
+    // bytes held by the undo and redo commands
+    qint64 memoryUsage() const;
+
+    // appends every command applied from now on, including undo and redo
+    // as their inverse, to the device; set it right after saving the patch
+    // and replay() the journal on the reloaded patch to get back to the
+    // current state without rewriting the whole file; not owned
+    QIODevice * journal() const;
+    void setJournal(QIODevice *device);
+    // nothing is applied past a truncated or invalid record
+    static bool replay(QDataflowModel *model, QIODevice *device);
+
+private:
+    Q_DISABLE_COPY(QDataflowUndoLog)
+
+    struct NodeState
+    {
+        QPoint pos;
+        QString text;
+        QStringList inletTypes;
+        QStringList outletTypes;
+    };
+
+    struct Op
+    {
+        enum Type : quint8 {CreateNode, RemoveNode, MoveNode, SetText, Connect, Disconnect, SetIoletTypes};
+
+        Type type;
+        // the source node for connections
+        quint32 node;
+        quint32 dest;
+        qint32 outlet;
+        qint32 inlet;
+        QPoint from;
+        QPoint to;
+        QString oldText;
+        QStringList oldInletTypes;
+        QStringList oldOutletTypes;
+        // created or removed node, or the new text or iolet types
+        NodeState state;
+    };
+
+    class NodeKeys
+    {
+    public:
+        quint32 key(int node);
+        // the graph node id, InvalidId for keys of removed nodes
+        int node(quint32 key) const;
+        void bind(quint32 key, int node);
+        void unbind(int node);
+        void clear();
+
+    private:
+        QHash<int, quint32> keys_;
+        QHash<quint32, int> nodes_;
+        quint32 next_ = 0;
+    };
+
+    // by graph node id; a removal is recorded while the node is still in
+    // the graph
+    void recordCreate(int node);
+    void recordRemove(int node);
+    void recordMove(int node, const QPoint &from, const QPoint &to);
+    void recordText(int node, const QString &from, const QString &to);
+    void recordConnect(int source, int outlet, int dest, int inlet);
+    void recordDisconnect(int source, int outlet, int dest, int inlet);
+    // around every change of a node's iolets; the op goes after the
+    // disconnections the change made, so that undo restores the iolets
+    // before it reconnects
+    void beginIoletChange(int node);
+    void endIoletChange(int node);
+    bool isRecording() const;
+    void append(Op &&op);
+    void closeCommand();
+    void push(std::deque<QByteArray> &stack, qint64 &bytes, const QByteArray &command);
+    void trim();
+    void writeJournal(const QByteArray &command);
+
+    static NodeState stateOf(const QDataflowGraph &graph, int node);
+    static QByteArray encode(const QVector<Op> &ops);
+    static bool decode(const QByteArray &command, QVector<Op> *ops);
+    // drops the ops that could not be applied, such as a rejected connection
+    static void apply(QDataflowModel *model, NodeKeys &keys, QVector<Op> &ops, bool backward);
+    static QVector<Op> inverse(const QVector<Op> &ops);
+
+    QDataflowModel *model_;
+    bool enabled_;
+    bool applying_;
+    int depth_;
+    QVector<Op> current_;
+    // index in current_ of the move and text ops, by node key
+    QHash<quint32, int> currentMoves_;
+    QHash<quint32, int> currentTexts_;
+    // iolet types before the outermost iolet change in progress
+    int ioletDepth_;
+    NodeState ioletsBefore_;
+    NodeKeys keys_;
+    std::deque<QByteArray> undo_;
+    std::deque<QByteArray> redo_;
+    qint64 undoBytes_;
+    qint64 redoBytes_;
+    int commandLimit_;
+    qint64 memoryLimit_;
+    QIODevice *journal_;
+
+    friend class QDataflowModel;
+    friend class QDataflowModelNode;
+};
+
+#endif // QDATAFLOWUNDOLOG_H
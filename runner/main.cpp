@@ -0,0 +1,158 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowexamples.h"
+#include "qdataflowmodel.h"
+#include "qdataflownodefactory.h"
+#include "qdataflowpatchfile.h"
+#include "qdataflowscheduler.h"
+#include "utility.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+double percentile(const QVector<qint64> &sorted, double p)
+{
+    if(sorted.isEmpty()) return 0;
+    const int i = qBound(0, int(std::ceil(p * sorted.size())) - 1, sorted.size() - 1);
+    return sorted[i] / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Runs a QDataflowCanvas patch without a display and reports its throughput and latency."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("patch"), QStringLiteral("The .qdfp patch file to run."));
+    QCommandLineOption threadsOption(QStringLiteral("threads"), QStringLiteral("Scheduler worker threads; 0 uses one per core."), QStringLiteral("n"), QStringLiteral("0"));
+    QCommandLineOption messagesOption(QStringLiteral("messages"), QStringLiteral("Messages sent by every source for the throughput run."), QStringLiteral("n"), QStringLiteral("100000"));
+    QCommandLineOption samplesOption(QStringLiteral("latency-samples"), QStringLiteral("Single messages timed through the whole graph from every source."), QStringLiteral("n"), QStringLiteral("1000"));
+    QCommandLineOption synchronousOption(QStringLiteral("synchronous"), QStringLiteral("Deliver messages on the calling thread, without a scheduler."));
+    parser.addOption(threadsOption);
+    parser.addOption(messagesOption);
+    parser.addOption(samplesOption);
+    parser.addOption(synchronousOption);
+    parser.process(app);
+
+    if(parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+    const QString fileName = parser.positionalArguments().first();
+    const int messages = qMax(0, parser.value(messagesOption).toInt());
+    const int samples = qMax(0, parser.value(samplesOption).toInt());
+
+    QDataflowModel model;
+    model.setDispatchCompiled(true);
+    std::atomic<qint64> received(0);
+    QDataflowNodeFactory *factory = new QDataflowNodeFactory(&model);
+    QDataflowExamples::registerClasses(factory, [&received](const QDataflowMessage &) {
+        received.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    if(!QDataflowPatchFile::load(&model, fileName))
+        return 1;
+    const qint64 loadNs = timer.nsecsElapsed();
+
+    const QDataflowGraph &graph = model.graph();
+    QList<QDataflowModelNode*> sources;
+    int unknown = 0;
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+    {
+        if(!graph.containsNode(id)) continue;
+        if(!graph.isValid(id)) unknown++;
+        else if(factory->className(id) == "source") sources.push_back(model.nodeById(id));
+    }
+
+    QTextStream out(stdout);
+    out << fileName << ": " << graph.nodeCount() << " nodes, " << graph.edgeCount()
+        << " connections, loaded in " << loadNs / 1e6 << " ms\n";
+    if(unknown)
+        out << unknown << " nodes of unknown classes are not run\n";
+    if(sources.isEmpty())
+    {
+        qWarning() << "the patch has no source node";
+        return 1;
+    }
+
+    QScopedPointer<QDataflowScheduler> scheduler;
+    if(!parser.isSet(synchronousOption))
+    {
+        scheduler.reset(new QDataflowScheduler(parser.value(threadsOption).toInt()));
+        model.setScheduler(scheduler.data());
+    }
+    auto drain = [&]{
+        if(scheduler) scheduler->waitForIdle();
+    };
+
+    // meta objects, and the node objects they belong to, are created by the
+    // first message; keep that out of the timings
+    timer.restart();
+    for(int id = 0; id < graph.nodeIdBound(); id++)
+        if(graph.containsNode(id) && graph.isValid(id))
+            model.nodeById(id)->dataflowMetaObject();
+    out << "meta objects created in " << timer.nsecsElapsed() / 1e6 << " ms\n";
+
+    timer.restart();
+    for(int i = 0; i < messages; i++)
+        for(auto *source : as_const(sources))
+            source->dataflowMetaObject()->sendData(0, i);
+    drain();
+    const qint64 runNs = qMax(qint64(1), timer.nsecsElapsed());
+    const qint64 sent = qint64(messages) * sources.size();
+    out << "throughput: " << sent << " messages from " << sources.size() << " sources in " << runNs / 1e6 << " ms, "
+        << qint64(sent * 1e9 / runNs) << " messages/s, " << received.load() << " received by sinks";
+    if(scheduler)
+        out << ", " << scheduler->workerCount() << " worker threads";
+    out << "\n";
+
+    // one message at a time through the whole graph, including the wake-up
+    // of the workers; every source is timed on its own
+    QVector<qint64> latencies;
+    latencies.reserve(samples * sources.size());
+    for(int i = 0; i < samples; i++)
+    {
+        for(auto *source : as_const(sources))
+        {
+            timer.restart();
+            source->dataflowMetaObject()->sendData(0, i);
+            drain();
+            latencies.push_back(timer.nsecsElapsed());
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    if(!latencies.isEmpty())
+    {
+        out << "latency over " << latencies.size() << " messages: min " << latencies.first() / 1000.0
+            << " us, median " << percentile(latencies, 0.5) << " us, p99 " << percentile(latencies, 0.99)
+            << " us, max " << latencies.last() / 1000.0 << " us\n";
+    }
+
+    model.setScheduler(nullptr);
+    return 0;
+}
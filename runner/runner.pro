@@ -0,0 +1,24 @@
+# QDataflowCanvas - a dataflow widget for Qt
+# Copyright (C) 2018 Kuba Ober
+
+QT = core
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = QDataflowRunner
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp \
+    ../qdataflowexamples.cpp
+
+HEADERS += \
+    ../qdataflowexamples.h
+
+DEFINES += \
+    QT_DISABLE_DEPRECATED_BEFORE=0x060000 \
+    QT_RESTRICTED_CAST_FROM_ASCII \
+    QT_NO_KEYWORDS
@@ -0,0 +1,24 @@
+# QDataflowCanvas - a dataflow widget for Qt
+# Copyright (C) 2018 Kuba Ober
+
+QT = core testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_qdataflowmodel
+TEMPLATE = app
+
+include(../core/core.pri)
+
+SOURCES += \
+    tst_qdataflowmodel.cpp \
+    ../qdataflowexamples.cpp
+
+HEADERS += \
+    ../qdataflowexamples.h
+
+DEFINES += \
+    QT_DISABLE_DEPRECATED_BEFORE=0x060000 \
+    QT_RESTRICTED_CAST_FROM_ASCII \
+    QT_NO_KEYWORDS
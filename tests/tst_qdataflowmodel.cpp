@@ -0,0 +1,333 @@
+/* QDataflowCanvas - a dataflow widget for Qt
+ * Copyright (C) 2018 Kuba Ober
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qdataflowexamples.h"
+#include "qdataflowgraph.h"
+#include "qdataflowmodel.h"
+#include "qdataflownodefactory.h"
+#include "qdataflowpatchfile.h"
+#include "qdataflowscheduler.h"
+#include "qdataflowundolog.h"
+#include "utility.h"
+
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+// nodes by text, position and iolet types, and connections by the texts
+// of their ends; the tests keep node texts unique
+QStringList snapshot(QDataflowModel *model)
+{
+    QStringList lines;
+    for(auto *node : as_const(model->nodes()))
+    {
+        QStringList inletTypes, outletTypes;
+        for(auto *inlet : as_const(node->inlets()))
+            inletTypes << inlet->type();
+        for(auto *outlet : as_const(node->outlets()))
+            outletTypes << outlet->type();
+        lines << QStringLiteral("%1 @%2,%3 in(%4) out(%5)").arg(node->text())
+                 .arg(node->pos().x()).arg(node->pos().y())
+                 .arg(inletTypes.join(QLatin1Char(','))).arg(outletTypes.join(QLatin1Char(',')));
+    }
+    for(auto *conn : as_const(model->connections()))
+    {
+        lines << QStringLiteral("%1:%2 -> %3:%4").arg(conn->source()->node()->text()).arg(conn->source()->index())
+                 .arg(conn->dest()->node()->text()).arg(conn->dest()->index());
+    }
+    lines.sort();
+    return lines;
+}
+
+QDataflowModelNode * nodeByText(QDataflowModel *model, const QString &text)
+{
+    for(auto *node : as_const(model->nodes()))
+        if(node->text() == text) return node;
+    return nullptr;
+}
+
+void registerExamples(QDataflowModel *model)
+{
+    QDataflowNodeFactory *factory = new QDataflowNodeFactory(model);
+    QDataflowExamples::registerClasses(factory, [](const QDataflowMessage &) {});
+}
+
+// source -> add 5 -> num2str -> sink, as in the example editor
+void createChain(QDataflowModel *model)
+{
+    QDataflowModelNode *source = model->create(QPoint(100, 10), "source", 0, 0);
+    QDataflowModelNode *add = model->create(QPoint(100, 60), "add 5", 0, 0);
+    QDataflowModelNode *num2str = model->create(QPoint(100, 110), "num2str", 0, 0);
+    QDataflowModelNode *sink = model->create(QPoint(100, 160), "sink", 0, 0);
+    model->connect(source, 0, add, 0);
+    model->connect(add, 0, num2str, 0);
+    model->connect(num2str, 0, sink, 0);
+}
+
+class Sender : public QDataflowMetaObject
+{
+public:
+    Sender(QDataflowModelNode *node) : QDataflowMetaObject(node) {}
+};
+
+// run by one worker at a time; read after QDataflowScheduler::waitForIdle()
+class Recorder : public QDataflowMetaObject
+{
+public:
+    Recorder(QDataflowModelNode *node) : QDataflowMetaObject(node) {}
+
+    void onDataReceved(int inlet, const QDataflowMessage &message) override
+    {
+        inlets << inlet;
+        values << message.toInt();
+    }
+
+    QVector<int> inlets;
+    QVector<int> values;
+};
+
+} // namespace
+
+class tst_QDataflowModel : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void undoRedo();
+    void lazyObjects();
+    void journalReplay();
+    void rejectCycles();
+    void analysisUpdates();
+    void inletQueueOrder();
+};
+
+void tst_QDataflowModel::undoRedo()
+{
+    QDataflowModel model;
+    registerExamples(&model);
+    QDataflowUndoLog *log = model.undoLog();
+    log->setEnabled(true);
+
+    QVector<QStringList> states;
+    states << snapshot(&model);
+
+    log->beginCommand();
+    createChain(&model);
+    log->endCommand();
+    QCOMPARE(model.connections().size(), 3);
+    states << snapshot(&model);
+
+    nodeByText(&model, "add 5")->setPos(QPoint(200, 60));
+    states << snapshot(&model);
+
+    // an int outlet replaces the string one, and its connection to the sink
+    // goes with it
+    nodeByText(&model, "num2str")->setText("add 1");
+    QCOMPARE(model.connections().size(), 2);
+    QCOMPARE(nodeByText(&model, "add 1")->inletCount(), 2);
+    states << snapshot(&model);
+
+    model.remove(nodeByText(&model, "add 5"));
+    QCOMPARE(model.connections().size(), 0);
+    states << snapshot(&model);
+
+    QCOMPARE(log->undoCount(), states.size() - 1);
+    for(int i = states.size() - 2; i >= 0; i--)
+    {
+        log->undo();
+        QCOMPARE(snapshot(&model), states[i]);
+    }
+    QVERIFY(!log->canUndo());
+
+    for(int i = 1; i < states.size(); i++)
+    {
+        log->redo();
+        QCOMPARE(snapshot(&model), states[i]);
+    }
+    QVERIFY(!log->canRedo());
+}
+
+void tst_QDataflowModel::lazyObjects()
+{
+    QDataflowModel model;
+    const QStringList types{QStringLiteral("int")};
+    const int a = model.createNode(QPoint(0, 0), "a", {}, types);
+    const int b = model.createNode(QPoint(0, 50), "b", types, {});
+    QVERIFY(a != QDataflowGraph::InvalidId && b != QDataflowGraph::InvalidId);
+    const int e = model.connectNodes(a, 0, b, 0);
+    QVERIFY(e != QDataflowGraph::InvalidId);
+    QCOMPARE(model.connectNodes(a, 0, b, 0), int(QDataflowGraph::InvalidId));
+    QCOMPARE(model.graph().text(a), QStringLiteral("a"));
+
+    // the objects read the graph, and edits through them write it
+    QDataflowModelNode *node = model.nodeById(a);
+    QVERIFY(node);
+    QCOMPARE(model.nodeById(a), node);
+    QCOMPARE(node->outlet(0)->type(), QStringLiteral("int"));
+    node->setPos(QPoint(10, 20));
+    QCOMPARE(model.graph().pos(a), QPoint(10, 20));
+
+    QDataflowModelConnection *conn = model.connectionById(e);
+    QVERIFY(conn);
+    QCOMPARE(conn->source()->node(), node);
+    QCOMPARE(conn->dest()->node(), model.nodeById(b));
+    QCOMPARE(node->outlet(0)->connections().size(), 1);
+
+    model.disconnect(conn);
+    QVERIFY(!model.graph().containsEdge(e));
+    QVERIFY(node->outlet(0)->connections().isEmpty());
+    QCOMPARE(model.connections().size(), 0);
+}
+
+void tst_QDataflowModel::journalReplay()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("patch.qdfp");
+
+    QDataflowModel model;
+    registerExamples(&model);
+    createChain(&model);
+    QVERIFY(QDataflowPatchFile::save(&model, fileName));
+
+    QBuffer journal;
+    QVERIFY(journal.open(QIODevice::ReadWrite));
+    QDataflowUndoLog *log = model.undoLog();
+    log->setEnabled(true);
+    log->setJournal(&journal);
+
+    nodeByText(&model, "sink")->setPos(QPoint(300, 160));
+    nodeByText(&model, "num2str")->setText("add 1");
+    model.remove(nodeByText(&model, "source"));
+    // the sink lost its connection to the renamed node
+    log->beginCommand();
+    QDataflowModelNode *num2str = model.create(QPoint(300, 110), "num2str", 0, 0);
+    QVERIFY(model.connect(nodeByText(&model, "add 1"), 0, num2str, 0));
+    QVERIFY(model.connect(num2str, 0, nodeByText(&model, "sink"), 0));
+    log->endCommand();
+    model.remove(nodeByText(&model, "add 5"));
+    // undo is journaled as the inverse of the command
+    log->undo();
+    log->setJournal(nullptr);
+
+    QDataflowModel reloaded;
+    registerExamples(&reloaded);
+    QVERIFY(QDataflowPatchFile::load(&reloaded, fileName));
+    QVERIFY(journal.seek(0));
+    QVERIFY(QDataflowUndoLog::replay(&reloaded, &journal));
+    QCOMPARE(snapshot(&reloaded), snapshot(&model));
+}
+
+void tst_QDataflowModel::rejectCycles()
+{
+    QDataflowModel model;
+    model.setRejectCycles(true);
+    QDataflowModelNode *a = model.create(QPoint(0, 0), "a", 1, 1);
+    QDataflowModelNode *b = model.create(QPoint(0, 50), "b", 1, 1);
+    QDataflowModelNode *c = model.create(QPoint(0, 100), "c", 1, 1);
+    QVERIFY(model.connect(a, 0, b, 0));
+    QVERIFY(model.connect(b, 0, c, 0));
+
+    QVERIFY(!model.connect(c, 0, a, 0));
+    QVERIFY(!model.connect(a, 0, a, 0));
+    QCOMPARE(model.connections().size(), 2);
+
+    model.setRejectCycles(false);
+    QVERIFY(model.connect(c, 0, a, 0));
+    QCOMPARE(model.connections().size(), 3);
+}
+
+void tst_QDataflowModel::analysisUpdates()
+{
+    QDataflowModel model;
+    const QStringList types{QStringLiteral("int")};
+    int n[4];
+    for(int i = 0; i < 4; i++)
+        n[i] = model.createNode(QPoint(0, i * 50), QString::number(i), types, types);
+    const QDataflowGraphAnalysis &analysis = model.analysis();
+
+    // 0 -> 1 -> 2 -> 0 is a loop; 3 is on its own
+    const int e01 = model.connectNodes(n[0], 0, n[1], 0);
+    model.connectNodes(n[1], 0, n[2], 0);
+    model.connectNodes(n[2], 0, n[0], 0);
+    QVERIFY(!analysis.isAcyclic());
+    QCOMPARE(analysis.stronglyConnectedComponents().size(), 1);
+    QCOMPARE(analysis.stronglyConnectedComponents().first().size(), 3);
+    QCOMPARE(analysis.connectedComponents().size(), 2);
+    QVERIFY(analysis.componentOf(n[0]) == analysis.componentOf(n[2]));
+    QVERIFY(analysis.componentOf(n[0]) != analysis.componentOf(n[3]));
+
+    // breaking the loop orders its back edge again, and the nodes stay
+    // connected through it
+    model.disconnect(model.connectionById(e01));
+    QVERIFY(analysis.isAcyclic());
+    QVERIFY(analysis.topologicalIndex(n[1]) < analysis.topologicalIndex(n[2]));
+    QVERIFY(analysis.topologicalIndex(n[2]) < analysis.topologicalIndex(n[0]));
+    QCOMPARE(analysis.connectedComponents().size(), 2);
+
+    // 0 is cut off from 1 and 2
+    const int e20 = model.graph().findEdge(n[2], 0, n[0], 0);
+    model.disconnect(model.connectionById(e20));
+    QCOMPARE(analysis.connectedComponents().size(), 3);
+    QVERIFY(analysis.componentOf(n[1]) == analysis.componentOf(n[2]));
+    QVERIFY(analysis.componentOf(n[0]) != analysis.componentOf(n[1]));
+    QVERIFY(analysis.componentOf(n[0]) != analysis.componentOf(n[3]));
+
+    model.connectNodes(n[3], 0, n[1], 0);
+    QCOMPARE(analysis.connectedComponents().size(), 2);
+    QVERIFY(analysis.componentOf(n[3]) == analysis.componentOf(n[2]));
+}
+
+void tst_QDataflowModel::inletQueueOrder()
+{
+    const int count = 10000;
+
+    QDataflowModel model;
+    QDataflowModelNode *left = model.create(QPoint(0, 0), "left", 0, 1);
+    QDataflowModelNode *right = model.create(QPoint(50, 0), "right", 0, 1);
+    QDataflowModelNode *receiver = model.create(QPoint(0, 50), "receiver", 2, 0);
+    QVERIFY(model.connect(left, 0, receiver, 0));
+    QVERIFY(model.connect(right, 0, receiver, 1));
+    // the left inlet bypasses the mailbox, the right one goes through it
+    receiver->inlet(0)->setQueue(256, QDataflowInletQueue::Block);
+
+    Sender *leftSender = new Sender(left);
+    Sender *rightSender = new Sender(right);
+    Recorder *recorder = new Recorder(receiver);
+    left->setDataflowMetaObject(leftSender);
+    right->setDataflowMetaObject(rightSender);
+    receiver->setDataflowMetaObject(recorder);
+
+    QDataflowScheduler scheduler(4);
+    model.setScheduler(&scheduler);
+    for(int i = 0; i < count; i++)
+        (i % 2 ? rightSender : leftSender)->sendData(0, i);
+    scheduler.waitForIdle();
+    model.setScheduler(nullptr);
+
+    QCOMPARE(recorder->values.size(), count);
+    for(int i = 0; i < count; i++)
+    {
+        QCOMPARE(recorder->values[i], i);
+        QCOMPARE(recorder->inlets[i], i % 2);
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_QDataflowModel)
+
+#include "tst_qdataflowmodel.moc"